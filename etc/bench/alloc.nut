@@ -0,0 +1,33 @@
+/*
+*	allocation churn: short lived tables, arrays, closures, instances and
+*	strings; about 16000 of them are alive at any time and they die in a
+*	different order than they were created
+*/
+
+class Point {
+	x = 0;
+	y = 0;
+	constructor(a, b) { x = a; y = b; }
+}
+
+function main(n)
+{
+	local ring = array(16384);
+	local mask = ring.len() - 1;
+	for(local i = 0; i < n; i += 1) {
+		local k = i;
+		ring[i & mask] = {
+			p = Point(i, -i),
+			a = [i, k],
+			t = {},
+			f = function() { return k; },
+			s = "k" + (i & 1023)
+		};
+		ring[(i * 7) & mask] = null;
+	}
+	local live = 0;
+	foreach(o in ring) if(o) live += o.f() & 1;
+	print(live+"\n");
+}
+
+main(vargv.len()!=0?vargv[0].tointeger():1);
@@ -0,0 +1,32 @@
+/*
+*	coroutines exchanging lines over pipes
+*
+*	[pairs] pairs of tasks share a pipe each, the writer sends [lines] lines
+*	and the reader reads them back; the tasks wait on the poller of the scheduler
+*	whenever a pipe is empty or full:
+*
+*		sq etc/bench/asyncio.nut [pairs] [lines]
+*/
+
+local PAIRS = vargv.len() > 0 ? vargv[0].tointeger() : 1000;
+local LINES = vargv.len() > 1 ? vargv[1].tointeger() : 1000;
+
+local s = scheduler();
+local received = 0;
+local t = clock();
+for(local i = 0; i < PAIRS; i++) {
+	local p = s.pipe();
+	s.spawn(function(w) {
+		for(local j = 0; j < LINES; j++) w.print("message number " + j + "\n");
+		w.close();
+	}, p[1]);
+	s.spawn(function(r) {
+		while(r.readline() != "") received++;
+		r.close();
+	}, p[0]);
+}
+s.run();
+t = clock() - t;
+if(received != PAIRS * LINES) throw "wrong number of lines";
+print(format("pipes %6d  lines %9d  fibers %6d  %8.3f s  %10.0f lines/s\n",
+	PAIRS, received, s.stats().fibers, t, received / t));
@@ -0,0 +1,47 @@
+/*
+*	benchmark driver
+*
+*	runs each workload several times in-process and reports the best time.
+*	run it from the top of the source tree:
+*
+*		sq etc/bench/bench.nut [name ...]
+*/
+
+local benchmarks = [
+	{ name = "ackermann", file = "samples/ackermann.nut", arg = 8 },
+	{ name = "fibonacci", file = "samples/fibonacci.nut", arg = 31 },
+	{ name = "methcall",  file = "samples/methcall.nut",  arg = 1000000 },
+	{ name = "calls",     file = "etc/bench/calls.nut",   arg = 300000 },
+	{ name = "generators", file = "etc/bench/generators.nut", arg = 500000 },
+	{ name = "matrix",    file = "samples/matrix.nut",    arg = 100 },
+	{ name = "array",     file = "samples/array.nut",     arg = 3000 },
+	{ name = "fields",    file = "etc/bench/fields.nut",  arg = 1000000 },
+	{ name = "loops",     file = "etc/bench/loops.nut",   arg = 50000 },
+	{ name = "containers", file = "etc/bench/containers.nut", arg = 200000 },
+	{ name = "alloc",     file = "etc/bench/alloc.nut",   arg = 300000 },
+	{ name = "tables",    file = "etc/bench/tables.nut",  arg = 200000 },
+];
+
+local RUNS = 5;
+
+local selected = {};
+foreach(a in vargv) selected[a] <- true;
+
+local realprint = ::print;
+local total = 0.0;
+foreach(b in benchmarks) {
+	if(selected.len() > 0 && !(b.name in selected)) continue;
+	local f = loadfile(b.file);
+	local best = null;
+	::print = function(s) {};
+	for(local i = 0; i < RUNS; i += 1) {
+		local t = clock();
+		f.call(getroottable(), b.arg);
+		t = clock() - t;
+		if(best == null || t < best) best = t;
+	}
+	::print = realprint;
+	total += best;
+	print(format("%-12s %8.3f\n", b.name, best));
+}
+print(format("%-12s %8.3f\n", "total", total));
@@ -0,0 +1,30 @@
+/*
+*	operations that make big strings
+*
+*	a text of [kbytes] KB is cut into slices, concatenated with small
+*	strings and stripped, like a text processing pipeline that never uses
+*	the results as keys. the strings are created and dropped right away:
+*
+*		sq etc/bench/bigstrings.nut [kbytes]
+*/
+
+local KB = vargv.len() > 0 ? vargv[0].tointeger() : 256;
+local ROUNDS = 2000;
+
+local line = "lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor\n";
+local block = "";
+while(block.len() < 1024) block += line;
+local text = "";
+for(local i = 0; i < KB; i++) text += block;
+
+function run(name, f)
+{
+	local t = clock();
+	local n = 0;
+	for(local i = 0; i < ROUNDS; i++) n += f(i).len();
+	print(format("%-8s %8.3f s  (%d MB)\n", name, clock() - t, n / (1024 * 1024)));
+}
+
+run("slice", @(i) text.slice(i, text.len() - i));
+run("concat", @(i) text + i);
+run("strip", @(i) strip("   " + i + text));
@@ -0,0 +1,30 @@
+/*
+*	higher order functions of the arrays
+*
+*	map, filter, reduce, apply and sort call a small closure for every
+*	element (every comparison for sort) of an array of [elements]:
+*
+*		sq etc/bench/callbacks.nut [elements]
+*/
+
+local N = vargv.len() > 0 ? vargv[0].tointeger() : 1000000;
+
+local arr = array(N);
+local seed = 12345;
+for(local i = 0; i < N; i++) {
+	seed = (seed * 1103515245 + 12345) & 0x7FFFFFFF;
+	arr[i] = seed % 1000000;
+}
+
+function run(name, f)
+{
+	local t = clock();
+	f();
+	print(format("%-8s elements %8d  %8.3f s\n", name, N, clock() - t));
+}
+
+run("map", @() arr.map(@(x) x + 1));
+run("filter", @() arr.filter(@(i, x) x & 1));
+run("reduce", @() arr.reduce(@(p, c) p + c));
+run("apply", @() (clone arr).apply(@(x) x * 2));
+run("sort", @() (clone arr).sort(@(a, b) a <=> b));
@@ -0,0 +1,36 @@
+/*
+*	calls of script closures: exact arity (local, global, method and tail
+*	calls) and the shapes that take the general path (default parameters,
+*	varargs, closures with free variables)
+*/
+
+function add(a, b) { return a + b; }
+function countdown(n, acc) { if(n == 0) return acc; return countdown(n - 1, acc + 1); }
+function withdefault(a, b = 1) { return a + b; }
+function withvargs(a, ...) { return a + vargv.len(); }
+
+class Counter {
+	n = 0;
+	function inc(d) { n += d; return n; }
+}
+
+function main(n)
+{
+	local function sub(a, b) { return a - b; }
+	local k = 3;
+	local addk = function(a) { return a + k; }
+	local c = Counter();
+	local sum = 0;
+	for(local i = 0; i < n; i += 1) {
+		sum += add(i, 1);
+		sum += sub(i, 1);
+		sum += c.inc(1) & 1;
+		sum += addk(i);
+		sum += withdefault(i);
+		sum += withvargs(i, 1);
+	}
+	sum += countdown(n, 0);
+	print(sum+"\n");
+}
+
+main(vargv.len()!=0?vargv[0].tointeger():1);
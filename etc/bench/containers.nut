@@ -0,0 +1,23 @@
+/*
+*	many small arrays and tables kept alive at the same time
+*/
+
+function main(n)
+{
+	local keep = array(n);
+	for(local i = 0; i < n; i += 1) {
+		local t = { x = i, y = i * 2, name = "n" };
+		t.z <- [i, i + 1, i + 2, i + 3];
+		keep[i] = t;
+	}
+	local sum = 0;
+	for(local r = 0; r < 10; r += 1) {
+		foreach(t in keep) {
+			sum += t.x + t.y;
+			foreach(v in t.z) sum += v;
+		}
+	}
+	print(sum+"\n");
+}
+
+main(vargv.len()!=0?vargv[0].tointeger():1);
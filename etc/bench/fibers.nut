@@ -0,0 +1,67 @@
+/*
+*	short lived tasks on threads and on a scheduler
+*
+*	[tasks] tasks are run with a new thread each and on a scheduler, that reuses
+*	its threads. in 'oneshot' the tasks run to the end, in 'pause' every task
+*	waits once and they are started in batches of 1000:
+*
+*		sq etc/bench/fibers.nut [tasks]
+*/
+
+local N = vargv.len() > 0 ? vargv[0].tointeger() : 1000000;
+local BATCH = 1000;
+
+local sum = 0;
+function report(name, kind, t, threads)
+{
+	print(format("%-8s %-9s tasks %8d  threads %7d  %8.3f s\n", name, kind, N, threads, t));
+}
+
+//oneshot
+local t = clock();
+sum = 0;
+for(local i = 0; i < N; i++) {
+	newthread(function(x) { sum += x; }).call(i);
+}
+report("oneshot", "newthread", clock() - t, N);
+local expected = sum;
+
+local s = scheduler();
+t = clock();
+sum = 0;
+for(local i = 0; i < N; i++) {
+	s.spawn(function(x) { sum += x; }, i);
+}
+s.run();
+if(sum != expected) throw "oneshot: wrong sum";
+report("oneshot", "scheduler", clock() - t, s.stats().fibers);
+
+//pause
+t = clock();
+sum = 0;
+local batch = array(BATCH);
+for(local i = 0; i < N; i += BATCH) {
+	local n = N - i < BATCH ? N - i : BATCH;
+	for(local j = 0; j < n; j++) {
+		batch[j] = newthread(function(x) { suspend(); sum += x; });
+		batch[j].call(i + j);
+	}
+	for(local j = 0; j < n; j++) batch[j].wakeup();
+}
+report("pause", "newthread", clock() - t, N);
+expected = sum;
+
+s = scheduler();
+t = clock();
+sum = 0;
+s.spawn(function() {
+	for(local i = 0; i < N; i += BATCH) {
+		for(local j = 0; j < BATCH && i + j < N; j++) {
+			s.spawn(function(x) { s.pause(); sum += x; }, i + j);
+		}
+		s.pause();
+	}
+});
+s.run();
+if(sum != expected) throw "pause: wrong sum";
+report("pause", "scheduler", clock() - t, s.stats().fibers);
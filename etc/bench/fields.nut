@@ -0,0 +1,35 @@
+/*
+*	field and method access on instances and tables
+*/
+
+class Point {
+	x = 0;
+	y = 0;
+	constructor(_x,_y) { x = _x; y = _y; }
+	function len2() { return x*x + y*y; }
+}
+
+class Point3 extends Point {
+	z = 0;
+	constructor(_x,_y,_z) { base.constructor(_x,_y); z = _z; }
+	function len2() { return x*x + y*y + z*z; }
+}
+
+function main(n)
+{
+	local p = Point(1,2);
+	local q = Point3(1,2,3);
+	local t = { x = 1, y = 2, z = 3 };
+	local objs = [p,q,p,q];
+	local sum = 0;
+	for(local i = 0; i < n; i += 1) {
+		p.x = p.x + p.y;
+		t.x = t.y + t.z;
+		local o = objs[i & 3];
+		sum += o.len2() & 0xFF;
+		o.y = i & 7;
+	}
+	print(sum+" "+p.x+" "+t.x+"\n");
+}
+
+main(vargv.len()!=0?vargv[0].tointeger():1);
@@ -0,0 +1,78 @@
+/*
+*	garbage collector pauses
+*
+*	keeps a large graph of tables and arrays alive and runs "frames" that change
+*	it and leave some reference cycles behind. the collector runs either as a
+*	full collection every few frames or as a gcstep() every frame; the time of
+*	every call is recorded and the median, 99th percentile and worst pause are
+*	printed, in milliseconds, followed by the statistics of the collector
+*	(gcstats()) for the run:
+*
+*		sq etc/bench/gcpause.nut [live objects] [frames] [step budget]
+*/
+
+local NLIVE = vargv.len() > 0 ? vargv[0].tointeger() : 100000;
+local FRAMES = vargv.len() > 1 ? vargv[1].tointeger() : 300;
+local BUDGET = vargv.len() > 2 ? vargv[2].tointeger() : 2000;
+local FULLEVERY = 10;
+
+function makeheap(n)
+{
+	local heap = array(n / 2);
+	for(local i = 0; i < heap.len(); i++) {
+		local t = { id = i, items = [i] };
+		t.items.append(t);
+		heap[i] = t;
+	}
+	return heap;
+}
+
+function frame(heap, f)
+{
+	for(local i = 0; i < 200; i++) {
+		local a = { f = f };
+		local b = [a];
+		a.b <- b;
+		heap[(f * 200 + i) % heap.len()].items[0] = { f = f, i = i };
+	}
+}
+
+function percentile(sorted, p)
+{
+	local idx = (sorted.len() * p / 100).tointeger();
+	if(idx >= sorted.len()) idx = sorted.len() - 1;
+	return sorted[idx] * 1000.0;
+}
+
+function run(mode)
+{
+	local heap = makeheap(NLIVE);
+	collectgarbage();
+	gcstats(true);
+	local pauses = [];
+	local freed = 0;
+	for(local f = 0; f < FRAMES; f++) {
+		frame(heap, f);
+		local t = clock();
+		if(mode == "full") {
+			if(f % FULLEVERY != FULLEVERY - 1) continue;
+			freed += collectgarbage();
+		}
+		else {
+			local n = gcstep(BUDGET);
+			if(n > 0) freed += n;
+		}
+		pauses.append(clock() - t);
+	}
+	local st = gcstats();
+	freed += collectgarbage();
+	pauses.sort();
+	print(format("%-20s calls %5d  p50 %8.3f  p99 %8.3f  max %8.3f  freed %d\n",
+		mode == "full" ? "collectgarbage/" + FULLEVERY : "gcstep(" + BUDGET + ")",
+		pauses.len(), percentile(pauses, 50), percentile(pauses, 99), percentile(pauses, 100), freed));
+	print(format("%-20s cycles %4d  objects visited %9d  max step %7d  max atomic %7d\n",
+		"", st.cycles, st.work, st.maxstep, st.maxatomic));
+}
+
+run("full");
+run("step");
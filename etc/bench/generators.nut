@@ -0,0 +1,71 @@
+/*
+*	generators: yield and resume
+*
+*	the random numbers and fibonacci generators of samples/generators.nut,
+*	resumed [yields] times, and a generator with many live locals, which
+*	are saved and restored on every yield:
+*
+*		sq etc/bench/generators.nut [yields]
+*/
+
+local N = vargv.len() > 0 ? vargv[0].tointeger() : 2000000;
+
+function gen_random(max) {
+	local last=42
+	local IM = 139968;
+	local IA = 3877;
+	local IC = 29573;
+	for(;;){  //loops forever
+		yield (max * (last = (last * IA + IC) % IM) / IM);
+	}
+}
+
+function fiboz(n)
+{
+	local prev=0;
+	local curr=1;
+	yield 1;
+
+	for(local i=0;i<n-1;i+=1)
+	{
+		local res=(prev+curr)&0xFFFFFF;
+		prev=curr;
+		yield curr=res;
+	}
+	return prev+curr;
+}
+
+function wide(n)
+{
+	local a = "a", b = [1], c = {}, d = 1.5, e = 2, f = "f", g = [], h = {};
+	local i0 = 0, i1 = 1, i2 = 2, i3 = 3, i4 = 4, i5 = 5, i6 = 6, i7 = 7;
+	for(local i = 0; i < n; i++) {
+		yield i + i0 + i7;
+	}
+}
+
+function run(name, f)
+{
+	local t = clock();
+	local r = f();
+	print(format("%-8s yields %8d  %8.3f s  (%d)\n", name, N, clock() - t, r));
+}
+
+run("resume", function() {
+	local g = gen_random(100);
+	local s = 0;
+	for(local i = 0; i < N; i++) s += resume g;
+	return s;
+});
+
+run("foreach", function() {
+	local s = 0;
+	foreach(v in fiboz(N)) s = (s + v) & 0xFFFFFF;
+	return s;
+});
+
+run("wide", function() {
+	local s = 0;
+	foreach(v in wide(N)) s += v & 1;
+	return s;
+});
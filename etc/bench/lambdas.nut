@@ -0,0 +1,46 @@
+/*
+*	function literals evaluated in hot loops
+*
+*	'free' creates a capture free lambda every iteration and calls it,
+*	'capture' one that captures a local, 'map' passes a capture free lambda
+*	to map() on a small array; [iterations] times each:
+*
+*		sq etc/bench/lambdas.nut [iterations]
+*/
+
+local N = vargv.len() > 0 ? vargv[0].tointeger() : 5000000;
+
+function run(name, f)
+{
+	local t = clock();
+	local r = f();
+	print(format("%-8s %8.3f s  (%d)\n", name, clock() - t, r));
+}
+
+run("free", function() {
+	local s = 0;
+	for(local i = 0; i < N; i++) {
+		local f = @(x) x + 1;
+		s += f(i);
+	}
+	return s;
+});
+
+run("capture", function() {
+	local s = 0;
+	for(local i = 0; i < N; i++) {
+		local k = i;
+		local f = @(x) x + k;
+		s += f(1);
+	}
+	return s;
+});
+
+local small = [1, 2, 3, 4];
+run("map", function() {
+	local s = 0;
+	for(local i = 0; i < N / 4; i++) {
+		s += small.map(@(x) x * 2).len();
+	}
+	return s;
+});
@@ -0,0 +1,21 @@
+/*
+*	integer loops: moves, constants and arithmetic between locals
+*/
+
+function main(n)
+{
+	local sum = 0;
+	for(local i = 0; i < n; i += 1) {
+		local a = i, b = 1, c = 0;
+		for(local j = 0; j < 100; j += 1) {
+			c = a;
+			a = b;
+			b = c + j;
+			sum = sum + (a - b) * 3;
+			if(sum < 0) sum = -sum;
+		}
+	}
+	print(sum+"\n");
+}
+
+main(vargv.len()!=0?vargv[0].tointeger():1);
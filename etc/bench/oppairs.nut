@@ -0,0 +1,50 @@
+/*
+*	dynamic opcode pair histogram
+*
+*	needs a VM built with SQ_OPCODE_PAIRS. runs the benchmark workloads
+*	(or the scripts given on the command line) and prints the most
+*	frequent pairs of instructions executed back to back:
+*
+*		sq etc/bench/oppairs.nut [top] [script ...]
+*/
+
+if(!("getopcodepairs" in getroottable())) {
+	print("this VM was built without SQ_OPCODE_PAIRS\n");
+	return;
+}
+
+local top = 30;
+local scripts = [
+	["samples/ackermann.nut", 7],
+	["samples/fibonacci.nut", 25],
+	["samples/methcall.nut", 100000],
+	["samples/matrix.nut", 30],
+	["samples/array.nut", 300],
+	["etc/bench/fields.nut", 100000],
+	["etc/bench/loops.nut", 2000],
+	["etc/bench/containers.nut", 20000],
+];
+
+if(vargv.len() > 0) {
+	top = vargv[0].tointeger();
+	if(vargv.len() > 1) scripts = vargv.slice(1).map(@(s) [s]);
+}
+
+local realprint = ::print;
+getopcodepairs(true);
+foreach(s in scripts) {
+	local f = loadfile(s[0]);
+	::print = function(s) {};
+	if(s.len() > 1) f.call(getroottable(), s[1]);
+	else f.call(getroottable());
+	::print = realprint;
+}
+
+local pairs = getopcodepairs(true);
+pairs.sort(@(a,b) b.count <=> a.count);
+local total = 0;
+foreach(p in pairs) total += p.count;
+for(local i = 0; i < top && i < pairs.len(); i++) {
+	local p = pairs[i];
+	print(format("%-16s %-16s %12d %6.2f%%\n", p.first, p.second, p.count, p.count * 100.0 / total));
+}
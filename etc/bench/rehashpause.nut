@@ -0,0 +1,68 @@
+/*
+*	insertion pauses while tables grow
+*
+*	inserts keys one at a time into a table with string keys, a table with
+*	sparse integer keys (they don't fit the array part) and the string table
+*	of the VM (by creating new strings). the time of every insertion is
+*	recorded and the worst one, the number of insertions slower than 0.1 ms
+*	and the total time are printed:
+*
+*		sq etc/bench/rehashpause.nut [keys]
+*/
+
+local N = vargv.len() > 0 ? vargv[0].tointeger() : 1000000;
+
+local keys = array(N);
+for(local i = 0; i < N; i++) keys[i] = "key" + i;
+
+function report(name, worst, slow, total)
+{
+	print(format("%-16s keys %8d  worst %8.3f ms  over 0.1 ms %4d  total %6.3f s\n",
+		name, N, worst * 1000.0, slow, total));
+}
+
+function strkeys()
+{
+	local t = {};
+	local worst = 0.0, slow = 0, total = clock();
+	for(local i = 0; i < N; i++) {
+		local c = clock();
+		t[keys[i]] <- i;
+		c = clock() - c;
+		if(c > worst) worst = c;
+		if(c > 0.0001) slow++;
+	}
+	report("string keys", worst, slow, clock() - total);
+}
+
+function intkeys()
+{
+	local t = {};
+	local worst = 0.0, slow = 0, total = clock();
+	for(local i = 0; i < N; i++) {
+		local c = clock();
+		t[i * 7919] <- i;
+		c = clock() - c;
+		if(c > worst) worst = c;
+		if(c > 0.0001) slow++;
+	}
+	report("integer keys", worst, slow, clock() - total);
+}
+
+function newstrings()
+{
+	local strs = array(N);
+	local worst = 0.0, slow = 0, total = clock();
+	for(local i = 0; i < N; i++) {
+		local c = clock();
+		strs[i] = "str" + i;
+		c = clock() - c;
+		if(c > worst) worst = c;
+		if(c > 0.0001) slow++;
+	}
+	report("string table", worst, slow, clock() - total);
+}
+
+strkeys();
+intkeys();
+newstrings();
@@ -0,0 +1,41 @@
+/*
+*	sorting arrays
+*
+*	[elements] random integers, floats and strings are sorted with the
+*	default order, a compare function and a key function:
+*
+*		sq etc/bench/sort.nut [elements]
+*/
+
+local N = vargv.len() > 0 ? vargv[0].tointeger() : 1000000;
+
+local ints = array(N);
+local seed = 12345;
+for(local i = 0; i < N; i++) {
+	seed = (seed * 1103515245 + 12345) & 0x7FFFFFFF;
+	ints[i] = seed % 1000000;
+}
+local floats = ints.map(@(x) x / 7.0);
+local strings = ints.map(@(x) "key" + x);
+local sorted = clone ints;
+sorted.sort();
+
+function run(name, src, f)
+{
+	local a = clone src;
+	local t = clock();
+	f(a);
+	t = clock() - t;
+	for(local i = 1; i < a.len(); i++) {
+		if(a[i] < a[i - 1]) throw name + ": not sorted";
+	}
+	print(format("%-16s elements %8d  %8.3f s\n", name, N, t));
+}
+
+run("integers", ints, @(a) a.sort());
+run("sorted", sorted, @(a) a.sort());
+run("floats", floats, @(a) a.sort());
+run("strings", strings, @(a) a.sort());
+run("compare", ints, @(a) a.sort(@(x, y) x <=> y));
+run("strings stable", strings, @(a) a.sort(true));
+run("sortby", ints, @(a) a.sortby(@(x) x));
@@ -0,0 +1,52 @@
+/*
+*	building a string with many appends
+*
+*	a report of [appends] short pieces is built with '+=' (every step copies
+*	the whole string) and with a stringbuilder:
+*
+*		sq etc/bench/strbuild.nut [appends]
+*/
+
+local N = vargv.len() > 0 ? vargv[0].tointeger() : 100000;
+
+function concat()
+{
+	local s = "";
+	for(local i = 0; i < N; i++) {
+		s += "row " + i + ": ok\n";
+	}
+	return s;
+}
+
+function builder()
+{
+	local sb = stringbuilder();
+	for(local i = 0; i < N; i++) {
+		sb.append("row ", i, ": ok\n");
+	}
+	return sb.tostring();
+}
+
+function builderf()
+{
+	local sb = stringbuilder();
+	for(local i = 0; i < N; i++) {
+		sb.appendf("row %d: ok\n", i);
+	}
+	return sb.tostring();
+}
+
+local result = null;
+function run(name, f)
+{
+	local t = clock();
+	local s = f();
+	t = clock() - t;
+	if(result == null) result = s;
+	else if(s != result) throw name + " built a different string";
+	print(format("%-10s appends %7d  length %9d  %8.3f s\n", name, N, s.len(), t));
+}
+
+run("+=", concat);
+run("append", builder);
+run("appendf", builderf);
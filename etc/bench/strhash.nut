@@ -0,0 +1,71 @@
+/*
+*	string hash on realistic key sets
+*
+*	for every key set the strings are created (interned by the string table),
+*	inserted in a table and looked up a few times. the keys are built from
+*	pieces first so only the hashing and the table work are timed. compare
+*	the default hash with the sampled one of older versions:
+*
+*		sq etc/bench/strhash.nut [keys]
+*		sq -s etc/bench/strhash.nut [keys]
+*
+*	the sampled hash sees only a few distinct urls, use a small key count with -s
+*/
+
+local N = vargv.len() > 0 ? vargv[0].tointeger() : 200000;
+local LOOKUPS = 5;
+
+//request paths with a long common prefix, they differ in a few digits
+function urls(i)
+{
+	return format("https://api.example.com/v2/accounts/%d/orders/%d/items?page=%d&sort=created_at", i / 97, i % 97, i % 7);
+}
+
+//short field names like the ones of decoded JSON documents
+local fields = ["id", "name", "email", "created_at", "updated_at", "status", "type", "value",
+	"parent_id", "owner", "tags", "count", "price", "currency", "title", "url"];
+function jsonkeys(i)
+{
+	return fields[i % fields.len()] + "_" + (i / fields.len());
+}
+
+//log lines, long strings that only differ in the timestamp and the request id
+function loglines(i)
+{
+	return format("2017-03-%02d %02d:%02d:%02d INFO [worker-%d] request %08x completed in %d ms (200 OK)",
+		1 + i % 28, i / 3600 % 24, i / 60 % 60, i % 60, i % 8, i, i % 1000);
+}
+
+function run(name, gen)
+{
+	local parts = array(N);
+	for(local i = 0; i < N; i++) {
+		local k = gen(i);
+		parts[i] = [k.slice(0, k.len() / 2), k.slice(k.len() / 2)];
+	}
+	collectgarbage();
+
+	local t = clock();
+	local keys = array(N);
+	for(local i = 0; i < N; i++) keys[i] = parts[i][0] + parts[i][1];
+	local tintern = clock() - t;
+
+	t = clock();
+	local tab = {};
+	foreach(i, k in keys) tab[k] <- i;
+	local tinsert = clock() - t;
+
+	t = clock();
+	local sum = 0;
+	for(local l = 0; l < LOOKUPS; l++) {
+		foreach(k in keys) sum += tab[k];
+	}
+	local tlookup = clock() - t;
+
+	print(format("%-10s keys %7d  unique %7d  intern %6.3f s  insert %6.3f s  lookup %6.3f s\n",
+		name, N, tab.len(), tintern, tinsert, tlookup));
+}
+
+run("urls", urls);
+run("json", jsonkeys);
+run("loglines", loglines);
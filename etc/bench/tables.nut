@@ -0,0 +1,46 @@
+/*
+*	table heavy work: inserts, lookups with integer and string keys,
+*	iteration, deletion churn and many small tables
+*/
+
+function main(n)
+{
+	local sum = 0;
+	local keys = array(1024);
+	for(local i = 0; i < keys.len(); i += 1) keys[i] = "key" + i;
+
+	//inserts
+	local t = {};
+	for(local i = 0; i < n; i += 1) t[i] <- i;
+	local s = {};
+	foreach(k in keys) s[k] <- k.len();
+
+	//lookups
+	for(local r = 0; r < 4; r += 1) {
+		for(local i = 0; i < n; i += 1) sum += t[i];
+		for(local i = 0; i < n; i += 1) sum += s[keys[i & 1023]];
+		for(local i = 0; i < n; i += 1) if(("key" + (i & 2047)) in s) sum += 1;
+	}
+
+	//iteration
+	for(local r = 0; r < 4; r += 1) {
+		foreach(k, v in t) sum += v;
+		foreach(k, v in s) sum += v;
+	}
+
+	//deletion churn, the table keeps the same size
+	for(local i = 0; i < n; i += 1) {
+		delete t[i];
+		t[i + n] <- i;
+	}
+	foreach(k, v in t) sum += k - v;
+
+	//small tables
+	for(local i = 0; i < n; i += 1) {
+		local p = { x = i, y = i + 1, z = i + 2 };
+		sum += p.x + p.y + p.z;
+	}
+	print(sum+"\n");
+}
+
+main(vargv.len()!=0?vargv[0].tointeger():1);
@@ -0,0 +1,62 @@
+/*
+*	typed arrays against arrays
+*
+*	the same numbers are summed, searched for the maximum, sorted and read
+*	one by one in an array and in a float64array:
+*
+*		sq etc/bench/typedarray.nut [elements]
+*/
+
+local N = vargv.len() > 0 ? vargv[0].tointeger() : 1000000;
+
+local arr = array(N);
+local seed = 12345;
+for(local i = 0; i < N; i++) {
+	seed = (seed * 1103515245 + 12345) & 0x7FFFFFFF;
+	arr[i] = (seed % 100000) / 10.0;
+}
+local ta = float64array(arr);
+
+function time(name, fa, ft)
+{
+	local t = clock();
+	local ra = fa();
+	local tarr = clock() - t;
+	t = clock();
+	local rt = ft();
+	local tta = clock() - t;
+	if(ra != rt) throw name + ": different results " + ra + " " + rt;
+	print(format("%-8s elements %8d  array %7.3f s  float64array %7.3f s\n", name, N, tarr, tta));
+}
+
+time("sum", function() {
+	local s = 0.0;
+	foreach(x in arr) s += x;
+	return s;
+}, @() ta.sum());
+
+time("max", function() {
+	local m = arr[0];
+	foreach(x in arr) if(x > m) m = x;
+	return m;
+}, @() ta.max());
+
+time("sort", function() {
+	local c = clone arr;
+	c.sort();
+	return c[N / 2];
+}, function() {
+	local c = clone ta;
+	c.sort();
+	return c[N / 2];
+});
+
+time("index", function() {
+	local s = 0.0;
+	for(local i = 0; i < N; i++) s += arr[i];
+	return s;
+}, function() {
+	local s = 0.0;
+	for(local i = 0; i < N; i++) s += ta[i];
+	return s;
+});
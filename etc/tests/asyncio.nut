@@ -0,0 +1,172 @@
+/*
+*	async streams of the fiber library
+*
+*	the tasks reading and writing pipes, child processes and local sockets wait
+*	for the descriptors while the other tasks run
+*/
+
+function check(cond, msg) { if(!cond) throw "failed: " + msg; }
+
+//not available on Windows
+if(!("pipe" in scheduler)) {
+	print("passed\n");
+	return;
+}
+
+local function join(a) { return a.len() ? a.reduce(@(x, y) x + " " + y) : ""; }
+
+//a reader waits for the lines of a writer that sleeps between them
+local s = scheduler();
+local p = s.pipe();
+local log = [];
+s.spawn(function() {
+	local line;
+	while((line = p[0].readline()) != "") log.append("r:" + line.slice(0, -1));
+	log.append("eof");
+});
+s.spawn(function() {
+	foreach(i, w in ["one", "two", "three"]) {
+		log.append("w:" + w);
+		p[1].print(w + "\n");
+		s.sleep(0.005);
+	}
+	p[1].close();
+});
+check(s.run() == 0, "the tasks return");
+check(join(log) == "w:one r:one w:two r:two w:three r:three eof", "lines " + join(log));
+p[0].close();
+
+//the last line can be missing its new line, readblob throws at the end of the stream
+s = scheduler();
+p = s.pipe();
+local got = [];
+s.spawn(function() {
+	got.append(p[0].readline());
+	got.append(p[0].readline());
+	got.append(p[0].readline());
+	try { p[0].readblob(10); got.append("no exception"); } catch(e) { got.append("end"); }
+});
+s.spawn(function() { p[1].print("a\nb"); p[1].close(); });
+s.run();
+check(got.len() == 4 && got[0] == "a\n" && got[1] == "b" && got[2] == "" && got[3] == "end", "last line");
+p[0].close();
+
+//a write larger than the pipe waits for the reader
+s = scheduler();
+p = s.pipe();
+local size = 300000, total = 0, written = 0;
+s.spawn(function() {
+	local b = blob(size);
+	for(local i = 0; i < size; i++) b.writen(i & 0xff, 'b');
+	written = p[1].writeblob(b);
+	p[1].close();
+});
+s.spawn(function() {
+	try {
+		while(true) {
+			local b = p[0].readblob(4096);
+			check(b.len() > 0 && b.len() <= 4096, "readblob size");
+			for(local i = 0; i < b.len(); i++, total++)
+				if(b[i] != (total & 0xff)) throw "failed: the content of the pipe";
+		}
+	}
+	catch(e) {
+		if(typeof(e) == "string" && e.find("failed") == 0) throw e;
+	}
+});
+s.run();
+check(written == size, "writeblob returns the bytes written");
+check(total == size, "all the bytes are read");
+p[0].close();
+
+//only one task at a time can wait to read a stream
+s = scheduler();
+p = s.pipe();
+local errors = 0;
+s.spawn(function() { p[0].readline(); });
+s.spawn(function() { try { p[0].readline(); } catch(e) { errors++; } });
+s.spawn(function() { s.sleep(0.005); p[1].print("x\n"); });
+s.run();
+check(errors == 1, "the second reader gets an exception");
+p[0].close();
+p[1].close();
+
+//closing a stream wakes up the task waiting on it with an exception
+s = scheduler();
+p = s.pipe();
+local closed = null;
+s.spawn(function() { try { p[0].readline(); } catch(e) { closed = e; } });
+s.spawn(function() { s.sleep(0.005); p[0].close(); });
+s.run();
+check(closed == "the stream was closed", "close wakes up the reader");
+p[1].close();
+
+//the output and the exit status of a command
+s = scheduler();
+got = [];
+s.spawn(function() {
+	local c = s.popen("echo first; sleep 0.01; echo second", "r");
+	local line;
+	while((line = c.readline()) != "") got.append(line);
+	got.append(c.close());
+});
+local other = 0;
+s.spawn(function() { while(got.len() == 0 || other < 2) { other++; s.sleep(0.002); } });
+s.run();
+check(got.len() == 3 && got[0] == "first\n" && got[1] == "second\n" && got[2] == 0, "popen output");
+check(other >= 2, "the other tasks run while the command is running");
+check(s.popen("exit 3", "r").close() == 3, "exit status");
+
+//the input of a command, its exit status counts the bytes received
+s = scheduler();
+local status = null;
+s.spawn(function() {
+	local c = s.popen("exit $(wc -c)", "w");
+	c.print("12345");
+	status = c.close();
+});
+s.run();
+check(status == 5, "popen input");
+
+//a local socket: the server answers each line of the client
+local path = "/tmp/sq_asyncio_" + time() + "_" + (clock() * 1000000).tointeger() + ".sock";
+s = scheduler();
+local server = s.listen(path);
+local answers = [];
+s.spawn(function() {
+	local c = server.accept();
+	local line;
+	while((line = c.readline()) != "") c.print(line.toupper());
+	c.close();
+});
+s.spawn(function() {
+	local c = s.connect(path);
+	foreach(w in ["ping", "pong"]) {
+		c.print(w + "\n");
+		answers.append(c.readline());
+	}
+	c.close();
+});
+s.run();
+server.close();
+remove(path);
+check(answers.len() == 2 && answers[0] == "PING\n" && answers[1] == "PONG\n", "socket");
+
+//regular files never wait
+path = "/tmp/sq_asyncio_" + time() + "_" + (clock() * 1000000).tointeger() + ".txt";
+s = scheduler();
+got = [];
+s.spawn(function() {
+	local f = s.open(path, "wb");
+	f.print("line1\nline2\n");
+	f.close();
+	f = s.open(path, "rb");
+	local line;
+	while((line = f.readline()) != "") got.append(line);
+	check(f.close() == 0, "close of a file");
+});
+s.run();
+remove(path);
+check(got.len() == 2 && got[0] == "line1\n" && got[1] == "line2\n", "file");
+
+print("passed\n");
@@ -0,0 +1,82 @@
+/*
+*	callbacks of the higher order builtins (sq_callk)
+*
+*	the callbacks run in the execution loop of the caller: they can suspend
+*	the thread, errors unwind through the builtin frames, and nesting them
+*	isn't limited by the native calls
+*/
+
+function check(cond, msg) { if(!cond) throw "failed: " + msg; }
+
+//suspend from the callbacks and resume with the values to use
+local t = newthread(function() {
+	local m = [1, 2, 3].map(@(x) suspend(x));
+	local f = [1, 2, 3, 4].filter(@(i, x) suspend(x));
+	local r = [1, 2, 3].reduce(@(a, b) suspend(a + b));
+	local s = [3, 1, 2].sort(@(a, b) suspend(a <=> b));
+	local b = [3, 1, 2].sortby(@(x) suspend(-x));
+	local tf = { a = 1, b = 2 }.filter(@(k, v) suspend(v) == 2);
+	return [m, f, r, s, b, tf];
+});
+local got = [];
+local res = t.call();
+while(t.getstatus() == "suspended") {
+	got.append(res);
+	//map doubles, filter keeps the even, reduce adds 10, sort and sortby answer the
+	//question asked, table.filter keeps b
+	if(got.len() <= 3) res = t.wakeup(res * 2);
+	else if(got.len() <= 7) res = t.wakeup(res % 2 == 0);
+	else if(got.len() <= 9) res = t.wakeup(res + 10);
+	else res = t.wakeup(res);
+}
+check(res[0][0] == 2 && res[0][1] == 4 && res[0][2] == 6, "map resumed");
+check(res[1].len() == 2 && res[1][0] == 2 && res[1][1] == 4, "filter resumed");
+check(res[2] == 26, "reduce resumed");
+check(res[3][0] == 1 && res[3][1] == 2 && res[3][2] == 3, "sort resumed");
+check(res[4][0] == 3 && res[4][2] == 1, "sortby resumed");
+check(res[5].len() == 1 && res[5].b == 2, "table.filter resumed");
+
+//errors thrown by the callbacks unwind the builtin frames
+function thrower(x) { if(x == 2) throw "bad " + x; return x; }
+local errs = 0;
+foreach(f in [@() [1, 2, 3].map(thrower), @() [1, 2, 3].filter(@(i, x) thrower(x)),
+		@() [1, 2, 3].reduce(@(a, b) thrower(b)), @() [1, 2, 3].apply(thrower),
+		@() [3, 2, 1].sort(@(a, b) thrower(a) <=> thrower(b)), @() [1, 2].sortby(thrower)]) {
+	try { f(); }
+	catch(e) { check(e == "bad 2", "error of the callback: " + e); errs++; }
+}
+check(errs == 6, "every builtin raised the error");
+check([1, 2].map(@(x) x + 1)[1] == 3, "the stack is usable after the errors");
+
+//an error caught inside the callback doesn't stop the builtin
+local caught = [1, 2, 3].map(function(x) { try { return thrower(x); } catch(e) { return 0; } });
+check(caught[0] == 1 && caught[1] == 0 && caught[2] == 3, "error caught in the callback");
+
+//errors of the callback after it was resumed
+t = newthread(function() {
+	seterrorhandler(@(e) null);
+	return [1, 2].map(function(x) { suspend(x); throw "late " + x; });
+});
+t.call();
+try { t.wakeup(); check(false, "error after resuming"); } catch(e) { check(e == "late 1", "error after resuming: " + e); }
+
+//a wrong return value and a native callee
+try { [1, 2].sort(@(a, b) null); check(false, "wrong return value"); } catch(e) {}
+check(["1", "2"].map(@(s) s.tointeger()).reduce(@(a, b) a + b) == 3, "nested callbacks");
+check([1.5, 2.5].map(floor).len() == 2, "native callee");
+
+//nesting deeper than the native calls
+function deep(n) { return n == 0 ? 0 : [n].map(@(x) deep(x - 1))[0] + 1; }
+check(deep(500) == 500, "deep nesting");
+
+//the call stack seen from a callback
+local frames = 0;
+[1].map(function(x) { while(getstackinfos(frames + 1)) frames++; });
+check(frames >= 2, "the caller is on the call stack of the callback");
+
+//suspending through a nested native call is still an error
+class Cmp { v = 0; constructor(x) { v = x; } function _cmp(o) { return [v].map(@(x) suspend(x))[0] <=> o.v; } }
+t = newthread(function() { seterrorhandler(@(e) null); return Cmp(1) < Cmp(2); });
+try { t.call(); check(t.getstatus() != "suspended", "suspend through _cmp"); } catch(e) {}
+
+print("passed\n");
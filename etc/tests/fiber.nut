@@ -0,0 +1,159 @@
+/*
+*	scheduler and channels of the fiber library
+*
+*	the order the tasks run in, the pool of threads, the buffering and the
+*	closing of the channels and the exceptions of the tasks
+*/
+
+function check(cond, msg) { if(!cond) throw "failed: " + msg; }
+
+//the tasks run in the order they are spawned, pause() moves the task to the end of the queue
+local s = scheduler();
+local log = [];
+foreach(name in ["a", "b", "c"]) {
+	s.spawn(function(n) {
+		log.append(n + 1);
+		s.pause();
+		log.append(n + 2);
+		suspend();
+		log.append(n + 3);
+	}, name);
+}
+check(s.run() == 0, "run returns the waiting tasks");
+check(log.reduce(@(a, b) a + " " + b) == "a1 b1 c1 a2 b2 c2 a3 b3 c3", "round robin");
+check(s.stats().tasks == 0, "no task left");
+check(s.stats().spawned == 3, "spawned");
+
+//a thread returns to the pool when its task returns
+s = scheduler();
+for(local i = 0; i < 10; i++) s.spawn(@() null);
+s.run();
+for(local i = 0; i < 10; i++) s.spawn(@() null);
+s.run();
+check(s.stats().fibers == 1, "the thread is reused");
+
+//the parameters and 'this' of a task
+s = scheduler();
+local got = null;
+s.spawn(function(a, b) { got = [this, a, b]; }, 1, "x");
+s.run();
+check(got[0] == getroottable() && got[1] == 1 && got[2] == "x", "parameters");
+
+//the root table and the error handler set by a task don't leak into the next ones
+s = scheduler();
+local roots = [];
+s.spawn(function() { setroottable({}); seterrorhandler(@(e) null); });
+s.spawn(function() { roots.append(::getroottable()); });
+s.spawn(function() { setroottable({ marker = true }); });
+s.spawn(function() { roots.append(::getroottable()); });
+s.run();
+check(s.stats().fibers == 1, "one thread for the sequential tasks");
+check(roots.len() == 2 && roots[0] == getroottable() && roots[1] == getroottable(), "root table reset");
+
+//sleeping tasks wake up in the order of their deadlines
+s = scheduler();
+log = [];
+s.spawn(function() { s.sleep(0.03); log.append(3); });
+s.spawn(function() { s.sleep(0.01); log.append(1); });
+s.spawn(function() { s.sleep(0.02); log.append(2); });
+local t0 = s.now();
+s.run();
+check(log.len() == 3 && log[0] == 1 && log[1] == 2 && log[2] == 3, "sleep order");
+check(s.now() - t0 >= 0.03, "sleep duration");
+
+//an unbuffered channel hands each value to a receiver
+s = scheduler();
+local ch = s.channel();
+log = [];
+s.spawn(function() {
+	for(local i = 0; i < 3; i++) { ch.send(i); log.append("s" + i); }
+	ch.close();
+});
+s.spawn(function() {
+	local v;
+	while((v = ch.recv()) != null) log.append("r" + v);
+});
+check(s.run() == 0, "producer and consumer return");
+check(log.len() == 6, "unbuffered values");
+//the sender is never more than the value handed ahead of the receiver
+local sent = 0, received = 0;
+foreach(e in log) {
+	if(e[0] == 's') sent++;
+	else check(e == "r" + received++, "unbuffered order");
+	check(sent <= received + 1, "send waits for a receiver");
+}
+
+//a buffered channel keeps up to its capacity
+s = scheduler();
+ch = channel(s, 2);
+log = [];
+s.spawn(function() {
+	for(local i = 0; i < 4; i++) { ch.send(i); log.append("s" + i); }
+});
+s.spawn(function() {
+	for(local i = 0; i < 4; i++) log.append("r" + ch.recv());
+});
+s.run();
+check(log.len() == 8, "buffered values");
+check(log[0] == "s0" && log[1] == "s1", "send doesn't wait until the buffer is full");
+check(log.find("r0") < log.find("s2"), "send waits when the buffer is full");
+for(local i = 1; i < 4; i++) check(log.find("r" + (i - 1)) < log.find("r" + i), "buffered order");
+
+//sending and receiving from outside of a task, as long as it doesn't wait
+ch = s.channel(1);
+ch.send("out");
+check(ch.len() == 1, "len");
+check(ch.recv() == "out", "recv outside of a task");
+local threw = false;
+try { ch.recv(); } catch(e) { threw = true; }
+check(threw, "waiting outside of a task");
+
+//closing a channel: the buffered values can still be received, then null; send throws
+ch = s.channel(2);
+ch.send(1);
+ch.close();
+check(ch.isclosed(), "isclosed");
+check(ch.recv() == 1 && ch.recv() == null, "recv after close");
+threw = false;
+try { ch.send(2); } catch(e) { threw = true; }
+check(threw, "send on a closed channel");
+
+//close wakes up the tasks waiting on the channel
+s = scheduler();
+ch = s.channel();
+got = [];
+s.spawn(function() { got.append(ch.recv()); });
+s.spawn(function() { got.append(ch.recv()); });
+s.spawn(function() { ch.close(); });
+check(s.run() == 0, "the receivers wake up");
+check(got.len() == 2 && got[0] == null && got[1] == null, "null on close");
+
+//run() returns the number of tasks waiting on a channel
+s = scheduler();
+ch = s.channel();
+s.spawn(function() { ch.recv(); });
+s.spawn(function() { ch.recv(); });
+check(s.run() == 2, "two waiting tasks");
+ch.send("x");
+check(s.run() == 1, "one waiting task");
+ch.close();
+check(s.run() == 0, "no waiting task");
+
+//an exception terminates its task, run() throws it and the other tasks continue
+s = scheduler();
+log = [];
+s.spawn(function() { seterrorhandler(@(e) null); s.pause(); throw "boom"; });
+s.spawn(function() { s.pause(); s.pause(); log.append("done"); });
+local err = null;
+try { s.run(); } catch(e) { err = e; }
+check(err == "boom", "the exception of the task");
+check(s.stats().tasks == 1, "the other task is kept");
+s.run();
+check(log.len() == 1 && log[0] == "done", "the other task continues");
+
+//the waiting methods can't be called from outside of a task
+threw = false;
+try { s.pause(); } catch(e) { threw = true; }
+check(threw, "pause outside of a task");
+
+print("passed\n");
@@ -0,0 +1,30 @@
+/*
+*	incremental collection
+*
+*	an object that loses its last reference at any step of a cycle is
+*	released at once, and the objects still referenced survive the cycle
+*/
+
+function check(cond, msg) { if(!cond) throw "failed: " + msg; }
+
+function fill() { ::keep <- { dropped = { name = "dropped" }, kept = { name = "kept" } }; }
+
+//the number of steps of a cycle
+fill();
+collectgarbage();
+local steps = 1;
+while(gcstep(1) == -1) steps++;
+
+for(local n = 1; n <= steps; n++) {
+	fill();
+	local w = ::keep.dropped.weakref();
+	local r = -1;
+	for(local i = 0; i < n && r == -1; i++) r = gcstep(1);
+	delete ::keep.dropped;
+	check(w.ref() == null, "released at step " + n);
+	::keep.kept.name = "changed";
+	while(r == -1) r = gcstep(16);
+	check(::keep.kept.name == "changed", "kept object at step " + n);
+}
+
+print("passed\n");
@@ -0,0 +1,32 @@
+/*
+*	the collector and threads
+*
+*	a thread is a collectable object of its own; it must be marked and
+*	released like the others when it is the newest object of the chain,
+*	while it is suspended and through a weak reference
+*/
+
+function check(cond, msg) { if(!cond) throw "failed: " + msg; }
+
+//a fresh thread at the head of the chain
+local t = newthread(function() { suspend(1); });
+check(collectgarbage() == 0, "collect with a fresh thread");
+check(t.call() == 1, "suspended");
+check(collectgarbage() == 0, "collect with a suspended thread");
+t.wakeup();
+check(t.getstatus() == "idle", "thread finished");
+
+//incremental steps with a fresh thread
+t = newthread(function() { suspend(1); });
+while(gcstep(16) < 0);
+check(t.call() == 1, "suspended after the steps");
+
+//a weak reference to a thread
+local w = t.weakref();
+collectgarbage();
+check(w.ref() == t, "weakref kept while referenced");
+t = null;
+collectgarbage();
+check(w.ref() == null, "weakref cleared");
+
+print("passed\n");
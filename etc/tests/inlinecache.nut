@@ -0,0 +1,43 @@
+/*
+*	inline caches of the instance members
+*
+*	the instructions that read and write instances remember the class and the
+*	key of the last members they found; the keys built at run time (including
+*	the long ones that aren't interned) must not be confused with each other
+*/
+
+function check(cond, msg) { if(!cond) throw "failed: " + msg; }
+
+local pad = "";
+for(local i = 0; i < 1100; i++) pad += "x";
+local names = ["a", "b", "c"];
+
+//the same instruction with keys built at run time, interned and not
+foreach(prefix in ["", pad]) {
+	local C = class {};
+	foreach(i, n in names) C[prefix + n] <- i;
+	local o = C();
+	local get = function(o, k) { return o[k]; }
+	local set = function(o, k, v) { o[k] = v; }
+	for(local i = 0; i < 300; i++) {
+		local n = names[i % 3];
+		check(get(o, prefix + n) == i % 3, "get " + n);
+	}
+	for(local i = 0; i < 300; i++) set(o, prefix + names[i % 3], i);
+	check(o[prefix + "a"] == 297 && o[prefix + "b"] == 298 && o[prefix + "c"] == 299, "set");
+}
+
+//instances of different classes through the same instruction
+class A { x = "A.x"; y = "A.y"; function m() { return "A.m"; } }
+class B { y = "B.y"; x = "B.x"; function m() { return "B.m"; } }
+class D extends A { z = "D.z"; function m() { return "D.m"; } }
+local objs = [A(), B(), D()];
+local read = function(o) { return o.x + " " + o.y + " " + o.m(); }
+for(local i = 0; i < 30; i++) {
+	local o = objs[i % 3];
+	local c = o instanceof A ? "A" : "B";
+	local m = o instanceof D ? "D" : c;
+	check(read(o) == c + ".x " + c + ".y " + m + ".m", "class " + i);
+}
+
+print("passed\n");
@@ -0,0 +1,93 @@
+/*
+*	strings that aren't interned
+*
+*	strings at or above the intern limit skip the string table, so the same
+*	characters can be held by different objects; they must compare, hash and
+*	look up like the interned string with the same characters
+*/
+
+function check(cond, msg) { if(!cond) throw "failed: " + msg; }
+
+local function build(prefix, n) { return prefix + n; }
+
+//with a limit of 0 every string is interned
+local old = setinternlimit(0);
+check(old == 1024, "default limit");
+local ikeys = [];
+for(local i = 0; i < 20; i++) ikeys.append(build("long_key_", i));
+
+//from now on the strings of 8 characters and more are not interned
+check(setinternlimit(8) == 0, "previous limit");
+local ukeys = [];
+for(local i = 0; i < 20; i++) ukeys.append(build("long_key_", i));
+local short = build("k", 1);
+
+//equality against the interned copy and another uninterned copy
+foreach(i, u in ukeys) {
+	check(u == ikeys[i] && ikeys[i] == u, "== interned " + i);
+	check(!(u != ikeys[i]), "!= interned " + i);
+	check(u == build("long_key_", i), "== uninterned " + i);
+	check(u != ikeys[(i + 1) % 20] && u != build("long_key_", i + 100), "!= other " + i);
+	check((u <=> ikeys[i]) == 0, "<=> " + i);
+}
+check(short == "k1", "short strings are still interned");
+check(ukeys[1] != build("long_key_", 1) + "x", "different length");
+check(build("long_key_", 10) != build("long_kez_", 10), "same length, different characters");
+
+//tables: keys set with one copy are found with the others
+local ti = {}, tu = {};
+foreach(i, k in ikeys) ti[k] <- i;
+foreach(i, k in ukeys) tu[k] <- i;
+foreach(i, u in ukeys) {
+	check(u in ti && ti[u] == i, "interned key, uninterned lookup " + i);
+	check(ikeys[i] in tu && tu[ikeys[i]] == i, "uninterned key, interned lookup " + i);
+	check(tu[build("long_key_", i)] == i, "uninterned lookup of another copy " + i);
+}
+check(!(build("long_key_", 99) in tu), "missing key");
+tu[build("long_key_", 3)] = "updated";
+check(tu[ikeys[3]] == "updated" && tu.len() == 20, "set replaces the slot of the equal key");
+tu.rawdelete(build("long_key_", 4));
+check(!(ukeys[4] in tu) && tu.len() == 19, "delete by an equal key");
+tu[build("long_key_", 4)] <- 4;
+check(tu.len() == 20, "reinsert");
+local seen = 0;
+foreach(k, v in ti) if(k in tu) seen++;
+check(seen == 20, "iteration");
+
+//class members and instances
+local C = class {};
+C[ikeys[0]] <- "zero";
+local o = C();
+check(o[ukeys[0]] == "zero" && o[build("long_key_", 0)] == "zero", "instance member");
+
+//switch on uninterned values against the literals
+local sw = function(s) {
+	switch(s) {
+		case "long_key_1": return 1;
+		case "long_key_2": return 2;
+		default: return 0;
+	}
+}
+check(sw(ukeys[1]) == 1 && sw(ukeys[2]) == 2 && sw(ukeys[3]) == 0, "switch");
+local swc = compilestring("switch(vargv[0]) { case \"long_key_5\": return 5; default: return 0; }");
+check(swc(ikeys[5]) == 5 && swc(ukeys[5]) == 5 && swc(ukeys[6]) == 0, "switch on uninterned literals");
+
+//array search and sort
+check(ikeys.find(ukeys[7]) == 7 && ukeys.find(ikeys[8]) == 8, "find");
+check(ukeys.find(build("long_key_", 99)) == null, "find missing");
+local mixed = [];
+for(local i = 19; i >= 0; i--) mixed.append(i % 2 ? ukeys[i] : ikeys[i]);
+mixed.sort();
+local expected = clone ikeys;
+expected.sort();
+foreach(i, s in mixed) check(s == expected[i], "sort " + i);
+
+//big strings
+local big = "";
+for(local i = 0; i < 4096; i++) big += "x";
+local t = {};
+t[big] <- 1;
+check(t[big.slice(0)] == 1 && t[big + ""] == 1, "big key");
+
+setinternlimit(old);
+print("passed\n");
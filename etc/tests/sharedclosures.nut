@@ -0,0 +1,50 @@
+/*
+*	closures of capture free functions
+*
+*	the VM may return the closure of the last evaluation of a capture free
+*	function again, but only when nothing else refers to it
+*/
+
+function check(cond, msg) { if(!cond) throw "failed: " + msg; }
+
+::name <- "root";
+function mk() { return function() { return ::name; } }
+
+//a closure still referenced is not shared
+local a = mk(), b = mk();
+check(a != b, "two live closures");
+local custom = { name = "custom" };
+a.setroot(custom);
+check(a() == "custom" && b() == "root", "setroot changes one closure");
+
+local t = {};
+t[mk()] <- 1;
+t[mk()] <- 2;
+check(t.len() == 2, "closures as keys");
+
+local arr = [];
+for(local i = 0; i < 2; i++) arr.append(@(x) x * 2);
+check(arr[0] != arr[1], "closures kept in an array");
+
+//a dropped closure with another root is not returned again
+a = null; b = null;
+local c = mk();
+c.setroot(custom);
+c = null;
+check(mk()() == "root", "root of a reused closure");
+
+//a weak reference keeps the closure from being reused
+local w = mk().weakref();
+check(w.ref() != null && mk() != w.ref(), "closure behind a weak reference");
+
+//the closures are marked by the collector
+local s = 0;
+for(local i = 0; i < 100; i++) {
+	local f = @(x) x + 1;
+	s += f(i);
+	if(i % 10 == 0) gcstep(8);
+}
+collectgarbage();
+check(s == 5050, "calls in a loop");
+
+print("passed\n");
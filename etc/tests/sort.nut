@@ -0,0 +1,90 @@
+/*
+*	array.sort and array.sortby
+*
+*	the order of the native paths and of the compare function, stability,
+*	and the errors raised by the compare function
+*/
+
+function check(cond, msg) { if(!cond) throw "failed: " + msg; }
+function throws(f) { try { f(); } catch(e) { return e; } return null; }
+
+local seed = 12345;
+function rand(n) { seed = (seed * 1103515245 + 12345) & 0x7fffffff; return (seed >> 8) % n; }
+
+function sorted(a, cmp = null)
+{
+	for(local i = 1; i < a.len(); i++) {
+		if(cmp ? cmp(a[i - 1], a[i]) > 0 : a[i - 1] > a[i]) return false;
+	}
+	return true;
+}
+
+function samecontent(a, b)
+{
+	local count = {};
+	foreach(x in a) count[x] <- (x in count ? count[x] : 0) + 1;
+	foreach(x in b) { if(!(x in count)) return false; count[x]--; }
+	foreach(k, n in count) if(n != 0) return false;
+	return a.len() == b.len();
+}
+
+//native paths and the generic one
+local ints = [], floats = [], strings = [], mixed = [];
+for(local i = 0; i < 2000; i++) {
+	ints.append(rand(500) - 250);
+	floats.append(rand(1000) / 7.0);
+	strings.append("s" + rand(300));
+	mixed.append(i % 2 ? rand(100) : rand(100) + 0.5);
+}
+foreach(name, a in { ints = ints, floats = floats, strings = strings, mixed = mixed }) {
+	local s = clone a;
+	check(s.sort() == s, name + ": returns the array");
+	check(sorted(s) && samecontent(a, s), name + ": default order");
+	s = clone a;
+	s.sort(true);
+	check(sorted(s) && samecontent(a, s), name + ": stable");
+	s = clone a;
+	s.sort(@(x, y) y <=> x);
+	check(sorted(s, @(x, y) y <=> x) && samecontent(a, s), name + ": compare function");
+}
+local few = [[], [1], [2, 1], [1, 2, 3], [3, 2, 1]];
+foreach(a in few) { local s = clone a; s.sort(); check(sorted(s), "short arrays"); }
+local presorted = [];
+for(local i = 0; i < 1000; i++) presorted.append(i);
+check(sorted(clone(presorted).sort()) && sorted(clone(presorted).reverse().sort()), "sorted and reversed input");
+
+//stability: 1 and 1.0 compare equal, records with equal keys
+local eq = [];
+for(local i = 0; i < 100; i++) eq.append(i % 3 ? 1 : 1.0);
+local s = clone eq;
+s.sort(true);
+foreach(i, x in s) check(typeof x == typeof eq[i], "stable default order");
+local recs = [];
+for(local i = 0; i < 500; i++) recs.append({ key = rand(10), pos = i });
+local byfunc = clone recs;
+byfunc.sort(@(a, b) a.key <=> b.key);
+local bykey = clone recs;
+bykey.sortby(@(r) r.key);
+for(local i = 1; i < 500; i++) {
+	foreach(r in [byfunc, bykey]) {
+		check(r[i - 1].key < r[i].key || (r[i - 1].key == r[i].key && r[i - 1].pos < r[i].pos), "stable records");
+	}
+}
+
+//errors of the compare function leave the array untouched
+local a = [5, 3, 8, 1, 9, 2];
+local before = clone a;
+check(throws(@() a.sort(function(x, y) { if(x == 8) throw "cmp error"; return x <=> y; })) == "cmp error", "error thrown by the compare function");
+foreach(i, x in a) check(x == before[i], "untouched after an error");
+check(throws(@() a.sort(@(x, y) "x")) != null, "compare function returning a string");
+check(throws(@() a.sort(@(x) 0)) != null, "compare function with a wrong number of parameters");
+check(throws(@() a.sortby(function(x) { throw "key error"; })) == "key error", "error thrown by the key function");
+foreach(i, x in a) check(x == before[i], "untouched after the other errors");
+check(throws(@() a.sort(function(x, y) { a.append(0); return x <=> y; })) != null, "array resized by the compare function");
+
+//an inconsistent compare function gives some order of the same elements
+local r = clone ints;
+r.sort(@(x, y) rand(3) - 1);
+check(samecontent(ints, r), "inconsistent compare function");
+
+print("passed\n");
@@ -0,0 +1,60 @@
+/*
+*	stringbuilder class of the string library
+*
+*	appending values of every type, formatting, clearing and reusing the
+*	buffer and the conversions to string
+*/
+
+function check(cond, msg) { if(!cond) throw "failed: " + msg; }
+
+//an empty builder
+local sb = stringbuilder();
+check(sb.len() == 0, "empty len");
+check(sb.tostring() == "", "empty tostring");
+check(sb.append("") == sb, "empty append returns the builder");
+check(sb.append("", "").len() == 0, "empty appends");
+check(sb.appendf("").len() == 0, "empty appendf");
+check(sb.tostring() == "", "still empty");
+
+//strings and the other types as tostring() converts them
+sb = stringbuilder(4);
+sb.append("a", 1, 2.5, true, null, 'c');
+check(sb.tostring() == "a1" + 2.5 + "true" + null + 'c', "mixed types " + sb.tostring());
+check(sb.len() == sb.tostring().len(), "len");
+local t = {};
+check(stringbuilder().append(t).tostring() == t.tostring(), "table");
+
+//calls can be chained
+sb = stringbuilder().append("x").appendf("%d-%s", 42, "y").append("z");
+check(sb.tostring() == "x42-yz", "chained " + sb.tostring());
+check(stringbuilder().appendf("%5.2f|%-3s|%x", 3.14159, "a", 255).tostring() == " 3.14|a  |ff", "appendf");
+
+//_tostring, used by the conversions and the concatenation
+sb = stringbuilder().append("abc");
+check(sb + "" == "abc", "concatenation");
+check(sb.tostring() == "abc", "tostring keeps the content");
+check(typeof(sb) == "stringbuilder", "typeof");
+
+//clear keeps the buffer, the builder can be reused
+sb.clear();
+check(sb.len() == 0 && sb.tostring() == "", "clear");
+sb.append("def");
+check(sb.tostring() == "def", "reuse after clear");
+check(sb.clear().append("").len() == 0, "empty append after clear");
+
+//growing past the initial capacity
+sb = stringbuilder(1);
+local expected = "";
+for(local i = 0; i < 1000; i++) {
+	sb.append(i, ",");
+	expected += i + ",";
+}
+check(sb.len() == expected.len() && sb.tostring() == expected, "growth");
+
+//the capacity can't be negative
+local threw = false;
+try { stringbuilder(-1); } catch(e) { threw = true; }
+check(threw, "negative capacity");
+check(stringbuilder(0).append("ok").tostring() == "ok", "zero capacity");
+
+print("passed\n");
@@ -0,0 +1,94 @@
+/*
+*	tables
+*
+*	get, set, delete and iteration over the hash part and the array part of
+*	the integer keys, with tombstones left by removed keys and while a large
+*	hash part is resized incrementally
+*/
+
+function check(cond, msg) { if(!cond) throw "failed: " + msg; }
+
+//the keys and values reached by foreach, checked against the expected count and value
+function checkiter(t, n, val, msg)
+{
+	local count = 0;
+	foreach(k, v in t) {
+		check(v == val(k), msg + ": value of " + k);
+		count++;
+	}
+	check(count == n && t.len() == n, msg + ": " + count + " keys of " + n);
+}
+
+//keys of every type
+local obj = {}, arr = [], fn = function() {};
+local t = { a = 1 };
+t[1] <- "int"; t[1.5] <- "float"; t[true] <- "bool"; t[obj] <- "table";
+t[arr] <- "array"; t[fn] <- "closure"; t[-3] <- "negative";
+check(t.a == 1 && t[1] == "int" && t[1.5] == "float" && t[true] == "bool", "scalar keys");
+check(t[obj] == "table" && t[arr] == "array" && t[fn] == "closure" && t[-3] == "negative", "object keys");
+check(t.len() == 8, "len");
+check(!(2 in t) && !({} in t), "missing keys");
+check(t.rawget(1.5) == "float" && t.rawin(obj), "rawget and rawin");
+t[1] = "changed";
+check(t[1] == "changed", "set");
+check(delete t[obj] == "table" && !(obj in t) && t.len() == 7, "delete");
+try { t.missing; check(false, "get of a missing key throws"); } catch(e) {}
+try { t.missing = 1; check(false, "set of a missing key throws"); } catch(e) {}
+
+//the array part: dense integer keys, holes and keys outside of it
+t = {};
+for(local i = 0; i < 1000; i++) t[i] <- i * 2;
+checkiter(t, 1000, @(k) k * 2, "dense keys");
+for(local i = 0; i < 1000; i += 3) delete t[i];
+check(!(0 in t) && (1 in t) && !(999 in t), "holes in the array part");
+checkiter(t, 666, @(k) k * 2, "holes");
+for(local i = 0; i < 1000; i += 3) t[i] <- i * 2;
+t[-1] <- -2; t[100000] <- 200000; t["1"] <- "string";
+check(t[-1] == -2 && t[100000] == 200000 && t["1"] == "string" && t[1] == 2, "keys outside the array part");
+delete t["1"];
+checkiter(t, 1002, @(k) k * 2, "refilled holes");
+local c = clone t;
+c[0] = "clone";
+check(t[0] == 0 && c[0] == "clone" && c.len() == t.len(), "clone");
+t.clear();
+check(t.len() == 0 && !(5 in t), "clear");
+t[5] <- 1;
+check(t[5] == 1 && t.len() == 1, "reuse after clear");
+
+//tombstones: keys removed and added again many times
+t = {};
+for(local round = 0; round < 50; round++) {
+	for(local i = 0; i < 40; i++) t["k" + (round * 40 + i)] <- round;
+	for(local i = 0; i < 40; i++) if(i % 4) delete t["k" + (round * 40 + i)];
+}
+checkiter(t, 500, @(k) k.slice(1).tointeger() / 40, "tombstones");
+for(local i = 0; i < 2000; i++) check((("k" + i) in t) == (i % 4 == 0), "lookup past tombstones " + i);
+
+//incremental resize of a large hash part: lookups, removals and iteration while it moves
+t = {};
+for(local i = 0; i < 20000; i++) {
+	t["s" + i] <- i;
+	if(i % 7 == 0) delete t["s" + (i / 2)];
+	if(i % 1000 == 0) {
+		for(local j = 0; j <= i; j += 97) {
+			local removed = (j <= i / 2) && ((j * 2) % 7 == 0 || (j * 2 + 1) % 7 == 0) && j * 2 <= i;
+			if(!removed) check(t["s" + j] == j, "lookup while resizing " + j);
+		}
+	}
+}
+local n = 0;
+foreach(k, v in t) { check(t[k] == v && k == "s" + v, "iteration after resizing"); n++; }
+check(n == t.len(), "iteration count after resizing");
+local keys = [];
+foreach(k, v in t) keys.append(k);
+foreach(k in keys) delete t[k];
+check(t.len() == 0 && !("s0" in t), "all keys deleted");
+
+//integer keys of a large table move to the array part as it fills
+t = {};
+for(local i = 9999; i >= 0; i--) t[i] <- i;
+checkiter(t, 10000, @(k) k, "integer keys added backwards");
+for(local i = 0; i < 10000; i += 2) delete t[i];
+checkiter(t, 5000, @(k) k, "integer keys removed");
+
+print("passed\n");
@@ -0,0 +1,71 @@
+/*
+*	typed arrays
+*
+*	bounds of the elements and of the sizes, views over blobs and the
+*	copies made by clone and slice
+*/
+
+function check(cond, msg) { if(!cond) throw "failed: " + msg; }
+function throws(f) { try { f(); } catch(e) { return true; } return false; }
+
+//elements and bounds
+local a = int32array(4);
+check(a.len() == 4 && a[3] == 0, "new typed array");
+a[0] = 7; a[3] = -1;
+check(a[0] == 7 && a[3] == -1, "read back");
+check(throws(@() a[4]), "read past the end");
+check(throws(@() a[-1]), "negative read");
+check(throws(function() { a[4] = 1; }), "write past the end");
+check(throws(function() { a[0] = "x"; }), "write a string");
+check(typeof a == "int32array", "typeof");
+
+local u = uint8array([255, 256, -1]);
+check(u[0] == 255 && u[1] == 0 && u[2] == 255, "uint8 wraps around");
+
+local n = 0;
+foreach(i, x in int16array([1, 2, 3])) n += i * x;
+check(n == 8, "foreach");
+
+//sizes
+check(throws(@() int32array(-1)), "negative size");
+check(throws(@() int64array(0x2000000000000001)), "size overflowing the bytes");
+check(throws(@() int8array(0x7fffffffffffffff)), "size too big to allocate");
+check(int8array(0).len() == 0 && int8array(0).min() == null, "empty");
+
+//slice, fill and clone copy the elements
+local f = float64array([1.5, 2.5, 3.5, 4.5]);
+local s = f.slice(1, -1);
+check(s.len() == 2 && s[0] == 2.5 && s[1] == 3.5, "slice");
+s[0] = 0.0;
+check(f[1] == 2.5, "slice is a copy");
+check(throws(@() f.slice(0, 5)), "slice out of range");
+check(throws(@() f.fill(0.0, 2, 5)), "fill out of range");
+f.fill(1.0, 2);
+check(f[1] == 2.5 && f[2] == 1.0 && f[3] == 1.0, "fill");
+local c = clone f;
+c[0] = 9.0;
+check(f[0] == 1.5, "clone is a copy");
+
+//views over a blob
+local b = blob(16);
+for(local i = 0; i < 4; i++) b.writen(i + 1, 'i');
+local v = int32array(b);
+check(v.len() == 4 && v[0] == 1 && v[3] == 4, "view over the blob");
+v[1] = 20;
+b.seek(4);
+check(b.readn('i') == 20, "writing the view writes the blob");
+local w = int32array(b, 8, 1);
+check(w.len() == 1 && w[0] == 3, "view with offset and length");
+check(throws(@() w[1]), "read past the end of a view");
+check(throws(@() int32array(b, 2)), "offset not a multiple of the element size");
+check(throws(@() int32array(b, 8, 3)), "view past the end of the blob");
+check(throws(@() int32array(b, 4, 0x4000000000000001)), "view length overflowing the bytes");
+check(throws(@() int32array(b, 20)), "offset past the end of the blob");
+local vc = clone w;
+vc[0] = 0;
+check(w[0] == 3, "clone of a view is a copy");
+b.resize(4);
+check(v.len() == 1, "view follows the size of the blob");
+check(throws(@() w[0]), "view beyond a shrunk blob");
+
+print("passed\n");
@@ -0,0 +1,24 @@
+/*  see copyright notice in squirrel.h */
+#ifndef _SQSTD_FIBER_H_
+#define _SQSTD_FIBER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+extern SQUIRREL_API_VAR const struct tagSQRegClass _sqstd_scheduler_decl;
+extern SQUIRREL_API_VAR const struct tagSQRegClass _sqstd_channel_decl;
+#define SQSTD_SCHEDULER_TYPE_TAG ((SQUserPointer)(SQHash)&_sqstd_scheduler_decl)
+#define SQSTD_CHANNEL_TYPE_TAG ((SQUserPointer)(SQHash)&_sqstd_channel_decl)
+#ifndef _WIN32
+extern SQUIRREL_API_VAR const struct tagSQRegClass _sqstd_asyncstream_decl;
+#define SQSTD_ASYNCSTREAM_TYPE_TAG ((SQUserPointer)(SQHash)&_sqstd_asyncstream_decl)
+#endif
+
+SQUIRREL_API SQRESULT sqstd_register_fiberlib(HSQUIRRELVM v);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*_SQSTD_FIBER_H_*/
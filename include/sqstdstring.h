@@ -24,6 +24,9 @@ SQUIRREL_API SQBool sqstd_rex_getsubexp(SQRex* exp, SQInteger n, SQRexMatch *sub
 
 SQUIRREL_API SQRESULT sqstd_format(HSQUIRRELVM v,SQInteger nformatstringidx,SQInteger *outlen,SQChar **output);
 
+extern SQUIRREL_API_VAR const struct tagSQRegClass _sqstd_stringbuilder_decl;
+#define SQSTD_STRINGBUILDER_TYPE_TAG ((SQUserPointer)(SQHash)&_sqstd_stringbuilder_decl)
+
 SQUIRREL_API SQRESULT sqstd_register_stringlib(HSQUIRRELVM v);
 
 #ifdef __cplusplus
@@ -0,0 +1,31 @@
+/*  see copyright notice in squirrel.h */
+#ifndef _SQSTD_TYPEDARRAY_H_
+#define _SQSTD_TYPEDARRAY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* element types */
+#define SQSTD_TA_INT8       0
+#define SQSTD_TA_UINT8      1
+#define SQSTD_TA_INT16      2
+#define SQSTD_TA_UINT16     3
+#define SQSTD_TA_INT32      4
+#define SQSTD_TA_UINT32     5
+#define SQSTD_TA_INT64      6
+#define SQSTD_TA_FLOAT32    7
+#define SQSTD_TA_FLOAT64    8
+
+extern SQUIRREL_API_VAR const struct tagSQRegClass _sqstd_typedarray_decl;
+#define SQSTD_TYPEDARRAY_TYPE_TAG ((SQUserPointer)(SQHash)&_sqstd_typedarray_decl)
+
+SQUIRREL_API SQRESULT sqstd_gettypedarray(HSQUIRRELVM v,SQInteger idx,SQUserPointer *data,SQInteger *type,SQInteger *len);
+
+SQUIRREL_API SQRESULT sqstd_register_typedarraylib(HSQUIRRELVM v);
+
+#ifdef __cplusplus
+} /*extern "C"*/
+#endif
+
+#endif /*_SQSTD_TYPEDARRAY_H_*/
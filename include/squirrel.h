@@ -80,6 +80,10 @@ struct SQOuter;
 #define SQUIRREL_EOB 0
 #define SQ_BYTECODE_STREAM_TAG  0xFAFA
 
+/*string hash functions of a shared state (see sq_openex)*/
+#define SQ_STRINGHASH_FULL      0   /*seeded, hashes every character*/
+#define SQ_STRINGHASH_SAMPLED   1   /*samples the characters of long strings, as before 3.2*/
+
 #define SQOBJECT_REF_COUNTED    0x08000000
 #define SQOBJECT_NUMERIC        0x04000000
 #define SQOBJECT_DELEGABLE      0x02000000
@@ -130,7 +134,7 @@ typedef enum tagSQObjectType{
     OT_OUTER =          (_RT_OUTER|SQOBJECT_REF_COUNTED) //internal usage only
 }SQObjectType;
 
-#define ISREFCOUNTED(t) (t&SQOBJECT_REF_COUNTED)
+#define ISREFCOUNTED(t) ((t)&SQOBJECT_REF_COUNTED)
 
 
 typedef union tagSQObjectValue
@@ -157,17 +161,39 @@ typedef union tagSQObjectValue
 }SQObjectValue;
 
 
+#ifdef SQ_COMPACT_OBJECTS
+/* opt-in, 12 bytes instead of 16 on 64 bits builds, the value is not 8 bytes aligned.
+   the layout of HSQOBJECT is part of the ABI: the library and every module that includes
+   this header must agree on it, so the VM constructors get other names and a mismatch
+   fails to link instead of corrupting the objects (see "Compact objects" in the docs) */
+#define sq_open sq_open_compact
+#define sq_openex sq_openex_compact
+#pragma pack(push,4)
+#endif
 typedef struct tagSQObject
 {
     SQObjectType _type;
     SQObjectValue _unVal;
 }SQObject;
+#ifdef SQ_COMPACT_OBJECTS
+#pragma pack(pop)
+#endif
 
 typedef struct  tagSQMemberHandle{
     SQBool _static;
     SQInteger _index;
 }SQMemberHandle;
 
+typedef struct tagSQGCStats{
+    SQInteger cycles;       /* collection cycles completed */
+    SQInteger steps;        /* calls to sq_gcstep() and sq_collectgarbage() */
+    SQInteger work;         /* objects visited by the collector */
+    SQInteger freed;        /* unreachable objects freed */
+    SQInteger maxstep;      /* most objects visited by a single call */
+    SQInteger lastatomic;   /* objects visited by the atomic end of marking of the last cycle */
+    SQInteger maxatomic;    /* most objects visited by an atomic end of marking */
+}SQGCStats;
+
 typedef struct tagSQStackInfos{
     const SQChar* funcname;
     const SQChar* source;
@@ -203,8 +229,10 @@ typedef struct tagSQFunctionInfo {
 
 /*vm*/
 SQUIRREL_API HSQUIRRELVM sq_open(SQInteger initialstacksize);
+SQUIRREL_API HSQUIRRELVM sq_openex(SQInteger initialstacksize,SQInteger stringhash,SQUnsignedInteger hashseed);
 SQUIRREL_API HSQUIRRELVM sq_newthread(HSQUIRRELVM friendvm, SQInteger initialstacksize);
 SQUIRREL_API void sq_seterrorhandler(HSQUIRRELVM v);
+SQUIRREL_API void sq_geterrorhandler(HSQUIRRELVM v);
 SQUIRREL_API void sq_close(HSQUIRRELVM v);
 SQUIRREL_API void sq_setforeignptr(HSQUIRRELVM v,SQUserPointer p);
 SQUIRREL_API SQUserPointer sq_getforeignptr(HSQUIRRELVM v);
@@ -214,6 +242,8 @@ SQUIRREL_API void sq_setvmreleasehook(HSQUIRRELVM v,SQRELEASEHOOK hook);
 SQUIRREL_API SQRELEASEHOOK sq_getvmreleasehook(HSQUIRRELVM v);
 SQUIRREL_API void sq_setsharedreleasehook(HSQUIRRELVM v,SQRELEASEHOOK hook);
 SQUIRREL_API SQRELEASEHOOK sq_getsharedreleasehook(HSQUIRRELVM v);
+SQUIRREL_API void sq_setinternlimit(HSQUIRRELVM v, SQInteger limit);
+SQUIRREL_API SQInteger sq_getinternlimit(HSQUIRRELVM v);
 SQUIRREL_API void sq_setprintfunc(HSQUIRRELVM v, SQPRINTFUNCTION printfunc,SQPRINTFUNCTION errfunc);
 SQUIRREL_API SQPRINTFUNCTION sq_getprintfunc(HSQUIRRELVM v);
 SQUIRREL_API SQPRINTFUNCTION sq_geterrorfunc(HSQUIRRELVM v);
@@ -227,6 +257,7 @@ SQUIRREL_API SQRESULT sq_compile(HSQUIRRELVM v,SQLEXREADFUNC read,SQUserPointer
 SQUIRREL_API SQRESULT sq_compilebuffer(HSQUIRRELVM v,const SQChar *s,SQInteger size,const SQChar *sourcename,SQBool raiseerror);
 SQUIRREL_API void sq_enabledebuginfo(HSQUIRRELVM v, SQBool enable);
 SQUIRREL_API void sq_notifyallexceptions(HSQUIRRELVM v, SQBool enable);
+SQUIRREL_API SQRESULT sq_setjitenabled(HSQUIRRELVM v, SQBool enable);
 SQUIRREL_API void sq_setcompilererrorhandler(HSQUIRRELVM v,SQCOMPILERERROR f);
 
 /*stack operations*/
@@ -336,6 +367,7 @@ SQUIRREL_API SQRESULT sq_throwobject(HSQUIRRELVM v);
 SQUIRREL_API void sq_reseterror(HSQUIRRELVM v);
 SQUIRREL_API void sq_getlasterror(HSQUIRRELVM v);
 SQUIRREL_API SQRESULT sq_tailcall(HSQUIRRELVM v, SQInteger nparams);
+SQUIRREL_API SQRESULT sq_callk(HSQUIRRELVM v, SQInteger nparams, SQFUNCTION cont);
 
 /*raw object handling*/
 SQUIRREL_API SQRESULT sq_getstackobj(HSQUIRRELVM v,SQInteger idx,HSQOBJECT *po);
@@ -355,6 +387,9 @@ SQUIRREL_API SQUnsignedInteger sq_getvmrefcount(HSQUIRRELVM v, const HSQOBJECT *
 
 /*GC*/
 SQUIRREL_API SQInteger sq_collectgarbage(HSQUIRRELVM v);
+SQUIRREL_API SQInteger sq_gcstep(HSQUIRRELVM v,SQInteger budget);
+SQUIRREL_API SQRESULT sq_getgcstats(HSQUIRRELVM v,SQGCStats *stats);
+SQUIRREL_API void sq_resetgcstats(HSQUIRRELVM v);
 SQUIRREL_API SQRESULT sq_resurrectunreachable(HSQUIRRELVM v);
 
 /*serialization*/
@@ -365,6 +400,7 @@ SQUIRREL_API SQRESULT sq_readclosure(HSQUIRRELVM vm,SQREADFUNC readf,SQUserPoint
 SQUIRREL_API void *sq_malloc(SQUnsignedInteger size);
 SQUIRREL_API void *sq_realloc(void* p,SQUnsignedInteger oldsize,SQUnsignedInteger newsize);
 SQUIRREL_API void sq_free(void *p,SQUnsignedInteger size);
+SQUIRREL_API SQRESULT sq_getpoolstats(HSQUIRRELVM v,SQInteger sizeclass,SQInteger *blocksize,SQInteger *livebytes,SQInteger *freebytes);
 
 /*debug*/
 SQUIRREL_API SQRESULT sq_stackinfos(HSQUIRRELVM v,SQInteger level,SQStackInfos *si);
@@ -4,6 +4,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdarg.h>
+#include <time.h>
 
 #if defined(_MSC_VER) && defined(_DEBUG)
 #include <crtdbg.h>
@@ -15,6 +16,8 @@
 #include <sqstdio.h>
 #include <sqstdstreamreader.h>
 #include <sqstdtextio.h>
+#include <sqstdtypedarray.h>
+#include <sqstdfiber.h>
 #include <sqstdmath.h>
 #include <sqstdstring.h>
 #include <sqstdaux.h>
@@ -77,6 +80,10 @@ void PrintUsage()
         _SC("   -o              specifies output file for the -c option\n")
         _SC("   -c              compiles only\n")
         _SC("   -d              generates debug infos\n")
+        _SC("   -j              enables the JIT compiler\n")
+        _SC("   -s              uses the sampled string hash of older versions\n")
+        _SC("   -f              seeds the string hash with 0, for a reproducible order of the tables\n")
+        _SC("   -r              seeds the string hash randomly (default)\n")
         _SC("   -v              displays version infos\n")
         _SC("   -h              prints help\n"));
 }
@@ -108,6 +115,16 @@ int getargs(HSQUIRRELVM v,int argc, char* argv[],SQInteger *retval)
                 case 'd': //DEBUG(debug infos)
                     sq_enabledebuginfo(v,1);
                     break;
+                case 'j':
+                    if(SQ_FAILED(sq_setjitenabled(v,SQTrue))) {
+                        scfprintf(stderr,_SC("the JIT is not available in this build\n"));
+                    }
+                    break;
+                case 's':
+                case 'f':
+                case 'r':
+                    //handled by GetHashOptions()
+                    break;
                 case 'c':
                     compiles_only = 1;
                     break;
@@ -305,15 +322,42 @@ void Interactive(HSQUIRRELVM v)
     }
 }
 
+//the string hash is chosen when the VM is created, before getargs() runs. the seed is random
+//unless -f is given, so the scripts can't be fed keys that collide for a known seed
+void GetHashOptions(int argc, char* argv[],SQInteger *stringhash,SQUnsignedInteger *hashseed)
+{
+    int arg;
+    *stringhash = SQ_STRINGHASH_FULL;
+    *hashseed = (SQUnsignedInteger)time(NULL) ^ ((SQUnsignedInteger)clock() << 16) ^ (SQUnsignedInteger)(size_t)&arg;
+    for(arg = 1; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        switch(argv[arg][1])
+        {
+        case 's':
+            *stringhash = SQ_STRINGHASH_SAMPLED;
+            break;
+        case 'f':
+            *hashseed = 0;
+            break;
+        case 'o':
+            arg++;
+            break;
+        }
+    }
+}
+
 int main(int argc, char* argv[])
 {
     HSQUIRRELVM v;
     SQInteger retval = 0;
+    SQInteger stringhash;
+    SQUnsignedInteger hashseed;
 #if defined(_MSC_VER) && defined(_DEBUG)
     _CrtSetAllocHook(MemAllocHook);
 #endif
 
-    v=sq_open(1024);
+    GetHashOptions(argc,argv,&stringhash,&hashseed);
+    v=sq_openex(1024,stringhash,hashseed);
     sq_setprintfunc(v,printfunc,errorfunc);
 
     sq_pushroottable(v);
@@ -326,6 +370,8 @@ int main(int argc, char* argv[])
     sqstd_register_stringlib(v);
     sqstd_register_streamreaderlib(v);
     sqstd_register_textiolib(v);
+    sqstd_register_typedarraylib(v);
+    sqstd_register_fiberlib(v);
 
     //aux library
     //sets error handlers
@@ -0,0 +1,914 @@
+/* see copyright notice in squirrel.h */
+#ifndef _WIN32
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#if defined(__linux__) && !defined(SQSTD_NO_EPOLL)
+#define SQSTD_EPOLL
+#include <sys/epoll.h>
+#endif
+#include <squirrel.h>
+#include <sqstdaux.h>
+#include <sqstdblob.h>
+#include <sqstdstream.h>
+#include <sqstdfiber.h>
+#include "sqstdfiberimpl.h"
+
+//Async streams
+//an async stream reads and writes a non blocking descriptor: a pipe, a file, a local socket or
+//the pipe of a child process. when a task of the scheduler that created the stream calls
+//readblob(), readline(), writeblob(), print() or accept() and the descriptor is not ready, the
+//operation is parked on the stream and the task is suspended; the poller of the scheduler
+//(epoll on linux, poll() elsewhere) completes it when the descriptor becomes ready, pushes the
+//result on the stack of the task and moves the task to the run queue.
+//called from outside of the tasks, and through the SQStream interface, the stream blocks like a file.
+//a stream with a waiting task is referenced with sq_addref() until the operation completes.
+
+#define AS_DONE     0
+#define AS_AGAIN    1
+#define AS_ERROR    2
+
+#define AS_READ     0
+#define AS_READLINE 1
+#define AS_ACCEPT   2
+#define AS_WRITE    3
+
+#define AS_BUFSIZE  4096
+
+static HSQMEMBERHANDLE as__sched_handle;
+
+struct SQPoller;
+
+struct SQAsyncOp
+{
+    SQTask *_task; //the waiting task, NULL if there is none
+    SQInteger _type;
+    SQInteger _size; //AS_READ only
+    HSQOBJECT _self; //the stream, referenced while the task waits
+};
+
+struct SQAsyncStream : public SQStream
+{
+    SQAsyncStream(SQScheduler *sched,SQPoller *poller,int fd,FILE *pipe,bool socket);
+    ~SQAsyncStream();
+    void _Release() {
+        this->~SQAsyncStream();
+        sq_free(this,sizeof(SQAsyncStream));
+    }
+    SQInteger Read(void *buffer,SQInteger size);
+    SQInteger Write(const void *buffer,SQInteger size);
+    SQInteger Flush() { return 0; }
+    SQInteger Tell() {
+        if(!_regular) return -1;
+        return (SQInteger)lseek(_fd,0,SEEK_CUR) - (_inlen - _inpos);
+    }
+    SQInteger Len() {
+        struct stat st;
+        if(!_regular || fstat(_fd,&st) != 0) return -1;
+        return (SQInteger)st.st_size;
+    }
+    SQInteger Seek(SQInteger offset,SQInteger origin) {
+        int whence;
+        if(!_regular) return -1;
+        switch(origin) {
+            case SQ_SEEK_CUR: whence = SEEK_CUR; offset -= _inlen - _inpos; break;
+            case SQ_SEEK_END: whence = SEEK_END; break;
+            case SQ_SEEK_SET: whence = SEEK_SET; break;
+            default: return -1;
+        }
+        _inpos = _inlen = _scan = 0;
+        _eof = false;
+        return lseek(_fd,(off_t)offset,whence) < 0 ? -1 : 0;
+    }
+    bool IsValid() { return _fd >= 0; }
+    bool EOS() { return _eof && _inpos == _inlen; }
+    SQInteger Close();
+    SQInteger Fill(SQInteger size);
+    ssize_t RawWrite(const void *buffer,SQInteger size) {
+#ifdef MSG_NOSIGNAL
+        if(_socket) return send(_fd,buffer,size,MSG_NOSIGNAL);
+#endif
+        return write(_fd,buffer,size);
+    }
+
+    SQScheduler *_sched; //kept alive by the _sched member
+    SQPoller *_poller;
+    int _fd;
+    FILE *_pipe; //popen() streams are closed with pclose()
+    unsigned char *_in; //read and not consumed yet: _in[_inpos] ... _in[_inlen - 1]
+    SQInteger _inpos;
+    SQInteger _inlen;
+    SQInteger _inalloc;
+    SQInteger _scan; //characters after _inpos already searched for a new line
+    unsigned char *_out; //the write in progress: _out[_outpos] ... _out[_outlen - 1] is left
+    SQInteger _outpos;
+    SQInteger _outlen;
+    SQInteger _outalloc;
+    SQAsyncOp _rd;
+    SQAsyncOp _wr;
+    SQAsyncStream *_next; //poll() only, in the list of the watched streams
+    bool _regular; //a regular file is always ready
+    bool _socket;
+    bool _eof;
+    bool _watched;
+};
+
+struct SQPoller : public SQSchedPoller
+{
+    SQPoller(SQScheduler *sched) {
+        _waiting = 0;
+        _sched = sched;
+        _refs = 1;
+#ifdef SQSTD_EPOLL
+        _epfd = epoll_create1(EPOLL_CLOEXEC);
+#else
+        _list = NULL;
+        _nwatched = 0;
+        _pfds = NULL;
+        _streams = NULL;
+        _alloc = 0;
+#endif
+    }
+    ~SQPoller() {
+#ifdef SQSTD_EPOLL
+        if(_epfd >= 0) close(_epfd);
+#else
+        if(_pfds) sq_free(_pfds,_alloc * sizeof(struct pollfd));
+        if(_streams) sq_free(_streams,_alloc * sizeof(SQAsyncStream *));
+#endif
+    }
+    bool IsValid() {
+#ifdef SQSTD_EPOLL
+        return _epfd >= 0;
+#else
+        return true;
+#endif
+    }
+    void Release() {
+        if(--_refs == 0) {
+            this->~SQPoller();
+            sq_free(this,sizeof(SQPoller));
+        }
+    }
+    bool Watch(SQAsyncStream *s);
+    void Forget(SQAsyncStream *s);
+    void Poll(HSQUIRRELVM v,double timeout);
+    bool Complete(HSQUIRRELVM v,SQAsyncStream *s,SQAsyncOp *op,HSQOBJECT *ref);
+    void Dispatch(HSQUIRRELVM v,SQAsyncStream *s,bool rd,bool wr);
+
+    SQScheduler *_sched; //valid while Poll() runs, the poller can outlive the scheduler
+    SQInteger _refs; //the scheduler and its streams
+#ifdef SQSTD_EPOLL
+    int _epfd;
+#else
+    SQAsyncStream *_list; //the streams with a waiting task
+    SQInteger _nwatched;
+    struct pollfd *_pfds;
+    SQAsyncStream **_streams;
+    SQInteger _alloc;
+#endif
+};
+
+static bool _as_nonblock(int fd)
+{
+    int flags = fcntl(fd,F_GETFL);
+    if(flags < 0 || fcntl(fd,F_SETFL,flags | O_NONBLOCK) < 0) return false;
+    return fcntl(fd,F_SETFD,FD_CLOEXEC) == 0;
+}
+
+//blocks until fd is ready
+static bool _as_waitfd(int fd,short events)
+{
+    struct pollfd p;
+    p.fd = fd;
+    p.events = events;
+    p.revents = 0;
+    while(poll(&p,1,-1) < 0) {
+        if(errno != EINTR) return false;
+    }
+    return true;
+}
+
+static bool _as_wouldblock()
+{
+    return errno == EAGAIN || errno == EWOULDBLOCK;
+}
+
+SQAsyncStream::SQAsyncStream(SQScheduler *sched,SQPoller *poller,int fd,FILE *pipe,bool socket)
+{
+    struct stat st;
+    _sched = sched;
+    _poller = poller;
+    _poller->_refs++;
+    _fd = fd;
+    _pipe = pipe;
+    _in = _out = NULL;
+    _inpos = _inlen = _inalloc = _scan = 0;
+    _outpos = _outlen = _outalloc = 0;
+    memset(&_rd,0,sizeof(_rd));
+    memset(&_wr,0,sizeof(_wr));
+    _next = NULL;
+    _regular = fstat(fd,&st) == 0 && S_ISREG(st.st_mode);
+    _socket = socket;
+    _eof = false;
+    _watched = false;
+}
+
+SQAsyncStream::~SQAsyncStream()
+{
+    Close();
+    if(_in) sq_free(_in,_inalloc);
+    if(_out) sq_free(_out,_outalloc);
+    _poller->Release();
+}
+
+//returns the exit status of the command for popen() streams, -1 if it didn't exit normally
+SQInteger SQAsyncStream::Close()
+{
+    SQInteger r = 0;
+    if(_fd < 0) return 0;
+    _poller->Forget(this);
+    if(_pipe) {
+        int status = pclose(_pipe);
+        r = (status != -1 && WIFEXITED(status)) ? WEXITSTATUS(status) : -1;
+    }
+    else r = close(_fd);
+    _fd = -1;
+    _pipe = NULL;
+    return r;
+}
+
+//reads what is available after the buffered bytes, at least 'size' bytes of room.
+//returns the bytes read, 0 at the end of the stream, -1 if it would block and -2 on errors
+SQInteger SQAsyncStream::Fill(SQInteger size)
+{
+    if(_inpos == _inlen) {
+        _inpos = _inlen = 0;
+    }
+    if(_inalloc - _inlen < size) {
+        if(_inpos) {
+            memmove(_in,_in + _inpos,_inlen - _inpos);
+            _inlen -= _inpos;
+            _inpos = 0;
+        }
+        if(_inalloc - _inlen < size) {
+            SQInteger newalloc = _inlen + size;
+            _in = (unsigned char *)sq_realloc(_in,_inalloc,newalloc);
+            _inalloc = newalloc;
+        }
+    }
+    for(;;) {
+        ssize_t r = read(_fd,_in + _inlen,_inalloc - _inlen);
+        if(r > 0) {
+            _inlen += r;
+            return r;
+        }
+        if(r == 0) {
+            _eof = true;
+            return 0;
+        }
+        if(errno != EINTR)
+            return _as_wouldblock() ? -1 : -2;
+    }
+}
+
+SQInteger SQAsyncStream::Read(void *buffer,SQInteger size)
+{
+    SQInteger n = 0;
+    while(n < size) {
+        if(_inpos < _inlen) {
+            SQInteger avail = _inlen - _inpos;
+            SQInteger c = avail < size - n ? avail : size - n;
+            memcpy((unsigned char *)buffer + n,_in + _inpos,c);
+            _inpos += c;
+            _scan = 0;
+            n += c;
+            continue;
+        }
+        ssize_t r = read(_fd,(unsigned char *)buffer + n,size - n);
+        if(r > 0) {
+            n += r;
+        }
+        else if(r == 0) {
+            _eof = true;
+            break;
+        }
+        else if(_as_wouldblock()) {
+            if(!_as_waitfd(_fd,POLLIN)) break;
+        }
+        else if(errno != EINTR) {
+            break;
+        }
+    }
+    return n;
+}
+
+SQInteger SQAsyncStream::Write(const void *buffer,SQInteger size)
+{
+    SQInteger n = 0;
+    while(n < size) {
+        ssize_t r = RawWrite((const unsigned char *)buffer + n,size - n);
+        if(r >= 0) {
+            n += r;
+        }
+        else if(_as_wouldblock()) {
+            if(!_as_waitfd(_fd,POLLOUT)) break;
+        }
+        else if(errno != EINTR) {
+            break;
+        }
+    }
+    return n;
+}
+
+//creates an async stream for fd and pushes it, the scheduler instance is at 'schedidx'
+static SQRESULT _as_create(HSQUIRRELVM v,SQScheduler *sched,SQInteger schedidx,int fd,FILE *pipe,bool socket)
+{
+    SQInteger top = sq_gettop(v);
+    if(!sched->_poller) {
+        SQPoller *p = new (sq_malloc(sizeof(SQPoller)))SQPoller(sched);
+        if(!p->IsValid()) {
+            p->Release();
+            if(pipe) pclose(pipe);
+            else close(fd);
+            return sq_throwerror(v,_SC("cannot create the poller"));
+        }
+        sched->_poller = p;
+    }
+    SQAsyncStream *s = new (sq_malloc(sizeof(SQAsyncStream)))SQAsyncStream(sched,(SQPoller *)sched->_poller,fd,pipe,socket);
+    sq_pushregistrytable(v);
+    sq_pushstring(v,_sqstd_asyncstream_decl.reg_name,-1);
+    if(SQ_SUCCEEDED(sq_get(v,-2))) {
+        sq_remove(v,-2); //removes the registry
+        sq_pushroottable(v);
+        sq_pushuserpointer(v,s);
+        if(SQ_SUCCEEDED(sq_call(v,2,SQTrue,SQFalse))) {
+            sq_remove(v,-2); //removes the class
+            sq_push(v,schedidx);
+            sq_setbyhandle(v,-2,&as__sched_handle);
+            return SQ_OK;
+        }
+    }
+    sq_settop(v,top);
+    s->_Release();
+    return sq_throwerror(v,_SC("cannot create the stream"));
+}
+
+//tries an operation of the stream at 'selfidx' without blocking, when it is done pushes its result
+static SQInteger _as_attempt(HSQUIRRELVM v,SQAsyncStream *s,SQInteger selfidx,SQInteger type,SQInteger size)
+{
+    switch(type) {
+    case AS_READ: {
+        if(s->_inpos == s->_inlen) {
+            SQInteger r = s->Fill(size < AS_BUFSIZE ? AS_BUFSIZE : size);
+            if(r == -1) return AS_AGAIN;
+            if(r <= 0) {
+                sq_throwerror(v,r ? _SC("io error") : _SC("no data left to read"));
+                return AS_ERROR;
+            }
+        }
+        SQInteger n = s->_inlen - s->_inpos;
+        if(n > size) n = size;
+        memcpy(sqstd_createblob(v,n),s->_in + s->_inpos,n);
+        s->_inpos += n;
+        s->_scan = 0;
+        return AS_DONE;
+    }
+    case AS_READLINE:
+        for(;;) {
+            const SQChar *buf = (const SQChar *)(s->_in + s->_inpos);
+            SQInteger len = (s->_inlen - s->_inpos) / sizeof(SQChar);
+            for(SQInteger i = s->_scan; i < len; i++) {
+                if(buf[i] == _SC('\n')) {
+                    sq_pushstring(v,buf,i + 1);
+                    s->_inpos += (i + 1) * sizeof(SQChar);
+                    s->_scan = 0;
+                    return AS_DONE;
+                }
+            }
+            s->_scan = len;
+            SQInteger r = s->Fill(AS_BUFSIZE);
+            if(r == -1) return AS_AGAIN;
+            if(r == -2) {
+                sq_throwerror(v,_SC("io error"));
+                return AS_ERROR;
+            }
+            if(r == 0) {
+                //the last line, "" at the end of the stream
+                sq_pushstring(v,(const SQChar *)(s->_in + s->_inpos),len);
+                s->_inpos = s->_inlen;
+                s->_scan = 0;
+                return AS_DONE;
+            }
+        }
+    case AS_ACCEPT: {
+        int fd;
+        while((fd = accept(s->_fd,NULL,NULL)) < 0) {
+            if(errno == EINTR) continue;
+            if(_as_wouldblock() || errno == ECONNABORTED) return AS_AGAIN;
+            sq_throwerror(v,_SC("accept failed"));
+            return AS_ERROR;
+        }
+        if(!_as_nonblock(fd)) {
+            close(fd);
+            sq_throwerror(v,_SC("accept failed"));
+            return AS_ERROR;
+        }
+        if(SQ_FAILED(sq_getbyhandle(v,selfidx,&as__sched_handle))) {
+            close(fd);
+            return AS_ERROR;
+        }
+        SQInteger sched = sq_gettop(v);
+        if(SQ_FAILED(_as_create(v,s->_sched,sched,fd,NULL,true))) {
+            sq_poptop(v);
+            return AS_ERROR;
+        }
+        sq_remove(v,sched);
+        return AS_DONE;
+    }
+    case AS_WRITE:
+        while(s->_outpos < s->_outlen) {
+            ssize_t r = s->RawWrite(s->_out + s->_outpos,s->_outlen - s->_outpos);
+            if(r >= 0) {
+                s->_outpos += r;
+            }
+            else if(_as_wouldblock()) {
+                return AS_AGAIN;
+            }
+            else if(errno != EINTR) {
+                s->_outpos = s->_outlen = 0;
+                sq_throwerror(v,_SC("io error"));
+                return AS_ERROR;
+            }
+        }
+        sq_pushinteger(v,s->_outlen);
+        s->_outpos = s->_outlen = 0;
+        return AS_DONE;
+    }
+    return AS_ERROR;
+}
+
+//runs an operation for the stream at 1, a task waits for it and the other callers block
+static SQInteger _as_run(HSQUIRRELVM v,SQAsyncStream *s,SQAsyncOp *op,SQInteger type,SQInteger size)
+{
+    for(;;) {
+        SQInteger r = _as_attempt(v,s,1,type,size);
+        if(r == AS_DONE) return 1;
+        if(r == AS_ERROR) return SQ_ERROR;
+        SQTask *t = _sched_current(v,s->_sched);
+        if(t) {
+            SQInteger res = sq_suspendvm(v);
+            if(res == SQ_ERROR) return res;
+            op->_task = t;
+            op->_type = type;
+            op->_size = size;
+            if(!s->_poller->Watch(s)) {
+                op->_task = NULL;
+                return sq_throwerror(v,_SC("cannot wait on the stream"));
+            }
+            sq_getstackobj(v,1,&op->_self);
+            sq_addref(v,&op->_self);
+            t->_state = TASK_WAITING;
+            s->_poller->_waiting++;
+            return res;
+        }
+        if(!_as_waitfd(s->_fd,type == AS_WRITE ? POLLOUT : POLLIN))
+            return sq_throwerror(v,_SC("io error"));
+    }
+}
+
+//completes the operation if the stream is ready, the task will release 'ref'
+bool SQPoller::Complete(HSQUIRRELVM v,SQAsyncStream *s,SQAsyncOp *op,HSQOBJECT *ref)
+{
+    SQInteger top = sq_gettop(v);
+    sq_pushobject(v,op->_self);
+    SQInteger r = _as_attempt(v,s,top + 1,op->_type,op->_size);
+    if(r == AS_AGAIN) {
+        sq_settop(v,top);
+        return false;
+    }
+    SQTask *t = op->_task;
+    if(r == AS_ERROR) {
+        sq_getlasterror(v);
+        sq_reseterror(v);
+        t->_wakethrow = true;
+    }
+    else {
+        t->_wakeret = true;
+    }
+    sq_move(t->_thread,v,-1);
+    sq_settop(v,top);
+    *ref = op->_self;
+    op->_task = NULL;
+    _waiting--;
+    _sched_ready(_sched,t);
+    return true;
+}
+
+void SQPoller::Dispatch(HSQUIRRELVM v,SQAsyncStream *s,bool rd,bool wr)
+{
+    HSQOBJECT refs[2];
+    SQInteger nrefs = 0;
+    if(rd && s->_rd._task && Complete(v,s,&s->_rd,&refs[nrefs])) nrefs++;
+    if(wr && s->_wr._task && Complete(v,s,&s->_wr,&refs[nrefs])) nrefs++;
+    if(s->_rd._task || s->_wr._task) Watch(s);
+#ifndef SQSTD_EPOLL
+    else Forget(s);
+#endif
+    //the last reference can release the stream
+    for(SQInteger i = 0; i < nrefs; i++)
+        sq_release(v,&refs[i]);
+}
+
+#ifdef SQSTD_EPOLL
+
+//the descriptor is armed once (EPOLLONESHOT) for the operations waiting on it,
+//it stays registered and disarmed until the stream is closed
+bool SQPoller::Watch(SQAsyncStream *s)
+{
+    struct epoll_event ev;
+    ev.events = EPOLLONESHOT;
+    if(s->_rd._task) ev.events |= EPOLLIN;
+    if(s->_wr._task) ev.events |= EPOLLOUT;
+    ev.data.ptr = s;
+    if(s->_watched)
+        return epoll_ctl(_epfd,EPOLL_CTL_MOD,s->_fd,&ev) == 0;
+    if(epoll_ctl(_epfd,EPOLL_CTL_ADD,s->_fd,&ev) != 0)
+        return false;
+    s->_watched = true;
+    return true;
+}
+
+void SQPoller::Forget(SQAsyncStream *s)
+{
+    if(s->_watched) {
+        epoll_ctl(_epfd,EPOLL_CTL_DEL,s->_fd,NULL);
+        s->_watched = false;
+    }
+}
+
+void SQPoller::Poll(HSQUIRRELVM v,double timeout)
+{
+    struct epoll_event evs[64];
+    int ms = timeout < 0 ? -1 : (int)(timeout * 1000.0 + 0.999);
+    int n = epoll_wait(_epfd,evs,64,ms);
+    for(int i = 0; i < n; i++) {
+        SQAsyncStream *s = (SQAsyncStream *)evs[i].data.ptr;
+        unsigned int e = evs[i].events;
+        Dispatch(v,s,(e & (EPOLLIN | EPOLLERR | EPOLLHUP)) != 0,(e & (EPOLLOUT | EPOLLERR | EPOLLHUP)) != 0);
+    }
+}
+
+#else
+
+bool SQPoller::Watch(SQAsyncStream *s)
+{
+    if(!s->_watched) {
+        s->_next = _list;
+        _list = s;
+        s->_watched = true;
+        _nwatched++;
+    }
+    return true;
+}
+
+void SQPoller::Forget(SQAsyncStream *s)
+{
+    if(!s->_watched) return;
+    SQAsyncStream **p = &_list;
+    while(*p != s) p = &(*p)->_next;
+    *p = s->_next;
+    s->_next = NULL;
+    s->_watched = false;
+    _nwatched--;
+}
+
+void SQPoller::Poll(HSQUIRRELVM v,double timeout)
+{
+    if(_alloc < _nwatched) {
+        SQInteger n = _nwatched * 2;
+        _pfds = (struct pollfd *)sq_realloc(_pfds,_alloc * sizeof(struct pollfd),n * sizeof(struct pollfd));
+        _streams = (SQAsyncStream **)sq_realloc(_streams,_alloc * sizeof(SQAsyncStream *),n * sizeof(SQAsyncStream *));
+        _alloc = n;
+    }
+    SQInteger count = 0;
+    for(SQAsyncStream *s = _list; s; s = s->_next) {
+        _pfds[count].fd = s->_fd;
+        _pfds[count].events = (s->_rd._task ? POLLIN : 0) | (s->_wr._task ? POLLOUT : 0);
+        _pfds[count].revents = 0;
+        _streams[count++] = s;
+    }
+    int ms = timeout < 0 ? -1 : (int)(timeout * 1000.0 + 0.999);
+    if(poll(_pfds,(nfds_t)count,ms) <= 0) return;
+    for(SQInteger i = 0; i < count; i++) {
+        short e = _pfds[i].revents;
+        if(e) Dispatch(v,_streams[i],(e & (POLLIN | POLLERR | POLLHUP)) != 0,(e & (POLLOUT | POLLERR | POLLHUP)) != 0);
+    }
+}
+
+#endif
+
+#define SETUP_ASTREAM(v) \
+    SQAsyncStream *self = NULL; \
+    if(SQ_FAILED(sq_getinstanceup(v,1,(SQUserPointer*)&self,(SQUserPointer)SQSTD_ASYNCSTREAM_TYPE_TAG))) \
+        return sq_throwerror(v,_SC("invalid type tag")); \
+    if(!self || !self->IsValid()) \
+        return sq_throwerror(v,_SC("the stream is invalid"));
+
+#define SETUP_ASOP(op) \
+    if(self->op._task) \
+        return sq_throwerror(v,_SC("another task is waiting on the stream"));
+
+static SQInteger _asyncstream_constructor(HSQUIRRELVM v)
+{
+    SQAsyncStream *s;
+    if(sq_gettype(v,2) != OT_USERPOINTER)
+        return sq_throwerror(v,_SC("async streams are created by a scheduler"));
+    sq_getuserpointer(v,2,(SQUserPointer*)&s);
+    if(SQ_FAILED(sq_setinstanceup(v,1,s)))
+        return sq_throwerror(v,_SC("cannot create stream instance"));
+    sq_setreleasehook(v,1,__sqstd_stream_releasehook);
+    return 0;
+}
+
+static SQInteger _asyncstream_readblob(HSQUIRRELVM v)
+{
+    SETUP_ASTREAM(v)
+    SETUP_ASOP(_rd)
+    SQInteger size;
+    sq_getinteger(v,2,&size);
+    if(size <= 0)
+        return sq_throwerror(v,_SC("the size must be positive"));
+    return _as_run(v,self,&self->_rd,AS_READ,size);
+}
+
+static SQInteger _asyncstream_readline(HSQUIRRELVM v)
+{
+    SETUP_ASTREAM(v)
+    SETUP_ASOP(_rd)
+    return _as_run(v,self,&self->_rd,AS_READLINE,0);
+}
+
+static SQInteger _asyncstream_accept(HSQUIRRELVM v)
+{
+    SETUP_ASTREAM(v)
+    SETUP_ASOP(_rd)
+    return _as_run(v,self,&self->_rd,AS_ACCEPT,0);
+}
+
+//copies the data to write, the write completes when all of it is written
+static SQInteger _as_write(HSQUIRRELVM v,SQAsyncStream *self,const void *data,SQInteger size)
+{
+    if(self->_outalloc < size) {
+        self->_out = (unsigned char *)sq_realloc(self->_out,self->_outalloc,size);
+        self->_outalloc = size;
+    }
+    memcpy(self->_out,data,size);
+    self->_outpos = 0;
+    self->_outlen = size;
+    return _as_run(v,self,&self->_wr,AS_WRITE,size);
+}
+
+static SQInteger _asyncstream_writeblob(HSQUIRRELVM v)
+{
+    SETUP_ASTREAM(v)
+    SETUP_ASOP(_wr)
+    SQUserPointer data;
+    if(SQ_FAILED(sqstd_getblob(v,2,&data)))
+        return sq_throwerror(v,_SC("invalid parameter"));
+    return _as_write(v,self,data,sqstd_getblobsize(v,2));
+}
+
+static SQInteger _asyncstream_print(HSQUIRRELVM v)
+{
+    SETUP_ASTREAM(v)
+    SETUP_ASOP(_wr)
+    const SQChar *data;
+    sq_getstring(v,2,&data);
+    return _as_write(v,self,data,sq_getsize(v,2) * sizeof(SQChar));
+}
+
+//the tasks waiting on the stream get an exception
+static SQInteger _asyncstream_close(HSQUIRRELVM v)
+{
+    SQAsyncStream *self = NULL;
+    if(SQ_FAILED(sq_getinstanceup(v,1,(SQUserPointer*)&self,(SQUserPointer)SQSTD_ASYNCSTREAM_TYPE_TAG)) || !self)
+        return sq_throwerror(v,_SC("invalid type tag"));
+    HSQOBJECT refs[2];
+    SQInteger nrefs = 0;
+    SQAsyncOp *ops[2] = { &self->_rd, &self->_wr };
+    for(SQInteger i = 0; i < 2; i++) {
+        SQTask *t = ops[i]->_task;
+        if(!t) continue;
+        sq_pushstring(t->_thread,_SC("the stream was closed"),-1);
+        t->_wakethrow = true;
+        _sched_ready(self->_sched,t);
+        ops[i]->_task = NULL;
+        self->_poller->_waiting--;
+        refs[nrefs++] = ops[i]->_self;
+    }
+    sq_pushinteger(v,self->Close());
+    for(SQInteger i = 0; i < nrefs; i++)
+        sq_release(v,&refs[i]);
+    return 1;
+}
+
+static SQInteger _asyncstream__typeof(HSQUIRRELVM v)
+{
+    sq_pushstring(v,_sqstd_asyncstream_decl.name,-1);
+    return 1;
+}
+
+#define _DECL_ASYNCSTREAM_FUNC(name,nparams,typecheck) {_SC(#name),_asyncstream_##name,nparams,typecheck}
+static const SQRegFunction _asyncstream_methods[] = {
+    _DECL_ASYNCSTREAM_FUNC(constructor,2,_SC("x")),
+    _DECL_ASYNCSTREAM_FUNC(readblob,2,_SC("xn")),
+    _DECL_ASYNCSTREAM_FUNC(readline,1,_SC("x")),
+    _DECL_ASYNCSTREAM_FUNC(writeblob,2,_SC("xx")),
+    _DECL_ASYNCSTREAM_FUNC(print,2,_SC("xs")),
+    _DECL_ASYNCSTREAM_FUNC(accept,1,_SC("x")),
+    _DECL_ASYNCSTREAM_FUNC(close,1,_SC("x")),
+    _DECL_ASYNCSTREAM_FUNC(_typeof,1,_SC("x")),
+    {NULL,(SQFUNCTION)0,0,NULL}
+};
+#undef _DECL_ASYNCSTREAM_FUNC
+
+static const SQRegMember _asyncstream_members[] = {
+    {_SC("_sched"), &as__sched_handle },
+    {NULL,NULL}
+};
+
+const SQRegClass _sqstd_asyncstream_decl = {
+    &_sqstd_stream_decl,    // base_class
+    _SC("std_asyncstream"), // reg_name
+    _SC("asyncstream"),     // name
+    _asyncstream_members,   // members
+    _asyncstream_methods,   // methods
+    NULL,                   // globals
+};
+
+//the methods of the scheduler that open streams
+
+#define SETUP_SCHED(v) \
+    SQScheduler *self = NULL; \
+    if(SQ_FAILED(sq_getinstanceup(v,1,(SQUserPointer*)&self,(SQUserPointer)SQSTD_SCHEDULER_TYPE_TAG))) \
+        return sq_throwerror(v,_SC("invalid type tag")); \
+    if(!self) \
+        return sq_throwerror(v,_SC("the scheduler is invalid"));
+
+//pipe(), returns [reader, writer]
+static SQInteger _scheduler_pipe(HSQUIRRELVM v)
+{
+    SETUP_SCHED(v)
+    int fds[2];
+    if(pipe(fds) != 0)
+        return sq_throwerror(v,_SC("cannot create the pipe"));
+    if(!_as_nonblock(fds[0]) || !_as_nonblock(fds[1])) {
+        close(fds[0]);
+        close(fds[1]);
+        return sq_throwerror(v,_SC("cannot create the pipe"));
+    }
+    sq_newarray(v,0);
+    if(SQ_FAILED(_as_create(v,self,1,fds[0],NULL,false))) {
+        close(fds[1]);
+        return SQ_ERROR;
+    }
+    sq_arrayappend(v,-2);
+    if(SQ_FAILED(_as_create(v,self,1,fds[1],NULL,false)))
+        return SQ_ERROR;
+    sq_arrayappend(v,-2);
+    return 1;
+}
+
+//open(filename, mode), the modes of fopen()
+static SQInteger _scheduler_open(HSQUIRRELVM v)
+{
+    SETUP_SCHED(v)
+    const SQChar *filename,*mode;
+    sq_getstring(v,2,&filename);
+    sq_getstring(v,3,&mode);
+    int flags;
+    switch(mode[0]) {
+        case _SC('r'): flags = O_RDONLY; break;
+        case _SC('w'): flags = O_WRONLY | O_CREAT | O_TRUNC; break;
+        case _SC('a'): flags = O_WRONLY | O_CREAT | O_APPEND; break;
+        default: return sq_throwerror(v,_SC("invalid mode"));
+    }
+    for(const SQChar *m = mode + 1; *m; m++) {
+        if(*m == _SC('+')) flags = (flags & ~(O_RDONLY | O_WRONLY)) | O_RDWR;
+    }
+#ifdef SQUNICODE
+    return sq_throwerror(v,_SC("async streams do not support unicode file names"));
+#else
+    int fd = open(filename,flags | O_NONBLOCK | O_CLOEXEC,0666);
+    if(fd < 0)
+        return sq_throwerror(v,_SC("cannot open file"));
+    if(SQ_FAILED(_as_create(v,self,1,fd,NULL,false)))
+        return SQ_ERROR;
+    return 1;
+#endif
+}
+
+//popen(command, mode), reads the output ("r") or writes the input ("w") of the command
+static SQInteger _scheduler_popen(HSQUIRRELVM v)
+{
+    SETUP_SCHED(v)
+    const SQChar *command,*mode;
+    sq_getstring(v,2,&command);
+    sq_getstring(v,3,&mode);
+    if((mode[0] != _SC('r') && mode[0] != _SC('w')) || mode[1])
+        return sq_throwerror(v,_SC("invalid mode"));
+#ifdef SQUNICODE
+    return sq_throwerror(v,_SC("async streams do not support unicode commands"));
+#else
+    FILE *f = popen(command,mode);
+    if(!f)
+        return sq_throwerror(v,_SC("cannot run the command"));
+    if(!_as_nonblock(fileno(f))) {
+        pclose(f);
+        return sq_throwerror(v,_SC("cannot run the command"));
+    }
+    if(SQ_FAILED(_as_create(v,self,1,fileno(f),f,false)))
+        return SQ_ERROR;
+    return 1;
+#endif
+}
+
+static bool _as_address(HSQUIRRELVM v,struct sockaddr_un *addr)
+{
+    const SQChar *path;
+    sq_getstring(v,2,&path);
+    memset(addr,0,sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if(sq_getsize(v,2) >= (SQInteger)sizeof(addr->sun_path)) return false;
+#ifdef SQUNICODE
+    return false;
+#else
+    strcpy(addr->sun_path,path);
+    return true;
+#endif
+}
+
+//connect(path), a stream connected to the local socket at 'path'
+static SQInteger _scheduler_connect(HSQUIRRELVM v)
+{
+    SETUP_SCHED(v)
+    struct sockaddr_un addr;
+    if(!_as_address(v,&addr))
+        return sq_throwerror(v,_SC("invalid socket path"));
+    int fd = socket(AF_UNIX,SOCK_STREAM,0);
+    if(fd < 0)
+        return sq_throwerror(v,_SC("cannot create the socket"));
+    //a local connect does not wait for the other side
+    if(connect(fd,(struct sockaddr *)&addr,sizeof(addr)) != 0 || !_as_nonblock(fd)) {
+        close(fd);
+        return sq_throwerror(v,_SC("cannot connect"));
+    }
+    if(SQ_FAILED(_as_create(v,self,1,fd,NULL,true)))
+        return SQ_ERROR;
+    return 1;
+}
+
+//listen(path [, backlog]), a stream that accepts the connections to the local socket at 'path'
+static SQInteger _scheduler_listen(HSQUIRRELVM v)
+{
+    SETUP_SCHED(v)
+    struct sockaddr_un addr;
+    SQInteger backlog = SOMAXCONN;
+    if(sq_gettop(v) > 2) sq_getinteger(v,3,&backlog);
+    if(!_as_address(v,&addr))
+        return sq_throwerror(v,_SC("invalid socket path"));
+    int fd = socket(AF_UNIX,SOCK_STREAM,0);
+    if(fd < 0)
+        return sq_throwerror(v,_SC("cannot create the socket"));
+    if(bind(fd,(struct sockaddr *)&addr,sizeof(addr)) != 0
+        || listen(fd,(int)backlog) != 0 || !_as_nonblock(fd)) {
+        close(fd);
+        return sq_throwerror(v,_SC("cannot listen on the socket"));
+    }
+    if(SQ_FAILED(_as_create(v,self,1,fd,NULL,true)))
+        return SQ_ERROR;
+    return 1;
+}
+
+#define _DECL_SCHEDULER_FUNC(name,nparams,typecheck) {_SC(#name),_scheduler_##name,nparams,typecheck}
+const SQRegFunction _sqstd_scheduler_iomethods[] = {
+    _DECL_SCHEDULER_FUNC(pipe,1,_SC("x")),
+    _DECL_SCHEDULER_FUNC(open,3,_SC("xss")),
+    _DECL_SCHEDULER_FUNC(popen,3,_SC("xss")),
+    _DECL_SCHEDULER_FUNC(connect,2,_SC("xs")),
+    _DECL_SCHEDULER_FUNC(listen,-2,_SC("xsn")),
+    {NULL,(SQFUNCTION)0,0,NULL}
+};
+#undef _DECL_SCHEDULER_FUNC
+
+#endif /* _WIN32 */
@@ -0,0 +1,669 @@
+/* see copyright notice in squirrel.h */
+#include <stdlib.h>
+#include <string.h>
+#include <squirrel.h>
+#include <sqstdaux.h>
+#include <sqstdfiber.h>
+#include "sqstdfiberimpl.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+//Fibers
+//a scheduler runs its tasks on a pool of threads (fibers). a task gets a thread from the pool
+//when it starts and gives it back when it returns, the next task reuses it with the stack it
+//has grown so far; so the threads are as many as the tasks that run at the same time, not as
+//the spawned ones. the closures and parameters of the tasks that have not started yet are
+//queued in the _pending member, the threads are kept alive by the _fibers member.
+//a task leaves the CPU by suspending its thread in pause(), sleep(), channel.send() or
+//channel.recv(); the native that suspends it first parks the task in the run queue, in the
+//timers heap or in a queue of the channel, run() resumes it once it is back in the run queue.
+
+#define SQSTD_FIBER_STACK 64 //initial stack of a new thread, the VM grows it when a call needs more
+
+static HSQMEMBERHANDLE sched__fibers_handle;
+static HSQMEMBERHANDLE sched__pending_handle;
+static HSQMEMBERHANDLE chan__sched_handle;
+static HSQMEMBERHANDLE chan__buf_handle;
+
+struct SQChannel
+{
+    SQScheduler *_sched; //kept alive by the _sched member
+    SQInteger _capacity;
+    SQInteger _head; //the buffered values are _buf[_head] ... _buf[_head + _count - 1]
+    SQInteger _count;
+    SQTaskQueue _receivers;
+    SQTaskQueue _senders;
+    bool _closed;
+};
+
+static double _sched_clock()
+{
+#ifdef _WIN32
+    LARGE_INTEGER f,c;
+    QueryPerformanceFrequency(&f);
+    QueryPerformanceCounter(&c);
+    return (double)c.QuadPart / (double)f.QuadPart;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+static void _sched_idle(double secs)
+{
+#ifdef _WIN32
+    Sleep((DWORD)(secs * 1000.0 + 0.5));
+#else
+    struct timespec ts;
+    ts.tv_sec = (time_t)secs;
+    ts.tv_nsec = (long)((secs - (double)ts.tv_sec) * 1e9);
+    nanosleep(&ts,NULL);
+#endif
+}
+
+//grows a vector of pointers
+#define _PTRVEC_RESERVE(T,vec,n,alloc) \
+    if(n == alloc) { \
+        SQInteger newalloc = alloc ? alloc * 2 : 16; \
+        vec = (T *)sq_realloc(vec,alloc * sizeof(T),newalloc * sizeof(T)); \
+        alloc = newalloc; \
+    }
+
+//a FIFO over the array at 'idx' (absolute), its values are a[head] ... a[head + count - 1].
+//pushes the first value and clears its slot
+static SQRESULT _fifo_take(HSQUIRRELVM v,SQInteger idx,SQInteger *head,SQInteger *count)
+{
+    sq_pushinteger(v,*head);
+    if(SQ_FAILED(sq_rawget(v,idx)))
+        return SQ_ERROR;
+    sq_pushinteger(v,*head);
+    sq_pushnull(v);
+    sq_rawset(v,idx);
+    (*head)++;
+    (*count)--;
+    if(!*count) {
+        sq_arrayresize(v,idx,0);
+        *head = 0;
+    }
+    else if(*head >= 32 && *head >= *count) {
+        //more cleared slots than values, moves the values to the front
+        for(SQInteger i = 0; i < *count; i++) {
+            sq_pushinteger(v,i);
+            sq_pushinteger(v,*head + i);
+            sq_rawget(v,idx);
+            sq_rawset(v,idx);
+        }
+        sq_arrayresize(v,idx,*count);
+        *head = 0;
+    }
+    return SQ_OK;
+}
+
+static void _sched_addtimer(SQScheduler *s,SQTask *t)
+{
+    _PTRVEC_RESERVE(SQTask *,s->_timers,s->_ntimers,s->_alloctimers)
+    t->_state = TASK_SLEEPING;
+    SQInteger i = s->_ntimers++;
+    while(i > 0) {
+        SQInteger p = (i - 1) >> 1;
+        if(s->_timers[p]->_wake <= t->_wake) break;
+        s->_timers[i] = s->_timers[p];
+        i = p;
+    }
+    s->_timers[i] = t;
+}
+
+static SQTask *_sched_poptimer(SQScheduler *s)
+{
+    SQTask *top = s->_timers[0];
+    SQTask *last = s->_timers[--s->_ntimers];
+    SQInteger n = s->_ntimers, i = 0;
+    if(!n) return top;
+    for(;;) {
+        SQInteger c = (i << 1) + 1;
+        if(c >= n) break;
+        if(c + 1 < n && s->_timers[c + 1]->_wake < s->_timers[c]->_wake) c++;
+        if(last->_wake <= s->_timers[c]->_wake) break;
+        s->_timers[i] = s->_timers[c];
+        i = c;
+    }
+    s->_timers[i] = last;
+    return top;
+}
+
+//the task running in v
+static SQTask *_sched_task(HSQUIRRELVM v,SQScheduler *s)
+{
+    SQTask *t = _sched_current(v,s);
+    if(!t)
+        sq_throwerror(v,_SC("only a task of the scheduler can wait"));
+    return t;
+}
+
+static SQTask *_sched_newtask(SQScheduler *s)
+{
+    SQTask *t = s->_free;
+    if(t) {
+        s->_free = t->_next;
+    }
+    else {
+        _PTRVEC_RESERVE(SQTask *,s->_tasks,s->_ntasks,s->_alloctasks)
+        t = (SQTask *)sq_malloc(sizeof(SQTask));
+        s->_tasks[s->_ntasks++] = t;
+    }
+    t->_thread = NULL;
+    t->_next = NULL;
+    t->_wake = 0;
+    t->_state = TASK_IDLE;
+    t->_nparams = 0;
+    t->_wakeret = false;
+    t->_wakethrow = false;
+    return t;
+}
+
+//the task has returned, its thread goes back to the pool with the root table and
+//the error handler of v, so the next task doesn't see what this one has set
+static void _sched_freetask(HSQUIRRELVM v,SQScheduler *s,SQTask *t)
+{
+    if(t->_thread) {
+        _PTRVEC_RESERVE(HSQUIRRELVM,s->_idle,s->_nidle,s->_allocidle)
+        sq_settop(t->_thread,0);
+        sq_pushroottable(v);
+        sq_move(t->_thread,v,-1);
+        sq_poptop(v);
+        sq_setroottable(t->_thread);
+        sq_geterrorhandler(v);
+        sq_move(t->_thread,v,-1);
+        sq_poptop(v);
+        sq_seterrorhandler(t->_thread);
+        s->_idle[s->_nidle++] = t->_thread;
+        t->_thread = NULL;
+    }
+    t->_state = TASK_IDLE;
+    t->_next = s->_free;
+    s->_free = t;
+    s->_live--;
+}
+
+//gives the task a thread and moves its closure and parameters to it, the scheduler instance is at 1
+static SQRESULT _sched_start(HSQUIRRELVM v,SQScheduler *s,SQTask *t)
+{
+    SQInteger top = sq_gettop(v);
+    HSQUIRRELVM thread = NULL;
+    if(SQ_FAILED(sq_getbyhandle(v,1,&sched__pending_handle)))
+        return sq_throwerror(v,_SC("the queue of the scheduler is invalid"));
+    if(s->_nidle) {
+        thread = s->_idle[--s->_nidle];
+    }
+    else if(SQ_SUCCEEDED(sq_getbyhandle(v,1,&sched__fibers_handle))) {
+        if((thread = sq_newthread(v,SQSTD_FIBER_STACK)) && SQ_SUCCEEDED(sq_arrayappend(v,-2)))
+            s->_nfibers++;
+        else
+            thread = NULL;
+        sq_settop(v,top + 1);
+    }
+    if(thread && SQ_FAILED(sq_reservestack(thread,t->_nparams + 1))) {
+        _PTRVEC_RESERVE(HSQUIRRELVM,s->_idle,s->_nidle,s->_allocidle)
+        s->_idle[s->_nidle++] = thread;
+        thread = NULL;
+    }
+    //the closure, 'this' and the parameters
+    for(SQInteger i = 0; i < t->_nparams; i++) {
+        if(SQ_FAILED(_fifo_take(v,top + 1,&s->_pendhead,&s->_pendcount))) {
+            sq_settop(v,top);
+            return sq_throwerror(v,_SC("the queue of the scheduler is invalid"));
+        }
+        if(thread) {
+            sq_move(thread,v,-1);
+            if(i == 0) sq_pushroottable(thread);
+        }
+        sq_poptop(v);
+    }
+    sq_settop(v,top);
+    if(!thread) {
+        _sched_freetask(v,s,t);
+        return sq_throwerror(v,_SC("cannot create the thread of the task"));
+    }
+    t->_thread = thread;
+    return SQ_OK;
+}
+
+//runs the task until it waits or returns
+static SQRESULT _sched_resume(HSQUIRRELVM v,SQScheduler *s,SQTask *t)
+{
+    SQRESULT res;
+    if(!t->_thread && SQ_FAILED(_sched_start(v,s,t)))
+        return SQ_ERROR;
+    HSQUIRRELVM thread = t->_thread;
+    s->_current = t;
+    t->_state = TASK_RUNNING;
+    if(t->_nparams) {
+        SQInteger nparams = t->_nparams;
+        t->_nparams = 0;
+        res = sq_call(thread,nparams,SQFalse,SQTrue);
+    }
+    else if(t->_wakethrow) {
+        t->_wakethrow = false;
+        sq_throwobject(thread);
+        res = sq_wakeupvm(thread,SQFalse,SQFalse,SQTrue,SQTrue);
+    }
+    else {
+        SQBool wakeupret = t->_wakeret ? SQTrue : SQFalse;
+        t->_wakeret = false;
+        res = sq_wakeupvm(thread,wakeupret,SQFalse,SQTrue,SQFalse);
+    }
+    s->_current = NULL;
+    if(SQ_SUCCEEDED(res) && sq_getvmstate(thread) == SQ_VMSTATE_SUSPENDED) {
+        //suspend() was called instead of a method of the scheduler
+        if(t->_state == TASK_RUNNING)
+            _sched_ready(s,t);
+        return SQ_OK;
+    }
+    if(SQ_FAILED(res)) {
+        sq_getlasterror(thread);
+        sq_move(v,thread,-1);
+        sq_reseterror(thread);
+    }
+    _sched_freetask(v,s,t);
+    return SQ_FAILED(res) ? sq_throwobject(v) : SQ_OK;
+}
+
+#define SETUP_SCHED(v) \
+    SQScheduler *self = NULL; \
+    if(SQ_FAILED(sq_getinstanceup(v,1,(SQUserPointer*)&self,(SQUserPointer)SQSTD_SCHEDULER_TYPE_TAG))) \
+        return sq_throwerror(v,_SC("invalid type tag")); \
+    if(!self) \
+        return sq_throwerror(v,_SC("the scheduler is invalid"));
+
+static SQInteger _scheduler_releasehook(SQUserPointer p, SQInteger SQ_UNUSED_ARG(size))
+{
+    SQScheduler *self = (SQScheduler *)p;
+    for(SQInteger i = 0; i < self->_ntasks; i++)
+        sq_free(self->_tasks[i],sizeof(SQTask));
+    if(self->_tasks) sq_free(self->_tasks,self->_alloctasks * sizeof(SQTask *));
+    if(self->_idle) sq_free(self->_idle,self->_allocidle * sizeof(HSQUIRRELVM));
+    if(self->_timers) sq_free(self->_timers,self->_alloctimers * sizeof(SQTask *));
+    if(self->_poller) self->_poller->Release();
+    sq_free(self,sizeof(SQScheduler));
+    return 1;
+}
+
+static SQInteger _scheduler_constructor(HSQUIRRELVM v)
+{
+    SQScheduler *s = (SQScheduler *)sq_malloc(sizeof(SQScheduler));
+    memset(s,0,sizeof(SQScheduler));
+    s->_epoch = _sched_clock();
+    if(SQ_FAILED(sq_setinstanceup(v,1,s))) {
+        _scheduler_releasehook(s,0);
+        return sq_throwerror(v,_SC("cannot create scheduler"));
+    }
+    sq_setreleasehook(v,1,_scheduler_releasehook);
+    sq_newarray(v,0);
+    sq_setbyhandle(v,1,&sched__fibers_handle);
+    sq_newarray(v,0);
+    sq_setbyhandle(v,1,&sched__pending_handle);
+    return 0;
+}
+
+//spawn(func, ...)
+static SQInteger _scheduler_spawn(HSQUIRRELVM v)
+{
+    SETUP_SCHED(v)
+    SQInteger top = sq_gettop(v);
+    if(SQ_FAILED(sq_getbyhandle(v,1,&sched__pending_handle)))
+        return sq_throwerror(v,_SC("the queue of the scheduler is invalid"));
+    for(SQInteger i = 2; i <= top; i++) {
+        sq_push(v,i);
+        if(SQ_FAILED(sq_arrayappend(v,top + 1)))
+            return sq_throwerror(v,_SC("the queue of the scheduler is invalid"));
+    }
+    sq_poptop(v);
+    SQTask *t = _sched_newtask(self);
+    t->_nparams = top - 1;
+    self->_pendcount += t->_nparams;
+    _sched_ready(self,t);
+    self->_live++;
+    self->_spawned++;
+    return 0;
+}
+
+static SQInteger _scheduler_run(HSQUIRRELVM v)
+{
+    SETUP_SCHED(v)
+    if(self->_running)
+        return sq_throwerror(v,_SC("the scheduler is already running"));
+    self->_running = true;
+    SQInteger resumed = 0;
+    for(;;) {
+        bool io = self->_poller && self->_poller->_waiting;
+        double wait = -1;
+        if(self->_ntimers) {
+            double now = _sched_clock();
+            while(self->_ntimers && self->_timers[0]->_wake <= now)
+                _sched_ready(self,_sched_poptimer(self));
+            if(self->_ntimers) wait = self->_timers[0]->_wake - now;
+        }
+        if(!self->_ready._head) {
+            if(io) self->_poller->Poll(v,wait);
+            else if(self->_ntimers) _sched_idle(wait);
+            else break;
+            continue;
+        }
+        //the tasks waiting on I/O are not starved by the running ones
+        if(io && !(++resumed & 63))
+            self->_poller->Poll(v,0);
+        SQTask *t = _tq_pop(&self->_ready);
+        if(SQ_FAILED(_sched_resume(v,self,t))) {
+            self->_running = false;
+            return SQ_ERROR;
+        }
+    }
+    self->_running = false;
+    //the tasks left are waiting on a channel
+    sq_pushinteger(v,self->_live);
+    return 1;
+}
+
+static SQInteger _scheduler_pause(HSQUIRRELVM v)
+{
+    SETUP_SCHED(v)
+    SQTask *t = _sched_task(v,self);
+    if(!t) return SQ_ERROR;
+    SQInteger res = sq_suspendvm(v);
+    if(res != SQ_ERROR)
+        _sched_ready(self,t);
+    return res;
+}
+
+//sleep(seconds)
+static SQInteger _scheduler_sleep(HSQUIRRELVM v)
+{
+    SETUP_SCHED(v)
+    SQFloat secs;
+    sq_getfloat(v,2,&secs);
+    SQTask *t = _sched_task(v,self);
+    if(!t) return SQ_ERROR;
+    SQInteger res = sq_suspendvm(v);
+    if(res == SQ_ERROR) return res;
+    if(secs > 0) {
+        t->_wake = _sched_clock() + secs;
+        _sched_addtimer(self,t);
+    }
+    else {
+        _sched_ready(self,t);
+    }
+    return res;
+}
+
+//channel([capacity])
+static SQInteger _scheduler_channel(HSQUIRRELVM v)
+{
+    SQInteger top = sq_gettop(v);
+    sq_pushregistrytable(v);
+    sq_pushstring(v,_sqstd_channel_decl.reg_name,-1);
+    if(SQ_FAILED(sq_get(v,-2)))
+        return sq_throwerror(v,_SC("cannot find the channel class"));
+    sq_pushroottable(v);
+    sq_push(v,1);
+    if(top > 1) sq_push(v,2);
+    if(SQ_FAILED(sq_call(v,top + 1,SQTrue,SQFalse)))
+        return SQ_ERROR;
+    return 1;
+}
+
+//seconds since the scheduler was created
+static SQInteger _scheduler_now(HSQUIRRELVM v)
+{
+    SETUP_SCHED(v)
+    sq_pushfloat(v,(SQFloat)(_sched_clock() - self->_epoch));
+    return 1;
+}
+
+static void _set_integer_slot(HSQUIRRELVM v,const SQChar *name,SQInteger val)
+{
+    sq_pushstring(v,name,-1);
+    sq_pushinteger(v,val);
+    sq_rawset(v,-3);
+}
+
+static SQInteger _scheduler_stats(HSQUIRRELVM v)
+{
+    SETUP_SCHED(v)
+    sq_newtable(v);
+    _set_integer_slot(v,_SC("tasks"),self->_live);
+    _set_integer_slot(v,_SC("spawned"),self->_spawned);
+    _set_integer_slot(v,_SC("fibers"),self->_nfibers);
+    _set_integer_slot(v,_SC("sleeping"),self->_ntimers);
+    return 1;
+}
+
+#define _DECL_SCHEDULER_FUNC(name,nparams,typecheck) {_SC(#name),_scheduler_##name,nparams,typecheck}
+static const SQRegFunction _scheduler_methods[] = {
+    _DECL_SCHEDULER_FUNC(constructor,1,_SC("x")),
+    _DECL_SCHEDULER_FUNC(spawn,-2,_SC("xc")),
+    _DECL_SCHEDULER_FUNC(run,1,_SC("x")),
+    _DECL_SCHEDULER_FUNC(pause,1,_SC("x")),
+    _DECL_SCHEDULER_FUNC(sleep,2,_SC("xn")),
+    _DECL_SCHEDULER_FUNC(channel,-1,_SC("xn")),
+    _DECL_SCHEDULER_FUNC(now,1,_SC("x")),
+    _DECL_SCHEDULER_FUNC(stats,1,_SC("x")),
+    {NULL,(SQFUNCTION)0,0,NULL}
+};
+#undef _DECL_SCHEDULER_FUNC
+
+static const SQRegMember _scheduler_members[] = {
+    {_SC("_fibers"), &sched__fibers_handle },
+    {_SC("_pending"), &sched__pending_handle },
+    {NULL,NULL}
+};
+
+const SQRegClass _sqstd_scheduler_decl = {
+    NULL,                   // base_class
+    _SC("std_scheduler"),   // reg_name
+    _SC("scheduler"),       // name
+    _scheduler_members,     // members
+    _scheduler_methods,     // methods
+    NULL,                   // globals
+};
+
+//Channels
+//the values are buffered in the _buf member. a sender that exceeds the capacity leaves its
+//value in the buffer and waits until a receiver takes one; a receiver that finds the buffer
+//empty waits and the next sender pushes the value on the stack of its thread.
+
+#define SETUP_CHAN(v) \
+    SQChannel *self = NULL; \
+    if(SQ_FAILED(sq_getinstanceup(v,1,(SQUserPointer*)&self,(SQUserPointer)SQSTD_CHANNEL_TYPE_TAG))) \
+        return sq_throwerror(v,_SC("invalid type tag")); \
+    if(!self) \
+        return sq_throwerror(v,_SC("the channel is invalid"));
+
+//appends the value at 'idx' to the buffer
+static SQRESULT _chan_put(HSQUIRRELVM v,SQChannel *c,SQInteger idx)
+{
+    if(SQ_FAILED(sq_getbyhandle(v,1,&chan__buf_handle)))
+        return SQ_ERROR;
+    sq_push(v,idx);
+    if(SQ_FAILED(sq_arrayappend(v,-2))) {
+        sq_poptop(v);
+        return SQ_ERROR;
+    }
+    sq_poptop(v);
+    c->_count++;
+    return SQ_OK;
+}
+
+//pushes the first buffered value
+static SQRESULT _chan_take(HSQUIRRELVM v,SQChannel *c)
+{
+    if(SQ_FAILED(sq_getbyhandle(v,1,&chan__buf_handle)))
+        return SQ_ERROR;
+    SQInteger buf = sq_gettop(v);
+    if(SQ_FAILED(_fifo_take(v,buf,&c->_head,&c->_count))) {
+        sq_poptop(v);
+        return SQ_ERROR;
+    }
+    sq_remove(v,buf);
+    return SQ_OK;
+}
+
+static SQInteger _channel_releasehook(SQUserPointer p, SQInteger SQ_UNUSED_ARG(size))
+{
+    SQChannel *self = (SQChannel *)p;
+    sq_free(self,sizeof(SQChannel));
+    return 1;
+}
+
+//channel(scheduler [, capacity])
+static SQInteger _channel_constructor(HSQUIRRELVM v)
+{
+    SQScheduler *s = NULL;
+    SQInteger capacity = 0;
+    if(SQ_FAILED(sq_getinstanceup(v,2,(SQUserPointer*)&s,(SQUserPointer)SQSTD_SCHEDULER_TYPE_TAG)) || !s)
+        return sq_throwerror(v,_SC("scheduler expected"));
+    if(sq_gettop(v) > 2) sq_getinteger(v,3,&capacity);
+    if(capacity < 0)
+        return sq_throwerror(v,_SC("the capacity cannot be negative"));
+    SQChannel *c = (SQChannel *)sq_malloc(sizeof(SQChannel));
+    c->_sched = s;
+    c->_capacity = capacity;
+    c->_head = c->_count = 0;
+    c->_receivers._head = c->_receivers._tail = NULL;
+    c->_senders._head = c->_senders._tail = NULL;
+    c->_closed = false;
+    if(SQ_FAILED(sq_setinstanceup(v,1,c))) {
+        _channel_releasehook(c,0);
+        return sq_throwerror(v,_SC("cannot create channel"));
+    }
+    sq_setreleasehook(v,1,_channel_releasehook);
+    sq_push(v,2);
+    sq_setbyhandle(v,1,&chan__sched_handle);
+    sq_newarray(v,0);
+    sq_setbyhandle(v,1,&chan__buf_handle);
+    return 0;
+}
+
+//send(value)
+static SQInteger _channel_send(HSQUIRRELVM v)
+{
+    SETUP_CHAN(v)
+    if(self->_closed)
+        return sq_throwerror(v,_SC("the channel is closed"));
+    SQTask *t = _tq_pop(&self->_receivers);
+    if(t) {
+        //the buffer is empty, hands the value over
+        sq_move(t->_thread,v,2);
+        t->_wakeret = true;
+        _sched_ready(self->_sched,t);
+        return 0;
+    }
+    if(self->_count < self->_capacity)
+        return SQ_SUCCEEDED(_chan_put(v,self,2)) ? 0 : sq_throwerror(v,_SC("the buffer of the channel is invalid"));
+    if(!(t = _sched_task(v,self->_sched)))
+        return SQ_ERROR;
+    SQInteger res = sq_suspendvm(v);
+    if(res == SQ_ERROR) return res;
+    if(SQ_FAILED(_chan_put(v,self,2)))
+        return sq_throwerror(v,_SC("the buffer of the channel is invalid"));
+    t->_state = TASK_WAITING;
+    _tq_push(&self->_senders,t);
+    return res;
+}
+
+static SQInteger _channel_recv(HSQUIRRELVM v)
+{
+    SETUP_CHAN(v)
+    if(self->_count) {
+        if(SQ_FAILED(_chan_take(v,self)))
+            return sq_throwerror(v,_SC("the buffer of the channel is invalid"));
+        SQTask *t = _tq_pop(&self->_senders);
+        if(t) _sched_ready(self->_sched,t);
+        return 1;
+    }
+    if(self->_closed)
+        return 0;
+    SQTask *t = _sched_task(v,self->_sched);
+    if(!t) return SQ_ERROR;
+    SQInteger res = sq_suspendvm(v);
+    if(res == SQ_ERROR) return res;
+    t->_state = TASK_WAITING;
+    _tq_push(&self->_receivers,t);
+    return res;
+}
+
+static SQInteger _channel_close(HSQUIRRELVM v)
+{
+    SETUP_CHAN(v)
+    if(self->_closed) return 0;
+    self->_closed = true;
+    SQTask *t;
+    while((t = _tq_pop(&self->_receivers)))
+        _sched_ready(self->_sched,t);
+    while((t = _tq_pop(&self->_senders)))
+        _sched_ready(self->_sched,t);
+    return 0;
+}
+
+static SQInteger _channel_len(HSQUIRRELVM v)
+{
+    SETUP_CHAN(v)
+    sq_pushinteger(v,self->_count);
+    return 1;
+}
+
+static SQInteger _channel_isclosed(HSQUIRRELVM v)
+{
+    SETUP_CHAN(v)
+    sq_pushbool(v,self->_closed ? SQTrue : SQFalse);
+    return 1;
+}
+
+#define _DECL_CHANNEL_FUNC(name,nparams,typecheck) {_SC(#name),_channel_##name,nparams,typecheck}
+static const SQRegFunction _channel_methods[] = {
+    _DECL_CHANNEL_FUNC(constructor,-2,_SC("xxn")),
+    _DECL_CHANNEL_FUNC(send,2,_SC("x.")),
+    _DECL_CHANNEL_FUNC(recv,1,_SC("x")),
+    _DECL_CHANNEL_FUNC(close,1,_SC("x")),
+    _DECL_CHANNEL_FUNC(len,1,_SC("x")),
+    _DECL_CHANNEL_FUNC(isclosed,1,_SC("x")),
+    {NULL,(SQFUNCTION)0,0,NULL}
+};
+#undef _DECL_CHANNEL_FUNC
+
+static const SQRegMember _channel_members[] = {
+    {_SC("_sched"), &chan__sched_handle },
+    {_SC("_buf"), &chan__buf_handle },
+    {NULL,NULL}
+};
+
+const SQRegClass _sqstd_channel_decl = {
+    NULL,                   // base_class
+    _SC("std_channel"),     // reg_name
+    _SC("channel"),         // name
+    _channel_members,       // members
+    _channel_methods,       // methods
+    NULL,                   // globals
+};
+
+SQRESULT sqstd_register_fiberlib(HSQUIRRELVM v)
+{
+    if(SQ_FAILED(sqstd_registerclass(v,&_sqstd_scheduler_decl)))
+        return SQ_ERROR;
+#ifndef _WIN32
+    sqstd_registerfunctions(v,_sqstd_scheduler_iomethods);
+#endif
+    sq_poptop(v);
+    if(SQ_FAILED(sqstd_registerclass(v,&_sqstd_channel_decl)))
+        return SQ_ERROR;
+    sq_poptop(v);
+#ifndef _WIN32
+    if(SQ_FAILED(sqstd_registerclass(v,&_sqstd_asyncstream_decl)))
+        return SQ_ERROR;
+    sq_poptop(v);
+#endif
+    return SQ_OK;
+}
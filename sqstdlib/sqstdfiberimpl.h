@@ -0,0 +1,98 @@
+/*  see copyright notice in squirrel.h */
+#ifndef _SQSTD_FIBERIMPL_H_
+#define _SQSTD_FIBERIMPL_H_
+
+#define TASK_IDLE       0
+#define TASK_READY      1
+#define TASK_RUNNING    2
+#define TASK_SLEEPING   3
+#define TASK_WAITING    4
+
+struct SQTask
+{
+    HSQUIRRELVM _thread; //NULL until the task starts
+    SQTask *_next; //in the run queue, in a queue of a channel or in the free list
+    double _wake; //sleeping only
+    SQInteger _state;
+    SQInteger _nparams; //closure and parameters in _pending, 0 once the task has started
+    bool _wakeret; //the value returned to the suspended call is on top of the stack
+    bool _wakethrow; //the exception thrown by the suspended call is on top of the stack
+};
+
+struct SQTaskQueue
+{
+    SQTask *_head;
+    SQTask *_tail;
+};
+
+//the I/O of a scheduler, created with its first async stream (sqstdasyncio.cpp)
+struct SQSchedPoller
+{
+    //moves the tasks whose I/O has completed to the run queue, waits up to 'timeout' seconds
+    //(< 0 forever) for one. v is the VM running the scheduler
+    virtual void Poll(HSQUIRRELVM v,double timeout) = 0;
+    virtual void Release() = 0;
+    SQInteger _waiting; //tasks waiting on I/O
+};
+
+struct SQScheduler
+{
+    SQTask **_tasks; //every allocated task, to free them
+    SQInteger _ntasks;
+    SQInteger _alloctasks;
+    HSQUIRRELVM *_idle; //the pool of threads
+    SQInteger _nidle;
+    SQInteger _allocidle;
+    SQInteger _nfibers; //threads created
+    SQTask **_timers; //binary heap on _wake
+    SQInteger _ntimers;
+    SQInteger _alloctimers;
+    SQTaskQueue _ready;
+    SQTask *_free;
+    SQTask *_current;
+    SQSchedPoller *_poller;
+    SQInteger _pendhead; //the queued values are _pending[_pendhead] ... _pending[_pendhead + _pendcount - 1]
+    SQInteger _pendcount;
+    SQInteger _live; //spawned and not returned yet
+    SQInteger _spawned;
+    double _epoch;
+    bool _running;
+};
+
+inline void _tq_push(SQTaskQueue *q,SQTask *t)
+{
+    t->_next = NULL;
+    if(q->_tail) q->_tail->_next = t;
+    else q->_head = t;
+    q->_tail = t;
+}
+
+inline SQTask *_tq_pop(SQTaskQueue *q)
+{
+    SQTask *t = q->_head;
+    if(t) {
+        q->_head = t->_next;
+        if(!q->_head) q->_tail = NULL;
+        t->_next = NULL;
+    }
+    return t;
+}
+
+inline void _sched_ready(SQScheduler *s,SQTask *t)
+{
+    t->_state = TASK_READY;
+    _tq_push(&s->_ready,t);
+}
+
+//the task running in v, NULL if v is not a task of the scheduler
+inline SQTask *_sched_current(HSQUIRRELVM v,SQScheduler *s)
+{
+    return s->_current && s->_current->_thread == v ? s->_current : NULL;
+}
+
+#ifndef _WIN32
+//the methods of the scheduler that create async streams
+extern const SQRegFunction _sqstd_scheduler_iomethods[];
+#endif
+
+#endif /*_SQSTD_FIBERIMPL_H_*/
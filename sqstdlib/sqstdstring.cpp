@@ -1,5 +1,6 @@
 /* see copyright notice in squirrel.h */
 #include <squirrel.h>
+#include <sqstdaux.h>
 #include <sqstdstring.h>
 #include <string.h>
 #include <stdlib.h>
@@ -472,6 +473,155 @@ static const SQRegFunction rexobj_funcs[]={
 };
 #undef _DECL_REX_FUNC
 
+//the characters are appended to a growing buffer and the string is created once by tostring(),
+//building a string with '+' copies it every time
+struct SQStringBuilder
+{
+    SQChar *_buf;
+    SQInteger _len;
+    SQInteger _allocated; //in characters
+};
+
+#define SETUP_SB(v) \
+    SQStringBuilder *self = NULL; \
+    if(SQ_FAILED(sq_getinstanceup(v,1,(SQUserPointer*)&self,(SQUserPointer)SQSTD_STRINGBUILDER_TYPE_TAG))) \
+        return sq_throwerror(v,_SC("invalid type tag")); \
+    if(!self) \
+        return sq_throwerror(v,_SC("the stringbuilder is invalid"));
+
+static void _sb_reserve(SQStringBuilder *self,SQInteger n)
+{
+    if(self->_len + n <= self->_allocated) return;
+    //at least doubles, so appending is amortized O(1)
+    SQInteger newsize = self->_allocated * 2;
+    if(newsize < self->_len + n) newsize = self->_len + n;
+    if(newsize < 16) newsize = 16;
+    self->_buf = (SQChar *)sq_realloc(self->_buf,sq_rsl(self->_allocated),sq_rsl(newsize));
+    self->_allocated = newsize;
+}
+
+static void _sb_append(SQStringBuilder *self,const SQChar *s,SQInteger len)
+{
+    //a new builder has no buffer until something is appended
+    if(len == 0) return;
+    _sb_reserve(self,len);
+    memcpy(&self->_buf[self->_len],s,sq_rsl(len));
+    self->_len += len;
+}
+
+static SQInteger _stringbuilder_releasehook(SQUserPointer p, SQInteger SQ_UNUSED_ARG(size))
+{
+    SQStringBuilder *self = (SQStringBuilder *)p;
+    if(self->_buf) sq_free(self->_buf,sq_rsl(self->_allocated));
+    sq_free(self,sizeof(SQStringBuilder));
+    return 1;
+}
+
+static SQInteger _stringbuilder_constructor(HSQUIRRELVM v)
+{
+    SQInteger capacity = 0;
+    if(sq_gettop(v) > 1) sq_getinteger(v,2,&capacity);
+    if(capacity < 0) return sq_throwerror(v,_SC("cannot create stringbuilder with negative capacity"));
+    SQStringBuilder *self = (SQStringBuilder *)sq_malloc(sizeof(SQStringBuilder));
+    self->_buf = NULL;
+    self->_len = 0;
+    self->_allocated = 0;
+    _sb_reserve(self,capacity);
+    if(SQ_FAILED(sq_setinstanceup(v,1,self))) {
+        _stringbuilder_releasehook(self,0);
+        return sq_throwerror(v,_SC("cannot create stringbuilder"));
+    }
+    sq_setreleasehook(v,1,_stringbuilder_releasehook);
+    return 0;
+}
+
+static SQInteger _stringbuilder_append(HSQUIRRELVM v)
+{
+    SETUP_SB(v);
+    const SQChar *s;
+    SQInteger top = sq_gettop(v);
+    for(SQInteger i = 2; i <= top; i++) {
+        if(sq_gettype(v,i) == OT_STRING) {
+            sq_getstring(v,i,&s);
+            _sb_append(self,s,sq_getsize(v,i));
+        }
+        else {
+            //other values are appended as tostring() prints them
+            if(SQ_FAILED(sq_tostring(v,i)))
+                return SQ_ERROR;
+            sq_getstring(v,-1,&s);
+            _sb_append(self,s,sq_getsize(v,-1));
+            sq_poptop(v);
+        }
+    }
+    sq_push(v,1);
+    return 1;
+}
+
+static SQInteger _stringbuilder_appendf(HSQUIRRELVM v)
+{
+    SETUP_SB(v);
+    SQChar *dest = NULL;
+    SQInteger length = 0;
+    if(SQ_FAILED(sqstd_format(v,2,&length,&dest)))
+        return SQ_ERROR;
+    _sb_append(self,dest,length);
+    sq_push(v,1);
+    return 1;
+}
+
+static SQInteger _stringbuilder_tostring(HSQUIRRELVM v)
+{
+    SETUP_SB(v);
+    sq_pushstring(v,self->_len ? self->_buf : _SC(""),self->_len);
+    return 1;
+}
+
+static SQInteger _stringbuilder_len(HSQUIRRELVM v)
+{
+    SETUP_SB(v);
+    sq_pushinteger(v,self->_len);
+    return 1;
+}
+
+static SQInteger _stringbuilder_clear(HSQUIRRELVM v)
+{
+    SETUP_SB(v);
+    //the buffer is kept for the next string
+    self->_len = 0;
+    sq_push(v,1);
+    return 1;
+}
+
+static SQInteger _stringbuilder__typeof(HSQUIRRELVM v)
+{
+    sq_pushstring(v,_sqstd_stringbuilder_decl.name,-1);
+    return 1;
+}
+
+#define _DECL_SB_FUNC(name,nparams,pmask) {_SC(#name),_stringbuilder_##name,nparams,pmask}
+static const SQRegFunction _stringbuilder_methods[] = {
+    _DECL_SB_FUNC(constructor,-1,_SC("xi")),
+    _DECL_SB_FUNC(append,-1,_SC("x")),
+    _DECL_SB_FUNC(appendf,-2,_SC("xs")),
+    _DECL_SB_FUNC(tostring,1,_SC("x")),
+    _DECL_SB_FUNC(len,1,_SC("x")),
+    _DECL_SB_FUNC(clear,1,_SC("x")),
+    {_SC("_tostring"),_stringbuilder_tostring,1,_SC("x")},
+    _DECL_SB_FUNC(_typeof,1,_SC("x")),
+    {NULL,(SQFUNCTION)0,0,NULL}
+};
+#undef _DECL_SB_FUNC
+
+const SQRegClass _sqstd_stringbuilder_decl = {
+    NULL,                       // base_class
+    _SC("std_stringbuilder"),   // reg_name
+    _SC("stringbuilder"),       // name
+    NULL,                       // members
+    _stringbuilder_methods,     // methods
+    NULL,                       // globals
+};
+
 #define _DECL_FUNC(name,nparams,pmask) {_SC(#name),_string_##name,nparams,pmask}
 static const SQRegFunction stringlib_funcs[]={
     _DECL_FUNC(format,-2,_SC(".s")),
@@ -504,6 +654,10 @@ SQInteger sqstd_register_stringlib(HSQUIRRELVM v)
     }
     sq_newslot(v,-3,SQFalse);
 
+    if(SQ_FAILED(sqstd_registerclass(v,&_sqstd_stringbuilder_decl)))
+        return SQ_ERROR;
+    sq_poptop(v);
+
     i = 0;
     while(stringlib_funcs[i].name!=0)
     {
@@ -0,0 +1,483 @@
+/* see copyright notice in squirrel.h */
+#include <new>
+#include <stdlib.h>
+#include <string.h>
+#include <squirrel.h>
+#include <sqstdaux.h>
+#include <sqstdblob.h>
+#include <sqstdstream.h>
+#include <sqstdtypedarray.h>
+#include "sqstdblobimpl.h"
+
+//Typed arrays
+//the elements are stored packed in their C type. an array owns its buffer, a view
+//uses the buffer of the blob in its _blob member and looks it up on every call
+//(the blob can be resized)
+
+static HSQMEMBERHANDLE ta__blob_handle;
+
+struct SQTypedArray
+{
+    SQInteger _type;
+    SQInteger _len; //elements, -1 for a view that extends to the end of the blob
+    SQInteger _offset; //in bytes, views only
+    unsigned char *_data; //NULL for views
+    bool _isview;
+};
+
+//enum, class name, C type, type of the value in the VM, push function
+#define _TA_TYPES(X) \
+    X(SQSTD_TA_INT8,    int8array,    signed char,    SQInteger, sq_pushinteger) \
+    X(SQSTD_TA_UINT8,   uint8array,   unsigned char,  SQInteger, sq_pushinteger) \
+    X(SQSTD_TA_INT16,   int16array,   short,          SQInteger, sq_pushinteger) \
+    X(SQSTD_TA_UINT16,  uint16array,  unsigned short, SQInteger, sq_pushinteger) \
+    X(SQSTD_TA_INT32,   int32array,   int,            SQInteger, sq_pushinteger) \
+    X(SQSTD_TA_UINT32,  uint32array,  unsigned int,   SQInteger, sq_pushinteger) \
+    X(SQSTD_TA_INT64,   int64array,   long long,      SQInteger, sq_pushinteger) \
+    X(SQSTD_TA_FLOAT32, float32array, float,          SQFloat,   sq_pushfloat) \
+    X(SQSTD_TA_FLOAT64, float64array, double,         SQFloat,   sq_pushfloat)
+
+#define _TA_ELEMSIZE(e,name,T,S,push) sizeof(T),
+static const SQInteger _ta_elemsize[] = { _TA_TYPES(_TA_ELEMSIZE) };
+#undef _TA_ELEMSIZE
+
+static SQRESULT _ta_getnum(HSQUIRRELVM v,SQInteger idx,SQInteger *n) { return sq_getinteger(v,idx,n); }
+static SQRESULT _ta_getnum(HSQUIRRELVM v,SQInteger idx,SQFloat *f) { return sq_getfloat(v,idx,f); }
+
+template<typename T> static int _ta_cmp(const void *a,const void *b)
+{
+    T x = *(const T *)a, y = *(const T *)b;
+    return x < y ? -1 : (y < x ? 1 : 0);
+}
+
+//the buffer and the length of the typed array at 'idx'
+static bool _ta_buffer(HSQUIRRELVM v,SQInteger idx,SQTypedArray *ta,unsigned char **data,SQInteger *len)
+{
+    if(!ta->_isview) {
+        *data = ta->_data;
+        *len = ta->_len;
+        return true;
+    }
+    SQBlob *blob = NULL;
+    if(SQ_FAILED(sq_getbyhandle(v,idx,&ta__blob_handle)))
+        return false;
+    bool isblob = SQ_SUCCEEDED(sq_getinstanceup(v,-1,(SQUserPointer*)&blob,(SQUserPointer)SQSTD_BLOB_TYPE_TAG)) && blob;
+    sq_poptop(v);
+    if(!isblob || ta->_offset > blob->Len())
+        return false;
+    SQInteger avail = (blob->Len() - ta->_offset) / _ta_elemsize[ta->_type];
+    if(ta->_len >= 0) {
+        if(ta->_len > avail) return false;
+        avail = ta->_len;
+    }
+    *data = (unsigned char *)blob->GetBuf() + ta->_offset;
+    *len = avail;
+    return true;
+}
+
+#define SETUP_TA(v) \
+    SQTypedArray *self = NULL; \
+    if(SQ_FAILED(sq_getinstanceup(v,1,(SQUserPointer*)&self,(SQUserPointer)SQSTD_TYPEDARRAY_TYPE_TAG))) \
+        return sq_throwerror(v,_SC("invalid type tag")); \
+    if(!self) \
+        return sq_throwerror(v,_SC("the typed array is invalid")); \
+    unsigned char *data; \
+    SQInteger len; \
+    if(!_ta_buffer(v,1,self,&data,&len)) \
+        return sq_throwerror(v,_SC("the blob of the view is invalid or too small"));
+
+static void _ta_push(HSQUIRRELVM v,SQInteger type,const unsigned char *data,SQInteger i)
+{
+#define _TA_PUSH(e,name,T,S,push) case e: push(v,(S)((const T *)data)[i]); break;
+    switch(type) { _TA_TYPES(_TA_PUSH) }
+#undef _TA_PUSH
+}
+
+static SQRESULT _ta_store(HSQUIRRELVM v,SQInteger type,unsigned char *data,SQInteger i,SQInteger validx)
+{
+#define _TA_STORE(e,name,T,S,push) case e: { \
+        S val; \
+        if(SQ_FAILED(_ta_getnum(v,validx,&val))) \
+            return sq_throwerror(v,_SC("number expected")); \
+        ((T *)data)[i] = (T)val; \
+    } break;
+    switch(type) { _TA_TYPES(_TA_STORE) }
+#undef _TA_STORE
+    return SQ_OK;
+}
+
+//the largest number of elements of 'type' whose size in bytes is a positive SQInteger
+#define _TA_MAXLEN(type) ((SQInteger)(((SQUnsignedInteger)-1) >> 1) / _ta_elemsize[type])
+
+//returns NULL if the memory can't be allocated
+static SQTypedArray *_ta_new(SQInteger type,SQInteger len)
+{
+    SQTypedArray *ta = (SQTypedArray *)sq_malloc(sizeof(SQTypedArray));
+    if(!ta) return NULL;
+    ta->_type = type;
+    ta->_len = len;
+    ta->_offset = 0;
+    ta->_isview = false;
+    ta->_data = NULL;
+    if(len > 0) {
+        ta->_data = (unsigned char *)sq_malloc(len * _ta_elemsize[type]);
+        if(!ta->_data) {
+            sq_free(ta,sizeof(SQTypedArray));
+            return NULL;
+        }
+        memset(ta->_data,0,len * _ta_elemsize[type]);
+    }
+    return ta;
+}
+
+static SQInteger _ta_releasehook(SQUserPointer p, SQInteger SQ_UNUSED_ARG(size))
+{
+    SQTypedArray *self = (SQTypedArray *)p;
+    if(self->_data) sq_free(self->_data,self->_len * _ta_elemsize[self->_type]);
+    sq_free(self,sizeof(SQTypedArray));
+    return 1;
+}
+
+static SQInteger _ta_setup(HSQUIRRELVM v,SQTypedArray *ta)
+{
+    if(!ta)
+        return sq_throwerror(v,_SC("cannot allocate the typed array"));
+    if(SQ_FAILED(sq_setinstanceup(v,1,ta))) {
+        _ta_releasehook(ta,0);
+        return sq_throwerror(v,_SC("cannot create typed array"));
+    }
+    sq_setreleasehook(v,1,_ta_releasehook);
+    return 0;
+}
+
+//typedarray(size), typedarray(array) or typedarray(blob [, byteoffset [, length]])
+static SQInteger _ta_construct(HSQUIRRELVM v,SQInteger type)
+{
+    SQInteger esz = _ta_elemsize[type];
+    SQTypedArray *ta;
+    switch(sq_gettype(v,2)) {
+    case OT_INTEGER: case OT_FLOAT: {
+        SQInteger size;
+        sq_getinteger(v,2,&size);
+        if(size < 0) return sq_throwerror(v,_SC("cannot create typed array with negative size"));
+        if(size > _TA_MAXLEN(type)) return sq_throwerror(v,_SC("typed array size too big"));
+        return _ta_setup(v,_ta_new(type,size));
+    }
+    case OT_ARRAY: {
+        SQInteger size = sq_getsize(v,2);
+        if(size > _TA_MAXLEN(type)) return sq_throwerror(v,_SC("typed array size too big"));
+        ta = _ta_new(type,size);
+        if(!ta) return sq_throwerror(v,_SC("cannot allocate the typed array"));
+        for(SQInteger i = 0; i < size; i++) {
+            sq_pushinteger(v,i);
+            sq_rawget(v,2);
+            if(SQ_FAILED(_ta_store(v,type,ta->_data,i,-1))) {
+                _ta_releasehook(ta,0);
+                return SQ_ERROR;
+            }
+            sq_poptop(v);
+        }
+        return _ta_setup(v,ta);
+    }
+    case OT_INSTANCE: {
+        SQBlob *blob = NULL;
+        if(SQ_FAILED(sq_getinstanceup(v,2,(SQUserPointer*)&blob,(SQUserPointer)SQSTD_BLOB_TYPE_TAG)) || !blob)
+            break;
+        SQInteger offset = 0, length = -1;
+        if(sq_gettop(v) > 2) sq_getinteger(v,3,&offset);
+        if(sq_gettop(v) > 3) sq_getinteger(v,4,&length);
+        if(offset < 0 || offset % esz)
+            return sq_throwerror(v,_SC("the offset of a view must be a positive multiple of the element size"));
+        if(offset > blob->Len() || (length >= 0 && length > (blob->Len() - offset) / esz))
+            return sq_throwerror(v,_SC("the view exceeds the blob"));
+        ta = _ta_new(type,0);
+        if(!ta) return sq_throwerror(v,_SC("cannot allocate the typed array"));
+        ta->_len = length;
+        ta->_offset = offset;
+        ta->_isview = true;
+        if(SQ_FAILED(_ta_setup(v,ta)))
+            return SQ_ERROR;
+        //keeps the blob alive
+        sq_push(v,2);
+        sq_setbyhandle(v,1,&ta__blob_handle);
+        return 0;
+    }
+    default:
+        break;
+    }
+    return sq_throwerror(v,_SC("integer, array or blob expected"));
+}
+
+//creates an empty typed array of 'type' on the stack
+static SQTypedArray *_ta_create(HSQUIRRELVM v,SQInteger type,SQInteger len);
+
+static SQInteger _typedarray_len(HSQUIRRELVM v)
+{
+    SETUP_TA(v);
+    sq_pushinteger(v,len);
+    return 1;
+}
+
+static SQInteger _typedarray__get(HSQUIRRELVM v)
+{
+    SETUP_TA(v);
+    SQInteger idx;
+    if((sq_gettype(v,2) & SQOBJECT_NUMERIC) == 0) {
+        sq_pushnull(v);
+        return sq_throwobject(v);
+    }
+    sq_getinteger(v,2,&idx);
+    if(idx < 0 || idx >= len)
+        return sq_throwerror(v,_SC("index out of range"));
+    _ta_push(v,self->_type,data,idx);
+    return 1;
+}
+
+static SQInteger _typedarray__set(HSQUIRRELVM v)
+{
+    SETUP_TA(v);
+    SQInteger idx;
+    sq_getinteger(v,2,&idx);
+    if(idx < 0 || idx >= len)
+        return sq_throwerror(v,_SC("index out of range"));
+    if(SQ_FAILED(_ta_store(v,self->_type,data,idx,3)))
+        return SQ_ERROR;
+    sq_push(v,3);
+    return 1;
+}
+
+static SQInteger _typedarray__nexti(HSQUIRRELVM v)
+{
+    SETUP_TA(v);
+    if(sq_gettype(v,2) == OT_NULL) {
+        if(len > 0) sq_pushinteger(v,0);
+        else sq_pushnull(v);
+        return 1;
+    }
+    SQInteger idx;
+    if(SQ_SUCCEEDED(sq_getinteger(v,2,&idx))) {
+        if(idx+1 < len) {
+            sq_pushinteger(v,idx+1);
+            return 1;
+        }
+        sq_pushnull(v);
+        return 1;
+    }
+    return sq_throwerror(v,_SC("internal error (_nexti) wrong argument type"));
+}
+
+static SQInteger _typedarray__typeof(HSQUIRRELVM v);
+
+static SQInteger _typedarray__cloned(HSQUIRRELVM v)
+{
+    SQTypedArray *other = NULL;
+    unsigned char *data;
+    SQInteger len;
+    if(SQ_FAILED(sq_getinstanceup(v,2,(SQUserPointer*)&other,(SQUserPointer)SQSTD_TYPEDARRAY_TYPE_TAG)) || !other)
+        return SQ_ERROR;
+    if(!_ta_buffer(v,2,other,&data,&len))
+        return sq_throwerror(v,_SC("the blob of the view is invalid or too small"));
+    //the clone of a view owns a copy of the elements
+    SQTypedArray *ta = _ta_new(other->_type,len);
+    if(ta && len) memcpy(ta->_data,data,len * _ta_elemsize[other->_type]);
+    return _ta_setup(v,ta);
+}
+
+static SQInteger _typedarray_slice(HSQUIRRELVM v)
+{
+    SETUP_TA(v);
+    SQInteger sidx = 0, eidx = len;
+    sq_getinteger(v,2,&sidx);
+    if(sq_gettop(v) > 2) sq_getinteger(v,3,&eidx);
+    if(sidx < 0) sidx = len + sidx;
+    if(eidx < 0) eidx = len + eidx;
+    if(eidx < sidx) return sq_throwerror(v,_SC("wrong indexes"));
+    if(eidx > len || sidx < 0) return sq_throwerror(v,_SC("slice out of range"));
+    SQInteger type = self->_type;
+    SQTypedArray *ta = _ta_create(v,type,eidx - sidx);
+    if(!ta) return SQ_ERROR;
+    //creating the new array ran no script code, the buffer is still valid
+    if(eidx > sidx) memcpy(ta->_data,data + sidx * _ta_elemsize[type],(eidx - sidx) * _ta_elemsize[type]);
+    return 1;
+}
+
+static SQInteger _typedarray_fill(HSQUIRRELVM v)
+{
+    SETUP_TA(v);
+    SQInteger from = 0, to = len;
+    if(sq_gettop(v) > 2) sq_getinteger(v,3,&from);
+    if(sq_gettop(v) > 3) sq_getinteger(v,4,&to);
+    if(from < 0 || to > len || from > to) return sq_throwerror(v,_SC("fill out of range"));
+    if(from < to) {
+        if(SQ_FAILED(_ta_store(v,self->_type,data,from,2)))
+            return SQ_ERROR;
+#define _TA_FILL(e,name,T,S,push) case e: { \
+            T *d = (T *)data; \
+            for(SQInteger i = from + 1; i < to; i++) d[i] = d[from]; \
+        } break;
+        switch(self->_type) { _TA_TYPES(_TA_FILL) }
+#undef _TA_FILL
+    }
+    sq_push(v,1);
+    return 1;
+}
+
+static SQInteger _typedarray_sort(HSQUIRRELVM v)
+{
+    SETUP_TA(v);
+#define _TA_SORT(e,name,T,S,push) case e: qsort(data,len,sizeof(T),_ta_cmp<T>); break;
+    switch(self->_type) { _TA_TYPES(_TA_SORT) }
+#undef _TA_SORT
+    sq_push(v,1);
+    return 1;
+}
+
+static SQInteger _typedarray_sum(HSQUIRRELVM v)
+{
+    SETUP_TA(v);
+#define _TA_SUM(e,name,T,S,push) case e: { \
+        const T *d = (const T *)data; \
+        S s = 0; \
+        for(SQInteger i = 0; i < len; i++) s += (S)d[i]; \
+        push(v,s); \
+    } break;
+    switch(self->_type) { _TA_TYPES(_TA_SUM) }
+#undef _TA_SUM
+    return 1;
+}
+
+static SQInteger _ta_minmax(HSQUIRRELVM v,bool ismax)
+{
+    SETUP_TA(v);
+    if(len == 0) return 0; //null
+#define _TA_MINMAX(e,name,T,S,push) case e: { \
+        const T *d = (const T *)data; \
+        T m = d[0]; \
+        if(ismax) { for(SQInteger i = 1; i < len; i++) if(m < d[i]) m = d[i]; } \
+        else { for(SQInteger i = 1; i < len; i++) if(d[i] < m) m = d[i]; } \
+        push(v,(S)m); \
+    } break;
+    switch(self->_type) { _TA_TYPES(_TA_MINMAX) }
+#undef _TA_MINMAX
+    return 1;
+}
+
+static SQInteger _typedarray_min(HSQUIRRELVM v) { return _ta_minmax(v,false); }
+static SQInteger _typedarray_max(HSQUIRRELVM v) { return _ta_minmax(v,true); }
+
+static SQInteger _typedarray_toarray(HSQUIRRELVM v)
+{
+    SETUP_TA(v);
+    sq_newarray(v,0);
+    for(SQInteger i = 0; i < len; i++) {
+        _ta_push(v,self->_type,data,i);
+        sq_arrayappend(v,-2);
+    }
+    return 1;
+}
+
+#define _DECL_TA_FUNC(name,nparams,typecheck) {_SC(#name),_typedarray_##name,nparams,typecheck}
+static const SQRegFunction _typedarray_methods[] = {
+    _DECL_TA_FUNC(len,1,_SC("x")),
+    _DECL_TA_FUNC(slice,-2,_SC("xnn")),
+    _DECL_TA_FUNC(fill,-2,_SC("xnnn")),
+    _DECL_TA_FUNC(sort,1,_SC("x")),
+    _DECL_TA_FUNC(sum,1,_SC("x")),
+    _DECL_TA_FUNC(min,1,_SC("x")),
+    _DECL_TA_FUNC(max,1,_SC("x")),
+    _DECL_TA_FUNC(toarray,1,_SC("x")),
+    _DECL_TA_FUNC(_set,3,_SC("xn.")),
+    _DECL_TA_FUNC(_get,2,_SC("x.")),
+    _DECL_TA_FUNC(_typeof,1,_SC("x")),
+    _DECL_TA_FUNC(_nexti,2,_SC("x")),
+    _DECL_TA_FUNC(_cloned,2,_SC("xx")),
+    {NULL,(SQFUNCTION)0,0,NULL}
+};
+#undef _DECL_TA_FUNC
+
+static const SQRegMember _typedarray_members[] = {
+    {_SC("_blob"), &ta__blob_handle },
+    {NULL,NULL}
+};
+
+const SQRegClass _sqstd_typedarray_decl = {
+    NULL,                   // base_class
+    _SC("std_typedarray"),  // reg_name
+    _SC("typedarray"),      // name
+    _typedarray_members,    // members
+    _typedarray_methods,    // methods
+    NULL,                   // globals
+};
+
+//a class for every element type, they only differ in the constructor
+#define _TA_CLASS(e,name,T,S,push) \
+    static SQInteger _##name##_constructor(HSQUIRRELVM v) { return _ta_construct(v,e); } \
+    static const SQRegFunction _##name##_methods[] = { \
+        {_SC("constructor"),_##name##_constructor,-2,_SC("x.nn")}, \
+        {NULL,(SQFUNCTION)0,0,NULL} \
+    }; \
+    static const SQRegClass _sqstd_##name##_decl = { \
+        &_sqstd_typedarray_decl, _SC("std_" #name), _SC(#name), NULL, _##name##_methods, NULL \
+    };
+_TA_TYPES(_TA_CLASS)
+#undef _TA_CLASS
+
+#define _TA_DECL(e,name,T,S,push) &_sqstd_##name##_decl,
+static const SQRegClass *_ta_decls[] = { _TA_TYPES(_TA_DECL) };
+#undef _TA_DECL
+
+static SQInteger _typedarray__typeof(HSQUIRRELVM v)
+{
+    SQTypedArray *self = NULL;
+    if(SQ_FAILED(sq_getinstanceup(v,1,(SQUserPointer*)&self,(SQUserPointer)SQSTD_TYPEDARRAY_TYPE_TAG)) || !self)
+        sq_pushstring(v,_sqstd_typedarray_decl.name,-1);
+    else
+        sq_pushstring(v,_ta_decls[self->_type]->name,-1);
+    return 1;
+}
+
+static SQTypedArray *_ta_create(HSQUIRRELVM v,SQInteger type,SQInteger len)
+{
+    SQInteger top = sq_gettop(v);
+    SQTypedArray *ta = NULL;
+    sq_pushregistrytable(v);
+    sq_pushstring(v,_ta_decls[type]->reg_name,-1);
+    if(SQ_SUCCEEDED(sq_get(v,-2))) {
+        sq_remove(v,-2); //removes the registry
+        sq_pushroottable(v);
+        sq_pushinteger(v,len);
+        if(SQ_SUCCEEDED(sq_call(v,2,SQTrue,SQFalse))
+            && SQ_SUCCEEDED(sq_getinstanceup(v,-1,(SQUserPointer *)&ta,(SQUserPointer)SQSTD_TYPEDARRAY_TYPE_TAG))) {
+            sq_remove(v,-2); //removes the class
+            return ta;
+        }
+    }
+    sq_settop(v,top);
+    return NULL;
+}
+
+SQRESULT sqstd_gettypedarray(HSQUIRRELVM v,SQInteger idx,SQUserPointer *data,SQInteger *type,SQInteger *len)
+{
+    SQTypedArray *ta = NULL;
+    unsigned char *d;
+    SQInteger l;
+    if(idx < 0) idx = sq_gettop(v) + idx + 1;
+    if(SQ_FAILED(sq_getinstanceup(v,idx,(SQUserPointer*)&ta,(SQUserPointer)SQSTD_TYPEDARRAY_TYPE_TAG)) || !ta)
+        return SQ_ERROR;
+    if(!_ta_buffer(v,idx,ta,&d,&l))
+        return sq_throwerror(v,_SC("the blob of the view is invalid or too small"));
+    *data = d;
+    *type = ta->_type;
+    *len = l;
+    return SQ_OK;
+}
+
+SQRESULT sqstd_register_typedarraylib(HSQUIRRELVM v)
+{
+    for(SQInteger i = 0; i < (SQInteger)(sizeof(_ta_decls)/sizeof(_ta_decls[0])); i++) {
+        if(SQ_FAILED(sqstd_registerclass(v,_ta_decls[i])))
+            return SQ_ERROR;
+        sq_poptop(v);
+    }
+    return SQ_OK;
+}
@@ -40,10 +40,20 @@ SQInteger sq_aux_invalidtype(HSQUIRRELVM v,SQObjectType type)
 }
 
 HSQUIRRELVM sq_open(SQInteger initialstacksize)
+{
+    return sq_openex(initialstacksize,SQ_STRINGHASH_FULL,0);
+}
+
+HSQUIRRELVM sq_openex(SQInteger initialstacksize,SQInteger stringhash,SQUnsignedInteger hashseed)
 {
     SQSharedState *ss;
     SQVM *v;
+    if(stringhash != SQ_STRINGHASH_FULL && stringhash != SQ_STRINGHASH_SAMPLED)
+        return NULL;
     sq_new(ss, SQSharedState);
+    //every string is hashed with them, Init() creates the first ones
+    ss->_stringhash = stringhash;
+    ss->_hashseed = hashseed;
     ss->Init();
     v = (SQVM *)SQ_MALLOC(sizeof(SQVM));
     new (v) SQVM(ss);
@@ -94,6 +104,11 @@ void sq_seterrorhandler(HSQUIRRELVM v)
     }
 }
 
+void sq_geterrorhandler(HSQUIRRELVM v)
+{
+    v->Push(v->_errorhandler);
+}
+
 void sq_setnativedebughook(HSQUIRRELVM v,SQDEBUGHOOK hook)
 {
     v->_debughook_native = hook;
@@ -148,6 +163,17 @@ void sq_notifyallexceptions(HSQUIRRELVM v, SQBool enable)
     _ss(v)->_notifyallexceptions = enable?true:false;
 }
 
+SQRESULT sq_setjitenabled(HSQUIRRELVM v, SQBool enable)
+{
+#ifdef SQ_USE_JIT
+    _ss(v)->_jitenabled = enable?true:false;
+    return SQ_OK;
+#else
+    if(!enable) return SQ_OK;
+    return sq_throwerror(v,_SC("the JIT is not available in this build"));
+#endif
+}
+
 void sq_addref(HSQUIRRELVM v,HSQOBJECT *po)
 {
     if(!ISREFCOUNTED(sq_type(*po))) return;
@@ -183,7 +209,7 @@ SQBool sq_release(HSQUIRRELVM v,HSQOBJECT *po)
 SQUnsignedInteger sq_getvmrefcount(HSQUIRRELVM SQ_UNUSED_ARG(v), const HSQOBJECT *po)
 {
     if (!ISREFCOUNTED(sq_type(*po))) return 0;
-    return po->_unVal.pRefCounted->_uiRef;
+    return REF_COUNT(po->_unVal.pRefCounted);
 }
 
 const SQChar *sq_objtostring(const HSQOBJECT *o)
@@ -612,6 +638,16 @@ SQRELEASEHOOK sq_getsharedreleasehook(HSQUIRRELVM v)
     return _ss(v)->_releasehook;
 }
 
+void sq_setinternlimit(HSQUIRRELVM v, SQInteger limit)
+{
+    _ss(v)->_internlimit = limit;
+}
+
+SQInteger sq_getinternlimit(HSQUIRRELVM v)
+{
+    return _ss(v)->_internlimit;
+}
+
 void sq_push(HSQUIRRELVM v,SQInteger idx)
 {
     v->Push(stack_get(v, idx));
@@ -1213,6 +1249,19 @@ SQRESULT sq_tailcall(HSQUIRRELVM v, SQInteger nparams)
 	return SQ_TAILCALL_FLAG;
 }
 
+SQRESULT sq_callk(HSQUIRRELVM v, SQInteger nparams, SQFUNCTION cont)
+{
+    if(!v->ci || sq_type(v->ci->_closure) != OT_NATIVECLOSURE) {
+        return sq_throwerror(v, _SC("sq_callk can only be used by native closures"));
+    }
+    if(v->_top - v->_stackbase < nparams + 1) {
+        return sq_throwerror(v, _SC("not enough parameters in the stack"));
+    }
+    v->ci->_cont = cont;
+    v->ci->_contparams = (SQInt32)nparams;
+    return SQ_CALLK_FLAG;
+}
+
 SQRESULT sq_suspendvm(HSQUIRRELVM v)
 {
     return v->Suspend();
@@ -1319,6 +1368,32 @@ SQInteger sq_collectgarbage(HSQUIRRELVM v)
 #endif
 }
 
+SQInteger sq_gcstep(HSQUIRRELVM v,SQInteger budget)
+{
+#ifndef NO_GARBAGE_COLLECTOR
+    return _ss(v)->GCStep(budget);
+#else
+    return -1;
+#endif
+}
+
+SQRESULT sq_getgcstats(HSQUIRRELVM v,SQGCStats *stats)
+{
+#ifndef NO_GARBAGE_COLLECTOR
+    *stats = _ss(v)->_gc_stats;
+    return SQ_OK;
+#else
+    return sq_throwerror(v,_SC("the garbage collector is disabled"));
+#endif
+}
+
+void sq_resetgcstats(HSQUIRRELVM v)
+{
+#ifndef NO_GARBAGE_COLLECTOR
+    memset(&_ss(v)->_gc_stats,0,sizeof(SQGCStats));
+#endif
+}
+
 SQRESULT sq_getcallee(HSQUIRRELVM v)
 {
     if(v->_callsstacksize > 1)
@@ -1366,13 +1441,16 @@ SQRESULT sq_setfreevariable(HSQUIRRELVM v,SQInteger idx,SQUnsignedInteger nval)
     case OT_CLOSURE:{
         SQFunctionProto *fp = _closure(self)->_function;
         if(((SQUnsignedInteger)fp->_noutervalues) > nval){
-            *(_outer(_closure(self)->_outervalues[nval])->_valptr) = stack_get(v,-1);
+            SQOuter *otr = _outer(_closure(self)->_outervalues[nval]);
+            GC_BARRIER(otr);
+            *(otr->_valptr) = stack_get(v,-1);
         }
         else return sq_throwerror(v,_SC("invalid free var index"));
                     }
         break;
     case OT_NATIVECLOSURE:
         if(_nativeclosure(self)->_noutervalues > nval){
+            GC_BARRIER(_nativeclosure(self));
             _nativeclosure(self)->_outervalues[nval] = stack_get(v,-1);
         }
         else return sq_throwerror(v,_SC("invalid free var index"));
@@ -1393,6 +1471,7 @@ SQRESULT sq_setattributes(HSQUIRRELVM v,SQInteger idx)
     SQObjectPtr attrs;
     if(sq_type(key) == OT_NULL) {
         attrs = _class(*o)->_attributes;
+        GC_BARRIER(_class(*o));
         _class(*o)->_attributes = val;
         v->Pop(2);
         v->Push(attrs);
@@ -1492,6 +1571,14 @@ SQRESULT sq_setbyhandle(HSQUIRRELVM v,SQInteger idx,const HSQMEMBERHANDLE *handl
     if(SQ_FAILED(_getmemberbyhandle(v,self,handle,val))) {
         return SQ_ERROR;
     }
+    //the member is stored by the instance or by its class
+    if(sq_type(self) == OT_INSTANCE) {
+        GC_BARRIER(_instance(self));
+        GC_BARRIER(_instance(self)->_class);
+    }
+    else {
+        GC_BARRIER(_class(self));
+    }
     *val = newval;
     v->Pop();
     return SQ_OK;
@@ -1637,3 +1724,14 @@ void sq_free(void *p,SQUnsignedInteger size)
 {
     SQ_FREE(p,size);
 }
+
+SQRESULT sq_getpoolstats(HSQUIRRELVM v,SQInteger sizeclass,SQInteger *blocksize,SQInteger *livebytes,SQInteger *freebytes)
+{
+#ifdef SQ_USE_POOL
+    if(_ss(v)->_pool.GetStats(sizeclass,*blocksize,*livebytes,*freebytes))
+        return SQ_OK;
+#else
+    (void)v; (void)sizeclass; (void)blocksize; (void)livebytes; (void)freebytes;
+#endif
+    return SQ_ERROR;
+}
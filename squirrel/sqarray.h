@@ -12,12 +12,12 @@ private:
     }
 public:
     static SQArray* Create(SQSharedState *ss,SQInteger nInitialSize){
-        SQArray *newarray=(SQArray*)SQ_MALLOC(sizeof(SQArray));
+        SQArray *newarray=(SQArray*)SQ_POOL_MALLOC(ss,sizeof(SQArray));
         new (newarray) SQArray(ss,nInitialSize);
         return newarray;
     }
 #ifndef NO_GARBAGE_COLLECTOR
-    void Mark(SQCollectable **chain);
+    void MarkChildren(SQCollectable **chain);
     SQObjectType GetType() {return OT_ARRAY;}
 #endif
     void Finalize(){
@@ -35,6 +35,7 @@ public:
     bool Set(const SQInteger nidx,const SQObjectPtr &val)
     {
         if(nidx>=0 && nidx<(SQInteger)_values.size()){
+            GC_BARRIER(this);
             _values[nidx]=val;
             return true;
         }
@@ -61,15 +62,16 @@ public:
         SQObjectPtr _null;
         Resize(size,_null);
     }
-    void Resize(SQInteger size,SQObjectPtr &fill) { _values.resize(size,fill); ShrinkIfNeeded(); }
+    void Resize(SQInteger size,SQObjectPtr &fill) { GC_BARRIER(this); _values.resize(size,fill); ShrinkIfNeeded(); }
     void Reserve(SQInteger size) { _values.reserve(size); }
-    void Append(const SQObject &o){_values.push_back(o);}
+    void Append(const SQObject &o){GC_BARRIER(this); _values.push_back(o);}
     void Extend(const SQArray *a);
     SQObjectPtr &Top(){return _values.top();}
     void Pop(){_values.pop_back(); ShrinkIfNeeded(); }
     bool Insert(SQInteger idx,const SQObject &val){
         if(idx < 0 || idx > (SQInteger)_values.size())
             return false;
+        GC_BARRIER(this);
         _values.insert(idx,val);
         return true;
     }
@@ -86,7 +88,7 @@ public:
     }
     void Release()
     {
-        sq_delete(this,SQArray);
+        sq_pool_delete(this,SQArray);
     }
 
     SQObjectPtrVec _values;
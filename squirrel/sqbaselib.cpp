@@ -52,6 +52,32 @@ static SQInteger base_collectgarbage(HSQUIRRELVM v)
     sq_pushinteger(v, sq_collectgarbage(v));
     return 1;
 }
+static SQInteger base_gcstep(HSQUIRRELVM v)
+{
+    SQInteger budget;
+    sq_getinteger(v, 2, &budget);
+    sq_pushinteger(v, sq_gcstep(v, budget));
+    return 1;
+}
+static SQInteger base_gcstats(HSQUIRRELVM v)
+{
+    SQGCStats st;
+    sq_getgcstats(v, &st);
+    const SQChar *names[] = { _SC("cycles"), _SC("steps"), _SC("work"), _SC("freed"),
+        _SC("maxstep"), _SC("lastatomic"), _SC("maxatomic") };
+    SQInteger values[] = { st.cycles, st.steps, st.work, st.freed,
+        st.maxstep, st.lastatomic, st.maxatomic };
+    sq_newtable(v);
+    for(SQInteger i = 0; i < (SQInteger)(sizeof(values)/sizeof(values[0])); i++) {
+        sq_pushstring(v,names[i],-1);
+        sq_pushinteger(v,values[i]);
+        sq_newslot(v,-3,SQFalse);
+    }
+    SQBool reset = SQFalse;
+    if(sq_gettop(v) > 1) sq_getbool(v, 2, &reset);
+    if(reset) sq_resetgcstats(v);
+    return 1;
+}
 static SQInteger base_resurectureachable(HSQUIRRELVM v)
 {
     sq_resurrectunreachable(v);
@@ -59,6 +85,67 @@ static SQInteger base_resurectureachable(HSQUIRRELVM v)
 }
 #endif
 
+static SQInteger base_setinternlimit(HSQUIRRELVM v)
+{
+    SQInteger limit;
+    sq_getinteger(v, 2, &limit);
+    sq_pushinteger(v, sq_getinternlimit(v));
+    sq_setinternlimit(v, limit);
+    return 1;
+}
+
+#ifdef SQ_OPCODE_PAIRS
+extern SQUnsignedInteger g_OpcodePairs[SQ_OPCODE_COUNT][SQ_OPCODE_COUNT];
+extern SQInstructionDesc g_InstrDesc[];
+static SQInteger base_getopcodepairs(HSQUIRRELVM v)
+{
+    SQBool reset = SQFalse;
+    if(sq_gettop(v) > 1) sq_getbool(v,2,&reset);
+    sq_newarray(v,0);
+    for(SQInteger i = 0; i < SQ_OPCODE_COUNT; i++) {
+        for(SQInteger j = 0; j < SQ_OPCODE_COUNT; j++) {
+            if(!g_OpcodePairs[i][j]) continue;
+            sq_newtable(v);
+            sq_pushstring(v,_SC("first"),-1);
+            sq_pushstring(v,g_InstrDesc[i].name,-1);
+            sq_newslot(v,-3,SQFalse);
+            sq_pushstring(v,_SC("second"),-1);
+            sq_pushstring(v,g_InstrDesc[j].name,-1);
+            sq_newslot(v,-3,SQFalse);
+            sq_pushstring(v,_SC("count"),-1);
+            sq_pushinteger(v,(SQInteger)g_OpcodePairs[i][j]);
+            sq_newslot(v,-3,SQFalse);
+            sq_arrayappend(v,-2);
+            if(reset) g_OpcodePairs[i][j] = 0;
+        }
+    }
+    return 1;
+}
+#endif
+
+#ifdef SQ_USE_POOL
+static SQInteger base_getpoolstats(HSQUIRRELVM v)
+{
+    SQInteger blocksize, livebytes, freebytes;
+    sq_newarray(v,0);
+    for(SQInteger i = 0; SQ_SUCCEEDED(sq_getpoolstats(v,i,&blocksize,&livebytes,&freebytes)); i++) {
+        if(!livebytes && !freebytes) continue;
+        sq_newtable(v);
+        sq_pushstring(v,_SC("size"),-1);
+        sq_pushinteger(v,blocksize);
+        sq_newslot(v,-3,SQFalse);
+        sq_pushstring(v,_SC("live"),-1);
+        sq_pushinteger(v,livebytes);
+        sq_newslot(v,-3,SQFalse);
+        sq_pushstring(v,_SC("free"),-1);
+        sq_pushinteger(v,freebytes);
+        sq_newslot(v,-3,SQFalse);
+        sq_arrayappend(v,-2);
+    }
+    return 1;
+}
+#endif
+
 static SQInteger base_getroottable(HSQUIRRELVM v)
 {
     v->Push(v->_roottable);
@@ -302,7 +389,16 @@ static const SQRegFunction base_funcs[]={
     {_SC("dummy"),base_dummy,0,NULL},
 #ifndef NO_GARBAGE_COLLECTOR
     {_SC("collectgarbage"),base_collectgarbage,0, NULL},
+    {_SC("gcstep"),base_gcstep,2, _SC(".n")},
+    {_SC("gcstats"),base_gcstats,-1, _SC(".b")},
     {_SC("resurrectunreachable"),base_resurectureachable,0, NULL},
+#endif
+    {_SC("setinternlimit"),base_setinternlimit,2, _SC(".n")},
+#ifdef SQ_OPCODE_PAIRS
+    {_SC("getopcodepairs"),base_getopcodepairs,-1, _SC(".b")},
+#endif
+#ifdef SQ_USE_POOL
+    {_SC("getpoolstats"),base_getpoolstats,1, NULL},
 #endif
     {NULL,(SQFUNCTION)0,0,NULL}
 };
@@ -472,31 +568,48 @@ static SQInteger table_getdelegate(HSQUIRRELVM v)
     return SQ_SUCCEEDED(sq_getdelegate(v,-1))?1:SQ_ERROR;
 }
 
-static SQInteger table_filter(HSQUIRRELVM v)
-{
-    SQObject &o = stack_get(v,1);
-    SQTable *tbl = _table(o);
-    SQObjectPtr ret = SQTable::Create(_ss(v),0);
+/* the callbacks of the higher order functions are called with sq_callk, so
+script closures run in the execution loop of the caller. the state of the
+iteration lives in the native stack frame, after the parameters */
 
-    SQObjectPtr itr, key, val;
-    SQInteger nitr;
-    while((nitr = tbl->Next(false, itr, key, val)) != -1) {
-        itr = (SQInteger)nitr;
+static SQInteger table_filter_cont(HSQUIRRELVM v);
 
-        v->Push(o);
-        v->Push(key);
-        v->Push(val);
-        if(SQ_FAILED(sq_call(v,3,SQTrue,SQFalse))) {
-            return SQ_ERROR;
-        }
-        if(!SQVM::IsFalse(v->GetUp(-1))) {
-            _table(ret)->NewSlot(key, val);
-        }
-        v->Pop();
+//stack: table, func, result, iterator, key, val
+static SQInteger table_filter_next(HSQUIRRELVM v)
+{
+    SQObjectPtr &itr = stack_get(v,4);
+    SQObjectPtr key, val;
+    SQInteger nitr = _table(stack_get(v,1))->Next(false, itr, key, val);
+    if(nitr == -1) {
+        v->Push(stack_get(v,3));
+        return 1;
     }
+    itr = nitr;
+    stack_get(v,5) = key;
+    stack_get(v,6) = val;
+    v->Push(stack_get(v,2));
+    v->Push(stack_get(v,1));
+    v->Push(key);
+    v->Push(val);
+    return sq_callk(v,3,table_filter_cont);
+}
 
-    v->Push(ret);
-    return 1;
+static SQInteger table_filter_cont(HSQUIRRELVM v)
+{
+    if(!SQVM::IsFalse(v->GetUp(-1))) {
+        _table(stack_get(v,3))->NewSlot(stack_get(v,5), stack_get(v,6));
+    }
+    v->Pop();
+    return table_filter_next(v);
+}
+
+static SQInteger table_filter(HSQUIRRELVM v)
+{
+    v->Push(SQTable::Create(_ss(v),0));
+    v->PushNull();
+    v->PushNull();
+    v->PushNull();
+    return table_filter_next(v);
 }
 
 
@@ -593,40 +706,76 @@ static SQInteger array_resize(HSQUIRRELVM v)
     return sq_throwerror(v, _SC("size must be a number"));
 }
 
-static SQInteger __map_array(SQArray *dest,SQArray *src,HSQUIRRELVM v) {
-    SQObjectPtr temp;
-    SQInteger size = src->Size();
-    for(SQInteger n = 0; n < size; n++) {
-        src->Get(n,temp);
-        v->Push(src);
-        v->Push(temp);
-        if(SQ_FAILED(sq_call(v,2,SQTrue,SQFalse))) {
-            return SQ_ERROR;
-        }
-        dest->Set(n,v->GetUp(-1));
-        v->Pop();
+static SQInteger __map_array_cont(HSQUIRRELVM v);
+
+//stack: src, func, dest, index, size
+static SQInteger __map_array_next(HSQUIRRELVM v)
+{
+    SQObjectPtr *args = &stack_get(v,1);
+    SQInteger n = _integer(args[3]);
+    if(n >= _integer(args[4])) {
+        v->Push(args[2]);
+        return 1;
     }
-    return 0;
+    v->Push(args[1]);
+    v->Push(args[0]);
+    v->PushNull();
+    _array(args[0])->Get(n,v->Top()); //stays null if the array shrank
+    return sq_callk(v,2,__map_array_cont);
+}
+
+static SQInteger __map_array_cont(HSQUIRRELVM v)
+{
+    SQObjectPtr *args = &stack_get(v,1);
+    _array(args[2])->Set(_integer(args[3])++,v->Top());
+    v->Pop();
+    return __map_array_next(v);
 }
 
 static SQInteger array_map(HSQUIRRELVM v)
 {
     SQObject &o = stack_get(v,1);
     SQInteger size = _array(o)->Size();
-    SQObjectPtr ret = SQArray::Create(_ss(v),size);
-    if(SQ_FAILED(__map_array(_array(ret),_array(o),v)))
-        return SQ_ERROR;
-    v->Push(ret);
-    return 1;
+    v->Push(SQArray::Create(_ss(v),size));
+    v->Push((SQInteger)0);
+    v->Push(size);
+    return __map_array_next(v);
 }
 
 static SQInteger array_apply(HSQUIRRELVM v)
 {
-    SQObject &o = stack_get(v,1);
-    if(SQ_FAILED(__map_array(_array(o),_array(o),v)))
-        return SQ_ERROR;
-    sq_pop(v,1);
-    return 1;
+    v->Push(stack_get(v,1));
+    v->Push((SQInteger)0);
+    v->Push(_array(stack_get(v,1))->Size());
+    return __map_array_next(v);
+}
+
+static SQInteger array_reduce_cont(HSQUIRRELVM v);
+
+//stack: array, func, result, index, size
+static SQInteger array_reduce_next(HSQUIRRELVM v)
+{
+    SQObjectPtr *args = &stack_get(v,1);
+    SQInteger n = _integer(args[3]);
+    if(n >= _integer(args[4])) {
+        v->Push(args[2]);
+        return 1;
+    }
+    v->Push(args[1]);
+    v->Push(args[0]);
+    v->Push(args[2]);
+    v->PushNull();
+    _array(args[0])->Get(n,v->Top()); //stays null if the array shrank
+    return sq_callk(v,3,array_reduce_cont);
+}
+
+static SQInteger array_reduce_cont(HSQUIRRELVM v)
+{
+    SQObjectPtr *args = &stack_get(v,1);
+    args[2] = v->Top();
+    v->Pop();
+    _integer(args[3])++;
+    return array_reduce_next(v);
 }
 
 static SQInteger array_reduce(HSQUIRRELVM v)
@@ -639,46 +788,51 @@ static SQInteger array_reduce(HSQUIRRELVM v)
     }
     SQObjectPtr res;
     a->Get(0,res);
-    if(size > 1) {
-        SQObjectPtr other;
-        for(SQInteger n = 1; n < size; n++) {
-            a->Get(n,other);
-            v->Push(o);
-            v->Push(res);
-            v->Push(other);
-            if(SQ_FAILED(sq_call(v,3,SQTrue,SQFalse))) {
-                return SQ_ERROR;
-            }
-            res = v->GetUp(-1);
-            v->Pop();
-        }
-    }
     v->Push(res);
-    return 1;
+    v->Push((SQInteger)1);
+    v->Push(size);
+    return array_reduce_next(v);
 }
 
-static SQInteger array_filter(HSQUIRRELVM v)
+static SQInteger array_filter_cont(HSQUIRRELVM v);
+
+//stack: array, func, result, index, size, val
+static SQInteger array_filter_next(HSQUIRRELVM v)
 {
-    SQObject &o = stack_get(v,1);
-    SQArray *a = _array(o);
-    SQObjectPtr ret = SQArray::Create(_ss(v),0);
-    SQInteger size = a->Size();
-    SQObjectPtr val;
-    for(SQInteger n = 0; n < size; n++) {
-        a->Get(n,val);
-        v->Push(o);
-        v->Push(n);
-        v->Push(val);
-        if(SQ_FAILED(sq_call(v,3,SQTrue,SQFalse))) {
-            return SQ_ERROR;
-        }
-        if(!SQVM::IsFalse(v->GetUp(-1))) {
-            _array(ret)->Append(val);
-        }
-        v->Pop();
+    SQObjectPtr *args = &stack_get(v,1);
+    SQInteger n = _integer(args[3]);
+    if(n >= _integer(args[4])) {
+        v->Push(args[2]);
+        return 1;
     }
-    v->Push(ret);
-    return 1;
+    if(!_array(args[0])->Get(n,args[5])) {
+        args[5].Null();
+    }
+    v->Push(args[1]);
+    v->Push(args[0]);
+    v->Push(n);
+    v->Push(args[5]);
+    return sq_callk(v,3,array_filter_cont);
+}
+
+static SQInteger array_filter_cont(HSQUIRRELVM v)
+{
+    SQObjectPtr *args = &stack_get(v,1);
+    if(!SQVM::IsFalse(v->Top())) {
+        _array(args[2])->Append(args[5]);
+    }
+    v->Pop();
+    _integer(args[3])++;
+    return array_filter_next(v);
+}
+
+static SQInteger array_filter(HSQUIRRELVM v)
+{
+    v->Push(SQArray::Create(_ss(v),0));
+    v->Push((SQInteger)0);
+    v->Push(_array(stack_get(v,1))->Size());
+    v->PushNull();
+    return array_filter_next(v);
 }
 
 static SQInteger array_find(HSQUIRRELVM v)
@@ -700,103 +854,718 @@ static SQInteger array_find(HSQUIRRELVM v)
 }
 
 
-static bool _sort_compare(HSQUIRRELVM v,SQObjectPtr &a,SQObjectPtr &b,SQInteger func,SQInteger &ret)
+/* the sort algorithms work on a plain buffer of T and ask 'less' whether
+one element goes before another. less returns false when the comparison
+failed (an error was raised by the compare function or by ObjCmp) and the
+sort stops there; the caller then throws the buffer away. all loops are
+bounds checked, an inconsistent compare function only gives a wrong order. */
+
+#define SORT_INSERTION_LIMIT 24
+#define SORT_NINTHER_LIMIT 128
+#define SORT_PARTIAL_INSERTION_LIMIT 8
+#define SORT_MINRUN 32
+
+template<typename T>
+struct _SortKey {
+    T key;
+    SQInteger idx;
+};
+
+static inline bool _sort_lt(SQInteger a,SQInteger b) { return a < b; }
+static inline bool _sort_lt(SQFloat a,SQFloat b) { return a < b; }
+static inline bool _sort_lt(SQString *a,SQString *b) { return a != b && scstrcmp(a->_val,b->_val) < 0; }
+template<typename T>
+static inline bool _sort_lt(const _SortKey<T> &a,const _SortKey<T> &b) { return _sort_lt(a.key,b.key); }
+
+struct _SortNativeLess {
+    template<typename T>
+    bool operator()(const T &a,const T &b,bool &lt) { lt = _sort_lt(a,b); return true; }
+};
+
+//compares the elements of 'vals' by index with ObjCmp
+struct _SortObjLess {
+    _SortObjLess(HSQUIRRELVM v,SQObjectPtr *vals) : _v(v), _vals(vals) {}
+    bool operator()(SQInteger a,SQInteger b,bool &lt) {
+        SQInteger ret;
+        if(!_v->ObjCmp(_vals[a],_vals[b],ret)) return false;
+        lt = ret < 0;
+        return true;
+    }
+    HSQUIRRELVM _v;
+    SQObjectPtr *_vals;
+};
+
+template<typename T>
+static inline void _sort_swap(T &a,T &b) { T t = a; a = b; b = t; }
+
+template<typename T,typename L>
+static bool _sort_insertion(T *a,SQInteger lo,SQInteger hi,L &less)
+{
+    bool lt;
+    for(SQInteger i = lo + 1; i < hi; i++) {
+        if(!less(a[i],a[i - 1],lt)) return false;
+        if(!lt) continue;
+        T x = a[i];
+        SQInteger j = i;
+        do {
+            a[j] = a[j - 1];
+            j--;
+            if(j == lo) break;
+            if(!less(x,a[j - 1],lt)) return false;
+        } while(lt);
+        a[j] = x;
+    }
+    return true;
+}
+
+//like _sort_insertion but gives up after SORT_PARTIAL_INSERTION_LIMIT moves
+template<typename T,typename L>
+static bool _sort_partial_insertion(T *a,SQInteger lo,SQInteger hi,L &less,bool &done)
+{
+    bool lt;
+    SQInteger moves = 0;
+    done = false;
+    for(SQInteger i = lo + 1; i < hi; i++) {
+        if(!less(a[i],a[i - 1],lt)) return false;
+        if(!lt) continue;
+        T x = a[i];
+        SQInteger j = i;
+        do {
+            a[j] = a[j - 1];
+            j--;
+            if(j == lo) break;
+            if(!less(x,a[j - 1],lt)) return false;
+        } while(lt);
+        a[j] = x;
+        moves += i - j;
+        if(moves > SORT_PARTIAL_INSERTION_LIMIT) return true;
+    }
+    done = true;
+    return true;
+}
+
+/* inserts a[start..hi) into the sorted a[lo..start), finding each place with
+a binary search: fewer comparisons than _sort_insertion, equal elements keep
+their order */
+template<typename T,typename L>
+static bool _sort_binary_insertion(T *a,SQInteger lo,SQInteger start,SQInteger hi,L &less)
+{
+    bool lt;
+    for(SQInteger i = start; i < hi; i++) {
+        T x = a[i];
+        SQInteger l = lo, r = i;
+        while(l < r) {
+            SQInteger m = l + (r - l) / 2;
+            if(!less(x,a[m],lt)) return false;
+            if(lt) r = m;
+            else l = m + 1;
+        }
+        for(SQInteger j = i; j > l; j--) a[j] = a[j - 1];
+        a[l] = x;
+    }
+    return true;
+}
+
+template<typename T,typename L>
+static bool _sort_sift_down(T *a,SQInteger root,SQInteger n,L &less)
 {
-    if(func < 0) {
-        if(!v->ObjCmp(a,b,ret)) return false;
+    bool lt;
+    SQInteger child;
+    while((child = root * 2 + 1) < n) {
+        if(child + 1 < n) {
+            if(!less(a[child],a[child + 1],lt)) return false;
+            if(lt) child++;
+        }
+        if(!less(a[root],a[child],lt)) return false;
+        if(!lt) break;
+        _sort_swap(a[root],a[child]);
+        root = child;
     }
-    else {
-        SQInteger top = sq_gettop(v);
-        sq_push(v, func);
-        sq_pushroottable(v);
-        v->Push(a);
-        v->Push(b);
-        if(SQ_FAILED(sq_call(v, 3, SQTrue, SQFalse))) {
-            if(!sq_isstring( v->_lasterror))
-                v->Raise_Error(_SC("compare func failed"));
-            return false;
+    return true;
+}
+
+template<typename T,typename L>
+static bool _sort_heap(T *a,SQInteger n,L &less)
+{
+    for(SQInteger i = n / 2 - 1; i >= 0; i--) {
+        if(!_sort_sift_down(a,i,n,less)) return false;
+    }
+    for(SQInteger i = n - 1; i > 0; i--) {
+        _sort_swap(a[0],a[i]);
+        if(!_sort_sift_down(a,0,i,less)) return false;
+    }
+    return true;
+}
+
+//orders a[i],a[j],a[k]
+template<typename T,typename L>
+static bool _sort3(T *a,SQInteger i,SQInteger j,SQInteger k,L &less)
+{
+    bool lt;
+    if(!less(a[j],a[i],lt)) return false;
+    if(lt) _sort_swap(a[i],a[j]);
+    if(!less(a[k],a[j],lt)) return false;
+    if(lt) {
+        _sort_swap(a[j],a[k]);
+        if(!less(a[j],a[i],lt)) return false;
+        if(lt) _sort_swap(a[i],a[j]);
+    }
+    return true;
+}
+
+/* partitions [lo,hi) around the pivot in a[lo]: the elements less than the
+pivot go to its left. 'partitioned' tells that no element had to be moved. */
+template<typename T,typename L>
+static bool _sort_partition(T *a,SQInteger lo,SQInteger hi,L &less,SQInteger &pos,bool &partitioned)
+{
+    T pivot = a[lo];
+    SQInteger i = lo + 1, j = hi - 1;
+    bool lt;
+    for(; i < hi; i++) {
+        if(!less(a[i],pivot,lt)) return false;
+        if(!lt) break;
+    }
+    for(; j >= i; j--) {
+        if(!less(a[j],pivot,lt)) return false;
+        if(lt) break;
+    }
+    partitioned = i > j;
+    while(i < j) {
+        _sort_swap(a[i],a[j]);
+        for(i++; i < hi; i++) {
+            if(!less(a[i],pivot,lt)) return false;
+            if(!lt) break;
         }
-        if(SQ_FAILED(sq_getinteger(v, -1, &ret))) {
-            v->Raise_Error(_SC("numeric value expected as return value of the compare function"));
-            return false;
+        for(j--; j >= i; j--) {
+            if(!less(a[j],pivot,lt)) return false;
+            if(lt) break;
         }
-        sq_settop(v, top);
-        return true;
     }
+    pos = i - 1;
+    a[lo] = a[pos];
+    a[pos] = pivot;
     return true;
 }
 
-static bool _hsort_sift_down(HSQUIRRELVM v,SQArray *arr, SQInteger root, SQInteger bottom, SQInteger func)
+/* the other way round: the elements equal to the pivot go to its left.
+used when the pivot equals the element before the range, so all of them
+are already in their final place. */
+template<typename T,typename L>
+static bool _sort_partition_left(T *a,SQInteger lo,SQInteger hi,L &less,SQInteger &pos)
 {
-    SQInteger maxChild;
-    SQInteger done = 0;
-    SQInteger ret;
-    SQInteger root2;
-    while (((root2 = root * 2) <= bottom) && (!done))
-    {
-        if (root2 == bottom) {
-            maxChild = root2;
+    T pivot = a[lo];
+    SQInteger i = lo + 1, j = hi - 1;
+    bool lt;
+    for(; i < hi; i++) {
+        if(!less(pivot,a[i],lt)) return false;
+        if(lt) break;
+    }
+    for(; j >= i; j--) {
+        if(!less(pivot,a[j],lt)) return false;
+        if(!lt) break;
+    }
+    while(i < j) {
+        _sort_swap(a[i],a[j]);
+        for(i++; i < hi; i++) {
+            if(!less(pivot,a[i],lt)) return false;
+            if(lt) break;
+        }
+        for(j--; j >= i; j--) {
+            if(!less(pivot,a[j],lt)) return false;
+            if(!lt) break;
+        }
+    }
+    pos = i - 1;
+    a[lo] = a[pos];
+    a[pos] = pivot;
+    return true;
+}
+
+/* pattern-defeating quicksort: introsort that picks the pivot with a
+ninther, groups runs of equal elements, finishes already sorted ranges with
+an insertion sort and breaks up patterns that give bad partitions. after too
+many bad partitions the range is heap sorted. */
+template<typename T,typename L>
+static bool _sort_pdq(T *a,SQInteger lo,SQInteger hi,L &less,SQInteger badallowed,bool leftmost)
+{
+    bool lt;
+    for(;;) {
+        SQInteger n = hi - lo;
+        if(n <= SORT_INSERTION_LIMIT)
+            return _sort_insertion(a,lo,hi,less);
+        SQInteger mid = lo + n / 2;
+        if(n > SORT_NINTHER_LIMIT) {
+            if(!_sort3(a,lo,mid,hi - 1,less)
+                || !_sort3(a,lo + 1,mid - 1,hi - 2,less)
+                || !_sort3(a,lo + 2,mid + 1,hi - 3,less)
+                || !_sort3(a,mid - 1,mid,mid + 1,less)) return false;
+            _sort_swap(a[lo],a[mid]);
         }
         else {
-            if(!_sort_compare(v,arr->_values[root2],arr->_values[root2 + 1],func,ret))
-                return false;
-            if (ret > 0) {
-                maxChild = root2;
+            if(!_sort3(a,mid,lo,hi - 1,less)) return false;
+        }
+        if(!leftmost) {
+            if(!less(a[lo - 1],a[lo],lt)) return false;
+            if(!lt) {
+                SQInteger pos;
+                if(!_sort_partition_left(a,lo,hi,less,pos)) return false;
+                lo = pos + 1;
+                continue;
             }
-            else {
-                maxChild = root2 + 1;
+        }
+        SQInteger pos;
+        bool partitioned;
+        if(!_sort_partition(a,lo,hi,less,pos,partitioned)) return false;
+        SQInteger ls = pos - lo, rs = hi - pos - 1;
+        if(ls < n / 8 || rs < n / 8) {
+            if(--badallowed == 0)
+                return _sort_heap(a + lo,n,less);
+            if(ls >= SORT_INSERTION_LIMIT) {
+                _sort_swap(a[lo],a[lo + ls / 4]);
+                _sort_swap(a[pos - 1],a[pos - ls / 4]);
+            }
+            if(rs >= SORT_INSERTION_LIMIT) {
+                _sort_swap(a[pos + 1],a[pos + 1 + rs / 4]);
+                _sort_swap(a[hi - 1],a[hi - rs / 4]);
             }
         }
+        else if(partitioned) {
+            bool ldone,rdone;
+            if(!_sort_partial_insertion(a,lo,pos,less,ldone)) return false;
+            if(!_sort_partial_insertion(a,pos + 1,hi,less,rdone)) return false;
+            if(ldone && rdone) return true;
+        }
+        //recurse into the smaller side, loop on the bigger one
+        if(ls < rs) {
+            if(!_sort_pdq(a,lo,pos,less,badallowed,leftmost)) return false;
+            lo = pos + 1;
+            leftmost = false;
+        }
+        else {
+            if(!_sort_pdq(a,pos + 1,hi,less,badallowed,false)) return false;
+            hi = pos;
+        }
+    }
+}
 
-        if(!_sort_compare(v,arr->_values[root],arr->_values[maxChild],func,ret))
-            return false;
-        if (ret < 0) {
-            if (root == maxChild) {
-                v->Raise_Error(_SC("inconsistent compare function"));
-                return false; // We'd be swapping ourselve. The compare function is incorrect
-            }
+//merges [lo,mid) and [mid,hi), copying the left run in 'buf'
+template<typename T,typename L>
+static bool _sort_merge(T *a,SQInteger lo,SQInteger mid,SQInteger hi,T *buf,L &less)
+{
+    bool lt;
+    if(!less(a[mid],a[mid - 1],lt)) return false;
+    if(!lt) return true; //already in order
+    SQInteger n = mid - lo;
+    for(SQInteger i = 0; i < n; i++) buf[i] = a[lo + i];
+    SQInteger i = 0, j = mid, k = lo;
+    while(i < n && j < hi) {
+        if(!less(a[j],buf[i],lt)) return false;
+        if(lt) a[k++] = a[j++];
+        else a[k++] = buf[i++];
+    }
+    while(i < n) a[k++] = buf[i++];
+    return true;
+}
 
-            _Swap(arr->_values[root],arr->_values[maxChild]);
-            root = maxChild;
+/* stable natural merge sort: the input is split in ascending runs (strictly
+descending ones are reversed), runs shorter than SORT_MINRUN are extended
+with a binary insertion sort, then neighbouring runs are merged until one is
+left. sorted or reversed input takes a single pass. */
+template<typename T,typename L>
+static bool _sort_stable(T *a,SQInteger n,T *buf,L &less)
+{
+    sqvector<SQInteger> runs;
+    bool lt;
+    SQInteger lo = 0;
+    runs.push_back(0);
+    while(lo < n) {
+        SQInteger hi = lo + 1;
+        if(hi < n) {
+            if(!less(a[hi],a[lo],lt)) return false;
+            if(lt) {
+                for(hi++; hi < n; hi++) {
+                    if(!less(a[hi],a[hi - 1],lt)) return false;
+                    if(!lt) break;
+                }
+                for(SQInteger i = lo, j = hi - 1; i < j; i++, j--) _sort_swap(a[i],a[j]);
+            }
+            else {
+                for(hi++; hi < n; hi++) {
+                    if(!less(a[hi],a[hi - 1],lt)) return false;
+                    if(lt) break;
+                }
+            }
         }
-        else {
-            done = 1;
+        if(hi - lo < SORT_MINRUN) {
+            SQInteger end = lo + SORT_MINRUN < n ? lo + SORT_MINRUN : n;
+            if(!_sort_binary_insertion(a,lo,hi,end,less)) return false;
+            hi = end;
         }
+        runs.push_back(hi);
+        lo = hi;
+    }
+    while(runs.size() > 2) {
+        SQUnsignedInteger k = 0, r;
+        for(r = 0; r + 2 < runs.size(); r += 2) {
+            if(!_sort_merge(a,runs[r],runs[r + 1],runs[r + 2],buf,less)) return false;
+            runs[k++] = runs[r];
+        }
+        runs[k++] = runs[r];
+        if(r + 1 < runs.size()) runs[k++] = runs[r + 1];
+        runs.resize(k);
     }
     return true;
 }
 
-static bool _hsort(HSQUIRRELVM v,SQObjectPtr &arr, SQInteger SQ_UNUSED_ARG(l), SQInteger SQ_UNUSED_ARG(r),SQInteger func)
+template<typename T,typename L>
+static bool _sort_buffer(T *a,SQInteger n,L &less,bool stable)
 {
-    SQArray *a = _array(arr);
-    SQInteger i;
-    SQInteger array_size = a->Size();
-    for (i = (array_size / 2); i >= 0; i--) {
-        if(!_hsort_sift_down(v,a, i, array_size - 1,func)) return false;
+    if(stable) {
+        T *buf = (T *)SQ_MALLOC(n * sizeof(T));
+        bool ret = _sort_stable(a,n,buf,less);
+        SQ_FREE(buf,n * sizeof(T));
+        return ret;
     }
+    SQInteger badallowed = 1;
+    while((n >> badallowed) > 0) badallowed++;
+    return _sort_pdq(a,0,n,less,badallowed,true);
+}
+
+static inline void _sort_load(const SQObjectPtr &o,SQInteger &x) { x = _integer(o); }
+static inline void _sort_load(const SQObjectPtr &o,SQFloat &x) { x = _float(o); }
+static inline void _sort_load(const SQObjectPtr &o,SQString *&x) { x = _string(o); }
+//the values are only moved around: the types stay and no reference changes
+static inline void _sort_store(SQObjectPtr &o,SQInteger x) { _integer(o) = x; }
+static inline void _sort_store(SQObjectPtr &o,SQFloat x) { _float(o) = x; }
+static inline void _sort_store(SQObjectPtr &o,SQString *x) { _string(o) = x; }
+
+//returns the type shared by all the values if it can be compared natively, OT_NULL otherwise
+static SQObjectType _sort_native_type(const SQObjectPtr *vals,SQInteger n)
+{
+    SQObjectType t = sq_type(vals[0]);
+    if(t != OT_INTEGER && t != OT_FLOAT && t != OT_STRING) return OT_NULL;
+    for(SQInteger i = 1; i < n; i++) {
+        if(sq_type(vals[i]) != t) return OT_NULL;
+    }
+    return t;
+}
 
-    for (i = array_size-1; i >= 1; i--)
-    {
-        _Swap(a->_values[0],a->_values[i]);
-        if(!_hsort_sift_down(v,a, 0, i-1,func)) return false;
+template<typename T>
+static void _sort_native(SQObjectPtr *vals,SQInteger n,bool stable)
+{
+    T *buf = (T *)SQ_MALLOC(n * sizeof(T));
+    _SortNativeLess less;
+    for(SQInteger i = 0; i < n; i++) _sort_load(vals[i],buf[i]);
+    _sort_buffer(buf,n,less,stable);
+    for(SQInteger i = 0; i < n; i++) _sort_store(vals[i],buf[i]);
+    SQ_FREE(buf,n * sizeof(T));
+}
+
+template<typename T>
+static void _sort_native_keys(const SQObjectPtr *keys,SQInteger *idx,SQInteger n)
+{
+    _SortKey<T> *buf = (_SortKey<T> *)SQ_MALLOC(n * sizeof(_SortKey<T>));
+    _SortNativeLess less;
+    for(SQInteger i = 0; i < n; i++) {
+        _sort_load(keys[i],buf[i].key);
+        buf[i].idx = i;
     }
+    _sort_buffer(buf,n,less,true);
+    for(SQInteger i = 0; i < n; i++) idx[i] = buf[i].idx;
+    SQ_FREE(buf,n * sizeof(_SortKey<T>));
+}
+
+//fills 'a' with the values of 'vals' in the order of 'idx'
+static bool _sort_writeback(HSQUIRRELVM v,SQArray *a,SQArray *vals,const SQInteger *idx)
+{
+    SQInteger n = vals->Size();
+    if(a->Size() != n) {
+        v->Raise_Error(_SC("array resized while sorting"));
+        return false;
+    }
+    GC_BARRIER(a);
+    for(SQInteger i = 0; i < n; i++) a->_values[i] = vals->_values[idx[i]];
     return true;
 }
 
+/* sorts the positions of 'keys' and fills 'a' with the values of 'vals' in
+that order. 'keys' and 'vals' are arrays only this function can reach (a _cmp
+metamethod may change 'a' while it runs) and sit on the stack.
+comparing objects is slow, so the merge sort is used: it needs the fewest
+comparisons and keeps equal elements in order. */
+static bool _sort_indexed(HSQUIRRELVM v,SQArray *a,SQArray *keys,SQArray *vals)
+{
+    SQInteger n = keys->Size();
+    SQInteger *idx = (SQInteger *)SQ_MALLOC(n * sizeof(SQInteger));
+    bool ret = true;
+    switch(_sort_native_type(&keys->_values[0],n)) {
+    case OT_INTEGER: _sort_native_keys<SQInteger>(&keys->_values[0],idx,n); break;
+    case OT_FLOAT: _sort_native_keys<SQFloat>(&keys->_values[0],idx,n); break;
+    case OT_STRING: _sort_native_keys<SQString *>(&keys->_values[0],idx,n); break;
+    default: {
+        _SortObjLess less(v,&keys->_values[0]);
+        for(SQInteger i = 0; i < n; i++) idx[i] = i;
+        ret = _sort_buffer(idx,n,less,true);
+        }
+        break;
+    }
+    ret = ret && _sort_writeback(v,a,vals,idx);
+    SQ_FREE(idx,n * sizeof(SQInteger));
+    return ret;
+}
+
+/* sort() with a compare function is a bottom-up merge sort of the positions
+that stops at every comparison to call the function with sq_callk. the runs
+of SORT_MINRUN elements are sorted with a binary insertion sort, then merged
+between two buffers. the state is a userdata in the native stack frame. */
+enum SQSortKState {
+    SORTK_RUN,          //insert _i in the run [_lo,_hi)
+    SORTK_RUN_CHECK,    //is a[_i] less than a[_i - 1]?
+    SORTK_RUN_SEARCH,   //search the place of a[_i] in [_j,_k)
+    SORTK_RUN_BISECT,   //is a[_i] less than a[_mid]?
+    SORTK_PAIR,         //merge [_lo,_lo + _width) and the run after it
+    SORTK_PAIR_CHECK,   //is a[_mid] less than a[_mid - 1]?
+    SORTK_MERGE,        //merge [_i,_mid) and [_j,_hi) in _dst from _k
+    SORTK_MERGE_TAKE    //is a[_j] less than a[_i]?
+};
+
+struct SQSortK {
+    SQInteger _n;
+    SQInteger _state;
+    SQInteger _lo, _mid, _hi;
+    SQInteger _i, _j, _k;
+    SQInteger _width;
+    SQInteger *_src, *_dst;
+};
+
+static inline SQInteger _sortk_min(SQInteger a,SQInteger b) { return a < b ? a : b; }
+
+/* gives the result of the pending comparison and runs up to the next one:
+returns true and the positions to compare in x and y, false when the
+sorted positions are in _src */
+static bool _sortk_step(SQSortK *s,bool lt,SQInteger &x,SQInteger &y)
+{
+    for(;;) {
+        SQInteger *a = s->_src;
+        switch(s->_state) {
+        case SORTK_RUN:
+            if(s->_i < s->_hi) {
+                x = a[s->_i]; y = a[s->_i - 1];
+                s->_state = SORTK_RUN_CHECK;
+                return true;
+            }
+            s->_lo = s->_hi;
+            if(s->_lo < s->_n) {
+                s->_hi = _sortk_min(s->_lo + SORT_MINRUN,s->_n);
+                s->_i = s->_lo + 1;
+            }
+            else {
+                s->_lo = 0;
+                s->_width = SORT_MINRUN;
+                s->_state = SORTK_PAIR;
+            }
+            break;
+        case SORTK_RUN_CHECK:
+            if(lt) {
+                s->_j = s->_lo; s->_k = s->_i - 1;
+                s->_state = SORTK_RUN_SEARCH;
+            }
+            else {
+                s->_i++;
+                s->_state = SORTK_RUN;
+            }
+            break;
+        case SORTK_RUN_SEARCH:
+            if(s->_j < s->_k) {
+                s->_mid = s->_j + (s->_k - s->_j) / 2;
+                x = a[s->_i]; y = a[s->_mid];
+                s->_state = SORTK_RUN_BISECT;
+                return true;
+            }
+            else {
+                SQInteger t = a[s->_i];
+                for(SQInteger m = s->_i; m > s->_j; m--) a[m] = a[m - 1];
+                a[s->_j] = t;
+                s->_i++;
+                s->_state = SORTK_RUN;
+            }
+            break;
+        case SORTK_RUN_BISECT:
+            if(lt) s->_k = s->_mid;
+            else s->_j = s->_mid + 1;
+            s->_state = SORTK_RUN_SEARCH;
+            break;
+        case SORTK_PAIR:
+            if(s->_width >= s->_n) return false;
+            if(s->_lo >= s->_n) {
+                s->_src = s->_dst; s->_dst = a;
+                s->_width *= 2;
+                s->_lo = 0;
+                break;
+            }
+            s->_mid = _sortk_min(s->_lo + s->_width,s->_n);
+            s->_hi = _sortk_min(s->_lo + s->_width * 2,s->_n);
+            if(s->_mid < s->_hi) {
+                x = a[s->_mid]; y = a[s->_mid - 1];
+                s->_state = SORTK_PAIR_CHECK;
+                return true;
+            }
+            memcpy(s->_dst + s->_lo,a + s->_lo,(s->_hi - s->_lo) * sizeof(SQInteger));
+            s->_lo = s->_hi;
+            break;
+        case SORTK_PAIR_CHECK:
+            if(lt) {
+                s->_i = s->_lo; s->_j = s->_mid; s->_k = s->_lo;
+                s->_state = SORTK_MERGE;
+            }
+            else { //already in order
+                memcpy(s->_dst + s->_lo,a + s->_lo,(s->_hi - s->_lo) * sizeof(SQInteger));
+                s->_lo = s->_hi;
+                s->_state = SORTK_PAIR;
+            }
+            break;
+        case SORTK_MERGE:
+            if(s->_i < s->_mid && s->_j < s->_hi) {
+                x = a[s->_j]; y = a[s->_i];
+                s->_state = SORTK_MERGE_TAKE;
+                return true;
+            }
+            while(s->_i < s->_mid) s->_dst[s->_k++] = a[s->_i++];
+            while(s->_j < s->_hi) s->_dst[s->_k++] = a[s->_j++];
+            s->_lo = s->_hi;
+            s->_state = SORTK_PAIR;
+            break;
+        case SORTK_MERGE_TAKE:
+            s->_dst[s->_k++] = lt ? a[s->_j++] : a[s->_i++];
+            s->_state = SORTK_MERGE;
+            break;
+        }
+    }
+}
+
+static SQInteger array_sortk_cont(HSQUIRRELVM v);
+
+//stack: array, func, values, state
+static SQInteger array_sortk_next(HSQUIRRELVM v,bool lt)
+{
+    SQSortK *s;
+    sq_getuserdata(v,4,(SQUserPointer *)&s,NULL);
+    SQArray *vals = _array(stack_get(v,3));
+    SQInteger x, y;
+    if(_sortk_step(s,lt,x,y)) {
+        v->Push(stack_get(v,2));
+        v->Push(v->_roottable);
+        v->Push(vals->_values[x]);
+        v->Push(vals->_values[y]);
+        return sq_callk(v,3,array_sortk_cont);
+    }
+    if(!_sort_writeback(v,_array(stack_get(v,1)),vals,s->_src))
+        return SQ_ERROR;
+    sq_settop(v,1);
+    return 1;
+}
+
+static SQInteger array_sortk_cont(HSQUIRRELVM v)
+{
+    SQInteger ret;
+    if(SQ_FAILED(sq_getinteger(v,-1,&ret)))
+        return sq_throwerror(v,_SC("numeric value expected as return value of the compare function"));
+    v->Pop();
+    return array_sortk_next(v,ret < 0);
+}
+
+static SQInteger array_sortk(HSQUIRRELVM v)
+{
+    SQArray *a = _array(stack_get(v,1));
+    SQInteger n = a->Size();
+    sq_settop(v,2);
+    v->Push(a->Clone());
+    SQSortK *s = (SQSortK *)sq_newuserdata(v,sizeof(SQSortK) + n * 2 * sizeof(SQInteger));
+    s->_n = n;
+    s->_src = (SQInteger *)(s + 1);
+    s->_dst = s->_src + n;
+    for(SQInteger i = 0; i < n; i++) s->_src[i] = i;
+    s->_lo = 0;
+    s->_hi = _sortk_min(SORT_MINRUN,n);
+    s->_i = 1;
+    s->_state = SORTK_RUN;
+    return array_sortk_next(v,false);
+}
+
 static SQInteger array_sort(HSQUIRRELVM v)
 {
     SQInteger func = -1;
-    SQObjectPtr &o = stack_get(v,1);
-    if(_array(o)->Size() > 1) {
-        if(sq_gettop(v) == 2) func = 2;
-        if(!_hsort(v, o, 0, _array(o)->Size()-1, func))
-            return SQ_ERROR;
+    SQBool stable = SQFalse;
+    SQArray *a = _array(stack_get(v,1));
+    SQInteger n = a->Size();
+    if(sq_gettop(v) >= 2) {
+        if(sq_gettype(v,2) == OT_BOOL) sq_getbool(v,2,&stable);
+        else if(sq_gettype(v,2) != OT_NULL) func = 2;
+        if(sq_gettop(v) >= 3) sq_getbool(v,3,&stable);
+    }
+    if(n > 1) {
+        if(func >= 0)
+            return array_sortk(v);
+        switch(_sort_native_type(&a->_values[0],n)) {
+        //equal integers can't be told apart, so any order of them is stable
+        case OT_INTEGER: _sort_native<SQInteger>(&a->_values[0],n,false); break;
+        case OT_FLOAT: _sort_native<SQFloat>(&a->_values[0],n,stable?true:false); break;
+        case OT_STRING: _sort_native<SQString *>(&a->_values[0],n,stable?true:false); break;
+        default: {
+            SQObjectPtr vals = a->Clone();
+            v->Push(vals);
+            if(!_sort_indexed(v,a,_array(vals),_array(vals)))
+                return SQ_ERROR;
+            }
+            break;
+        }
+    }
+    sq_settop(v,1);
+    return 1;
+}
 
+static SQInteger array_sortby_cont(HSQUIRRELVM v);
+
+//stack: array, func, values, keys, index
+static SQInteger array_sortby_next(HSQUIRRELVM v)
+{
+    SQArray *vals = _array(stack_get(v,3));
+    SQInteger n = _integer(stack_get(v,5));
+    if(n < vals->Size()) {
+        v->Push(stack_get(v,2));
+        v->Push(stack_get(v,1));
+        v->Push(vals->_values[n]);
+        return sq_callk(v,2,array_sortby_cont);
     }
+    if(!_sort_indexed(v,_array(stack_get(v,1)),_array(stack_get(v,4)),vals))
+        return SQ_ERROR;
     sq_settop(v,1);
     return 1;
 }
 
+static SQInteger array_sortby_cont(HSQUIRRELVM v)
+{
+    SQObjectPtr &n = stack_get(v,5);
+    _array(stack_get(v,4))->Set(_integer(n),v->GetUp(-1));
+    v->Pop();
+    _integer(n)++;
+    return array_sortby_next(v);
+}
+
+static SQInteger array_sortby(HSQUIRRELVM v)
+{
+    SQArray *a = _array(stack_get(v,1));
+    SQInteger n = a->Size();
+    if(n < 2) {
+        sq_settop(v,1);
+        return 1;
+    }
+    v->Push(a->Clone());
+    v->Push(SQArray::Create(_ss(v),n));
+    v->Push((SQInteger)0);
+    return array_sortby_next(v);
+}
+
 static SQInteger array_slice(HSQUIRRELVM v)
 {
     SQInteger sidx,eidx;
@@ -830,7 +1599,8 @@ const SQRegFunction SQSharedState::_array_default_delegate_funcz[]={
     {_SC("remove"),array_remove,2, _SC("an")},
     {_SC("resize"),array_resize,-2, _SC("an")},
     {_SC("reverse"),array_reverse,1, _SC("a")},
-    {_SC("sort"),array_sort,-1, _SC("ac")},
+    {_SC("sort"),array_sort,-1, _SC("ac|o|bb")},
+    {_SC("sortby"),array_sortby,2, _SC("ac")},
     {_SC("slice"),array_slice,-1, _SC("ann")},
     {_SC("weakref"),obj_delegate_weakref,1, NULL },
     {_SC("tostring"),default_delegate_tostring,1, _SC(".")},
@@ -18,6 +18,7 @@ SQClass::SQClass(SQSharedState *ss,SQClass *base)
     _udsize = 0;
     _locked = false;
     _constructoridx = -1;
+    _serial = ss->_nextclassserial++;
     if(_base) {
         _constructoridx = _base->_constructoridx;
         _udsize = _base->_udsize;
@@ -56,6 +57,7 @@ bool SQClass::NewSlot(SQSharedState *ss,const SQObjectPtr &key,const SQObjectPtr
     bool belongs_to_static_table = sq_type(val) == OT_CLOSURE || sq_type(val) == OT_NATIVECLOSURE || bstatic;
     if(_locked && !belongs_to_static_table)
         return false; //the class already has an instance so cannot be modified
+    GC_BARRIER(this);
     if(_members->Get(key,temp) && _isfield(temp)) //overrides the default value
     {
         _defaultvalues[_member_idx(temp)].val = val;
@@ -124,6 +126,7 @@ bool SQClass::SetAttributes(const SQObjectPtr &key,const SQObjectPtr &val)
 {
     SQObjectPtr idx;
     if(_members->Get(key,idx)) {
+        GC_BARRIER(this);
         if(_isfield(idx))
             _defaultvalues[_member_idx(idx)].attrs = val;
         else
@@ -30,7 +30,7 @@ struct SQClass : public CHAINABLE_OBJ
     SQClass(SQSharedState *ss,SQClass *base);
 public:
     static SQClass* Create(SQSharedState *ss,SQClass *base) {
-        SQClass *newclass = (SQClass *)SQ_MALLOC(sizeof(SQClass));
+        SQClass *newclass = (SQClass *)SQ_POOL_MALLOC(ss,sizeof(SQClass));
         new (newclass) SQClass(ss, base);
         return newclass;
     }
@@ -62,11 +62,11 @@ public:
     void Lock() { _locked = true; if(_base) _base->Lock(); }
     void Release() {
         if (_hook) { _hook(_typetag,0);}
-        sq_delete(this, SQClass);
+        sq_pool_delete(this, SQClass);
     }
     void Finalize();
 #ifndef NO_GARBAGE_COLLECTOR
-    void Mark(SQCollectable ** );
+    void MarkChildren(SQCollectable **chain);
     SQObjectType GetType() {return OT_CLASS;}
 #endif
     SQInteger Next(const SQObjectPtr &refpos, SQObjectPtr &outkey, SQObjectPtr &outval);
@@ -82,6 +82,7 @@ public:
     bool _locked;
     SQInteger _constructoridx;
     SQInteger _udsize;
+    SQUnsignedInteger _serial;
 };
 
 #define calcinstancesize(_theclass_) \
@@ -96,7 +97,7 @@ public:
     static SQInstance* Create(SQSharedState *ss,SQClass *theclass) {
 
         SQInteger size = calcinstancesize(theclass);
-        SQInstance *newinst = (SQInstance *)SQ_MALLOC(size);
+        SQInstance *newinst = (SQInstance *)SQ_POOL_MALLOC(ss,size);
         new (newinst) SQInstance(ss, theclass,size);
         if(theclass->_udsize) {
             newinst->_userpointer = ((unsigned char *)newinst) + (size - theclass->_udsize);
@@ -106,7 +107,7 @@ public:
     SQInstance *Clone(SQSharedState *ss)
     {
         SQInteger size = calcinstancesize(_class);
-        SQInstance *newinst = (SQInstance *)SQ_MALLOC(size);
+        SQInstance *newinst = (SQInstance *)SQ_POOL_MALLOC(ss,size);
         new (newinst) SQInstance(ss, this,size);
         if(_class->_udsize) {
             newinst->_userpointer = ((unsigned char *)newinst) + (size - _class->_udsize);
@@ -127,9 +128,20 @@ public:
         }
         return false;
     }
+    //'member' is a value of _class->_members
+    void GetMember(SQInteger member,SQObjectPtr &val) {
+        if(member & MEMBER_TYPE_FIELD) {
+            SQObjectPtr &o = _values[member & 0x00FFFFFF];
+            val = _realval(o);
+        }
+        else {
+            val = _class->_methods[member & 0x00FFFFFF].val;
+        }
+    }
     bool Set(const SQObjectPtr &key,const SQObjectPtr &val) {
         SQObjectPtr idx;
         if(_class->_members->Get(key,idx) && _isfield(idx)) {
+            GC_BARRIER(this);
             _values[_member_idx(idx)] = val;
             return true;
         }
@@ -139,14 +151,13 @@ public:
         _uiRef++;
         if (_hook) { _hook(_userpointer,0);}
         _uiRef--;
-        if(_uiRef > 0) return;
+        if(REF_COUNT(this) > 0) return;
         SQInteger size = _memsize;
-        this->~SQInstance();
-        SQ_FREE(this, size);
+        sq_pool_delete_size(this, SQInstance, size);
     }
     void Finalize();
 #ifndef NO_GARBAGE_COLLECTOR
-    void Mark(SQCollectable ** );
+    void MarkChildren(SQCollectable **chain);
     SQObjectType GetType() {return OT_INSTANCE;}
 #endif
     bool InstanceOf(SQClass *trg);
@@ -3,7 +3,7 @@
 #define _SQCLOSURE_H_
 
 
-#define _CALC_CLOSURE_SIZE(func) (sizeof(SQClosure) + (func->_noutervalues*sizeof(SQObjectPtr)) + (func->_ndefaultparams*sizeof(SQObjectPtr)))
+#define _CALC_CLOSURE_SIZE(func) (sizeof(SQClosure) + (func->_noutervalues*sizeof(SQObjectPtr)) + (func->_ndefaultparams*sizeof(SQObjectPtr)) + (func->_nsharedclosures*sizeof(SQObjectPtr)))
 
 struct SQFunctionProto;
 struct SQClass;
@@ -14,14 +14,16 @@ private:
 public:
     static SQClosure *Create(SQSharedState *ss,SQFunctionProto *func,SQWeakRef *root){
         SQInteger size = _CALC_CLOSURE_SIZE(func);
-        SQClosure *nc=(SQClosure*)SQ_MALLOC(size);
+        SQClosure *nc=(SQClosure*)SQ_POOL_MALLOC(ss,size);
         new (nc) SQClosure(ss,func);
         nc->_outervalues = (SQObjectPtr *)(nc + 1);
         nc->_defaultparams = &nc->_outervalues[func->_noutervalues];
+        nc->_shared = &nc->_defaultparams[func->_ndefaultparams];
         nc->_root = root;
          __ObjAddRef(nc->_root);
         _CONSTRUCT_VECTOR(SQObjectPtr,func->_noutervalues,nc->_outervalues);
         _CONSTRUCT_VECTOR(SQObjectPtr,func->_ndefaultparams,nc->_defaultparams);
+        _CONSTRUCT_VECTOR(SQObjectPtr,func->_nsharedclosures,nc->_shared);
         return nc;
     }
     void Release(){
@@ -29,9 +31,9 @@ public:
         SQInteger size = _CALC_CLOSURE_SIZE(f);
         _DESTRUCT_VECTOR(SQObjectPtr,f->_noutervalues,_outervalues);
         _DESTRUCT_VECTOR(SQObjectPtr,f->_ndefaultparams,_defaultparams);
+        _DESTRUCT_VECTOR(SQObjectPtr,f->_nsharedclosures,_shared);
         __ObjRelease(_function);
-        this->~SQClosure();
-        sq_vm_free(this,size);
+        sq_pool_delete_size(this,SQClosure,size);
     }
     void SetRoot(SQWeakRef *r)
     {
@@ -54,11 +56,12 @@ public:
     bool Save(SQVM *v,SQUserPointer up,SQWRITEFUNC write);
     static bool Load(SQVM *v,SQUserPointer up,SQREADFUNC read,SQObjectPtr &ret);
 #ifndef NO_GARBAGE_COLLECTOR
-    void Mark(SQCollectable **chain);
+    void MarkChildren(SQCollectable **chain);
     void Finalize(){
         SQFunctionProto *f = _function;
         _NULL_SQOBJECT_VECTOR(_outervalues,f->_noutervalues);
         _NULL_SQOBJECT_VECTOR(_defaultparams,f->_ndefaultparams);
+        _NULL_SQOBJECT_VECTOR(_shared,f->_nsharedclosures);
     }
     SQObjectType GetType() {return OT_CLOSURE;}
 #endif
@@ -68,6 +71,7 @@ public:
     SQFunctionProto *_function;
     SQObjectPtr *_outervalues;
     SQObjectPtr *_defaultparams;
+    SQObjectPtr *_shared; //the last closures of the capture free nested functions, by shared slot - 1
 };
 
 //////////////////////////////////////////////
@@ -80,7 +84,7 @@ private:
 public:
     static SQOuter *Create(SQSharedState *ss, SQObjectPtr *outer)
     {
-        SQOuter *nc  = (SQOuter*)SQ_MALLOC(sizeof(SQOuter));
+        SQOuter *nc  = (SQOuter*)SQ_POOL_MALLOC(ss,sizeof(SQOuter));
         new (nc) SQOuter(ss, outer);
         return nc;
     }
@@ -88,12 +92,11 @@ public:
 
     void Release()
     {
-        this->~SQOuter();
-        sq_vm_free(this,sizeof(SQOuter));
+        sq_pool_delete(this,SQOuter);
     }
 
 #ifndef NO_GARBAGE_COLLECTOR
-    void Mark(SQCollectable **chain);
+    void MarkChildren(SQCollectable **chain);
     void Finalize() { _value.Null(); }
     SQObjectType GetType() {return OT_OUTER;}
 #endif
@@ -112,7 +115,7 @@ private:
     SQGenerator(SQSharedState *ss,SQClosure *closure){_closure=closure;_state=eRunning;_ci._generator=NULL;INIT_CHAIN();ADD_TO_CHAIN(&_ss(this)->_gc_chain,this);}
 public:
     static SQGenerator *Create(SQSharedState *ss,SQClosure *closure){
-        SQGenerator *nc=(SQGenerator*)SQ_MALLOC(sizeof(SQGenerator));
+        SQGenerator *nc=(SQGenerator*)SQ_POOL_MALLOC(ss,sizeof(SQGenerator));
         new (nc) SQGenerator(ss,closure);
         return nc;
     }
@@ -125,13 +128,13 @@ public:
         _stack.resize(0);
         _closure.Null();}
     void Release(){
-        sq_delete(this,SQGenerator);
+        sq_pool_delete(this,SQGenerator);
     }
 
     bool Yield(SQVM *v,SQInteger target);
     bool Resume(SQVM *v,SQObjectPtr &dest);
 #ifndef NO_GARBAGE_COLLECTOR
-    void Mark(SQCollectable **chain);
+    void MarkChildren(SQCollectable **chain);
     void Finalize(){_stack.resize(0);_closure.Null();}
     SQObjectType GetType() {return OT_GENERATOR;}
 #endif
@@ -152,7 +155,7 @@ public:
     static SQNativeClosure *Create(SQSharedState *ss,SQFUNCTION func,SQInteger nouters)
     {
         SQInteger size = _CALC_NATVIVECLOSURE_SIZE(nouters);
-        SQNativeClosure *nc=(SQNativeClosure*)SQ_MALLOC(size);
+        SQNativeClosure *nc=(SQNativeClosure*)SQ_POOL_MALLOC(ss,size);
         new (nc) SQNativeClosure(ss,func);
         nc->_outervalues = (SQObjectPtr *)(nc + 1);
         nc->_noutervalues = nouters;
@@ -178,12 +181,11 @@ public:
     void Release(){
         SQInteger size = _CALC_NATVIVECLOSURE_SIZE(_noutervalues);
         _DESTRUCT_VECTOR(SQObjectPtr,_noutervalues,_outervalues);
-        this->~SQNativeClosure();
-        sq_free(this,size);
+        sq_pool_delete_size(this,SQNativeClosure,size);
     }
 
 #ifndef NO_GARBAGE_COLLECTOR
-    void Mark(SQCollectable **chain);
+    void MarkChildren(SQCollectable **chain);
     void Finalize() { _NULL_SQOBJECT_VECTOR(_outervalues,_noutervalues); }
     SQObjectType GetType() {return OT_NATIVECLOSURE;}
 #endif
@@ -968,7 +968,7 @@ public:
                 Expect(_SC('('));
                 _fs->AddInstruction(_OP_LOAD, _fs->PushTarget(), _fs->GetConstant(id));
                 CreateFunction(id);
-                _fs->AddInstruction(_OP_CLOSURE, _fs->PushTarget(), _fs->_functions.size() - 1, 0);
+                EmitClosure(0);
                                 }
                                 break;
             case _SC('['):
@@ -1014,7 +1014,7 @@ public:
             varname = Expect(TK_IDENTIFIER);
             Expect(_SC('('));
             CreateFunction(varname,false);
-            _fs->AddInstruction(_OP_CLOSURE, _fs->PushTarget(), _fs->_functions.size() - 1, 0);
+            EmitClosure(0);
             _fs->PopTarget();
             _fs->PushLocalVariable(varname);
             return;
@@ -1288,7 +1288,7 @@ public:
         }
         Expect(_SC('('));
         CreateFunction(id);
-        _fs->AddInstruction(_OP_CLOSURE, _fs->PushTarget(), _fs->_functions.size() - 1, 0);
+        EmitClosure(0);
         EmitDerefOp(_OP_NEWSLOT);
         _fs->PopTarget();
     }
@@ -1414,12 +1414,22 @@ public:
             END_SCOPE();
         }
     }
+    void EmitClosure(SQInteger ftype)
+    {
+        SQFunctionProto *func = _funcproto(_fs->_functions.back());
+        //without outer values and default parameters all the closures of the function are the same,
+        //the VM can reuse the last one from a slot of the enclosing closure (arg3, 1 based)
+        SQInteger shared = 0;
+        if(func->_noutervalues == 0 && func->_ndefaultparams == 0 && _fs->_nsharedclosures < 255)
+            shared = ++_fs->_nsharedclosures;
+        _fs->AddInstruction(_OP_CLOSURE, _fs->PushTarget(), _fs->_functions.size() - 1, ftype, shared);
+    }
     void FunctionExp(SQInteger ftype,bool lambda = false)
     {
         Lex(); Expect(_SC('('));
         SQObjectPtr dummy;
         CreateFunction(dummy,lambda);
-        _fs->AddInstruction(_OP_CLOSURE, _fs->PushTarget(), _fs->_functions.size() - 1, ftype == TK_FUNCTION?0:1);
+        EmitClosure(ftype == TK_FUNCTION?0:1);
     }
     void ClassExp()
     {
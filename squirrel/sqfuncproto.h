@@ -3,6 +3,7 @@
 #define _SQFUNCTION_H_
 
 #include "sqopcodes.h"
+#include "sqjit.h"
 
 enum SQOuterType {
     otLOCAL = 0,
@@ -52,6 +53,23 @@ typedef sqvector<SQOuterVar> SQOuterVarVec;
 typedef sqvector<SQLocalVarInfo> SQLocalVarInfoVec;
 typedef sqvector<SQLineInfo> SQLineInfoVec;
 
+/* inline cache of a GET/GETK/SET/PREPCALL/PREPCALLK instruction (see SQVM::CachedGet).
+   every way holds the SQClass::_serial of an instance, a key and its member index.
+   the keys are referenced, so a key compared by address can't be freed and its memory
+   reused by a different string while the way holds it */
+#define IC_WAYS         2
+#define IC_EMPTY        0
+#define IC_FIRSTCLASS   1
+
+struct SQInlineCache
+{
+    void Fill(SQUnsignedInteger tag,SQString *key,SQInteger idx);
+    void Release();
+    SQUnsignedInteger _tag[IC_WAYS];
+    SQString *_key[IC_WAYS];
+    SQInteger _idx[IC_WAYS];
+};
+
 #define _FUNC_SIZE(ni,nl,nparams,nfuncs,nouters,nlineinf,localinf,defparams) (sizeof(SQFunctionProto) \
         +((ni-1)*sizeof(SQInstruction))+(nl*sizeof(SQObjectPtr)) \
         +(nparams*sizeof(SQObjectPtr))+(nfuncs*sizeof(SQObjectPtr)) \
@@ -106,6 +124,13 @@ public:
         _DESTRUCT_VECTOR(SQOuterVar,_noutervalues,_outervalues);
         //_DESTRUCT_VECTOR(SQLineInfo,_nlineinfos,_lineinfos); //not required are 2 integers
         _DESTRUCT_VECTOR(SQLocalVarInfo,_nlocalvarinfos,_localvarinfos);
+        if(_icache) {
+            for(SQInteger n = 0; n < _ninstructions; n++) _icache[n].Release();
+            SQ_FREE(_icache,_ninstructions*sizeof(SQInlineCache));
+        }
+#ifdef SQ_USE_JIT
+        if(_jit) _jit->Release();
+#endif
         SQInteger size = _FUNC_SIZE(_ninstructions,_nliterals,_nparameters,_nfunctions,_noutervalues,_nlineinfos,_nlocalvarinfos,_ndefaultparams);
         this->~SQFunctionProto();
         sq_vm_free(this,size);
@@ -113,10 +138,27 @@ public:
 
     const SQChar* GetLocal(SQVM *v,SQUnsignedInteger stackbase,SQUnsignedInteger nseq,SQUnsignedInteger nop);
     SQInteger GetLine(SQInstruction *curr);
+    SQInlineCache *GetInlineCache(const SQInstruction *curr)
+    {
+        if(!_icache) {
+            _icache = (SQInlineCache *)SQ_MALLOC(_ninstructions*sizeof(SQInlineCache));
+            memset(_icache,0,_ninstructions*sizeof(SQInlineCache));
+        }
+        return &_icache[curr - _instructions];
+    }
+    //the closures of the function keep one slot for each _OP_CLOSURE with a shared slot (arg3)
+    void CountSharedClosures()
+    {
+        _nsharedclosures = 0;
+        for(SQInteger i = 0; i < _ninstructions; i++) {
+            const SQInstruction &inst = _instructions[i];
+            if(inst.op == _OP_CLOSURE && inst._arg3 > _nsharedclosures) _nsharedclosures = inst._arg3;
+        }
+    }
     bool Save(SQVM *v,SQUserPointer up,SQWRITEFUNC write);
     static bool Load(SQVM *v,SQUserPointer up,SQREADFUNC read,SQObjectPtr &ret);
 #ifndef NO_GARBAGE_COLLECTOR
-    void Mark(SQCollectable **chain);
+    void MarkChildren(SQCollectable **chain);
     void Finalize(){ _NULL_SQOBJECT_VECTOR(_literals,_nliterals); }
     SQObjectType GetType() {return OT_FUNCPROTO;}
 #endif
@@ -147,6 +189,13 @@ public:
     SQInteger _ndefaultparams;
     SQInteger *_defaultparams;
 
+    SQInlineCache *_icache;
+    SQInteger _nsharedclosures;
+#ifdef SQ_USE_JIT
+    SQJitCode *_jit;
+    SQInteger _jithotness; //-1 if the function can't be translated
+#endif
+
     SQInteger _ninstructions;
     SQInstruction _instructions[1];
 };
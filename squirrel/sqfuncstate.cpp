@@ -10,7 +10,7 @@
 #include "sqopcodes.h"
 #include "sqfuncstate.h"
 
-#ifdef _DEBUG_DUMP
+#if defined(_DEBUG_DUMP) || defined(SQ_OPCODE_PAIRS)
 SQInstructionDesc g_InstrDesc[]={
     {_SC("_OP_LINE")},
     {_SC("_OP_LOAD")},
@@ -73,6 +73,21 @@ SQInstructionDesc g_InstrDesc[]={
     {_SC("_OP_NEWSLOTA")},
     {_SC("_OP_GETBASE")},
     {_SC("_OP_CLOSE")},
+    {_SC("_OP_ADDI")},
+    {_SC("_OP_SUBI")},
+    {_SC("_OP_JEQ")},
+    {_SC("_OP_JNE")},
+    {_SC("_OP_CALLK")},
+    {_SC("_OP_IADD")},
+    {_SC("_OP_ISUB")},
+    {_SC("_OP_IMUL")},
+    {_SC("_OP_FADD")},
+    {_SC("_OP_FSUB")},
+    {_SC("_OP_FMUL")},
+    {_SC("_OP_ICMP")},
+    {_SC("_OP_IJCMP")},
+    {_SC("_OP_GETFIELD")},
+    {_SC("_OP_SETFIELD")},
 };
 #endif
 void DumpLiteral(SQObjectPtr &o)
@@ -103,6 +118,7 @@ SQFuncState::SQFuncState(SQSharedState *ss,SQFuncState *parent,CompilerErrorFunc
         _errtarget = ed;
         _bgenerator = false;
         _outers = 0;
+        _nsharedclosures = 0;
         _ss = ss;
 
 }
@@ -162,7 +178,7 @@ void SQFuncState::Dump(SQFunctionProto *func)
     n=0;
     for(i=0;i<_instructions.size();i++){
         SQInstruction &inst=_instructions[i];
-        if(inst.op==_OP_LOAD || inst.op==_OP_DLOAD || inst.op==_OP_PREPCALLK || inst.op==_OP_GETK ){
+        if(inst.op==_OP_LOAD || inst.op==_OP_DLOAD || inst.op==_OP_PREPCALLK || inst.op==_OP_GETK || inst.op==_OP_CALLK ){
 
             SQInteger lidx = inst._arg1;
             scprintf(_SC("[%03d] %15s %d "), (SQInt32)n,g_InstrDesc[inst.op].name,inst._arg0);
@@ -438,7 +454,7 @@ void SQFuncState::DiscardTarget()
     if(size > 0 && _optimization){
         SQInstruction &pi = _instructions[size-1];//previous instruction
         switch(pi.op) {
-        case _OP_SET:case _OP_NEWSLOT:case _OP_SETOUTER:case _OP_CALL:
+        case _OP_SET:case _OP_NEWSLOT:case _OP_SETOUTER:case _OP_CALL:case _OP_CALLK:
             if(pi._arg0 == discardedtarget) {
                 pi._arg0 = 0xFF;
             }
@@ -459,6 +475,14 @@ void SQFuncState::AddInstruction(SQInstruction &i)
                 pi._arg1 = i._arg1;
                 return;
             }
+            if( (pi.op == _OP_EQ || pi.op == _OP_NE) && pi._arg0 == i._arg0 && (!IsLocal(pi._arg0))
+                && (pi._arg3 == 0 || pi._arg1 < 0xFF)) {
+                pi.op = pi.op == _OP_EQ ? _OP_JEQ : _OP_JNE;
+                pi._arg0 = pi._arg2;
+                pi._arg2 = (unsigned char)pi._arg1;
+                pi._arg1 = i._arg1;
+                return;
+            }
             break;
         case _OP_SET:
         case _OP_NEWSLOT:
@@ -474,6 +498,13 @@ void SQFuncState::AddInstruction(SQInstruction &i)
         case _OP_RETURN:
             if( _parent && i._arg0 != MAX_FUNC_STACKSIZE && pi.op == _OP_CALL && _returnexp < size-1) {
                 pi.op = _OP_TAILCALL;
+            } else if( _parent && i._arg0 != MAX_FUNC_STACKSIZE && pi.op == _OP_CALLK && _returnexp < size-1) {
+                //split the fused call back so it can become a tail call
+                SQInstruction call(_OP_TAILCALL, pi._arg0, pi._arg3, pi._arg3 + 1, 1);
+                pi.op = _OP_PREPCALLK;
+                pi._arg0 = pi._arg3;
+                pi._arg3 = (unsigned char)(pi._arg0 + 1);
+                _instructions.push_back(call);
             } else if(pi.op == _OP_CLOSE){
                 pi = i;
                 return;
@@ -499,6 +530,23 @@ void SQFuncState::AddInstruction(SQInstruction &i)
                 return;
             }
             break;
+        case _OP_CALL:
+            if( pi.op == _OP_PREPCALLK && pi._arg0 == i._arg1 && pi._arg3 == i._arg2
+                && i._arg2 == pi._arg0 + 1 && i._arg3 == 1) {
+                pi.op = _OP_CALLK;
+                pi._arg3 = pi._arg0;
+                pi._arg0 = i._arg0;
+                return;
+            }
+            break;
+        case _OP_ADD:case _OP_SUB:
+            if( pi.op == _OP_LOADINT && pi._arg0 == i._arg1 && pi._arg0 != i._arg2 && (!IsLocal(pi._arg0))){
+                pi.op = i.op == _OP_ADD ? _OP_ADDI : _OP_SUBI;
+                pi._arg0 = i._arg0;
+                pi._arg2 = i._arg2;
+                return;
+            }
+            break;
         case _OP_APPENDARRAY: {
             SQInteger aat = -1;
             switch(pi.op) {
@@ -521,6 +569,7 @@ void SQFuncState::AddInstruction(SQInstruction &i)
         case _OP_MOVE:
             switch(pi.op) {
             case _OP_GET: case _OP_ADD: case _OP_SUB: case _OP_MUL: case _OP_DIV: case _OP_MOD: case _OP_BITW:
+            case _OP_ADDI: case _OP_SUBI:
             case _OP_LOADINT: case _OP_LOADFLOAT: case _OP_LOADBOOL: case _OP_LOAD:
 
                 if(pi._arg0 == i._arg1)
@@ -549,6 +598,11 @@ void SQFuncState::AddInstruction(SQInstruction &i)
             }
             break;
         case _OP_EQ:case _OP_NE:
+            if(pi.op == _OP_LOADINT && pi._arg0 == i._arg1 && (!IsLocal(pi._arg0) ))
+            {
+                pi._arg1 = (SQInt32)GetNumericConstant((SQInteger)pi._arg1);
+                pi.op = _OP_LOAD;
+            }
             if(pi.op == _OP_LOAD && pi._arg0 == i._arg1 && (!IsLocal(pi._arg0) ))
             {
                 pi.op = i.op;
@@ -581,7 +635,8 @@ void SQFuncState::AddInstruction(SQInstruction &i)
 
 SQObject SQFuncState::CreateString(const SQChar *s,SQInteger len)
 {
-    SQObjectPtr ns(SQString::Create(_sharedstate,s,len));
+    //always interned, names are compared by identity
+    SQObjectPtr ns(ADD_STRING(_sharedstate,s,len));
     _table(_strings)->NewSlot(ns,(SQInteger)1);
     return ns;
 }
@@ -621,6 +676,7 @@ SQFunctionProto *SQFuncState::BuildProto()
     for(SQUnsignedInteger nd = 0; nd < _defaultparams.size(); nd++) f->_defaultparams[nd] = _defaultparams[nd];
 
     memcpy(f->_instructions,&_instructions[0],_instructions.size()*sizeof(SQInstruction));
+    f->CountSharedClosures();
 
     f->_varparams = _varparams;
 
@@ -76,6 +76,7 @@ struct SQFuncState
     SQInteger _lastline;
     SQInteger _traps; //contains number of nested exception traps
     SQInteger _outers;
+    SQInteger _nsharedclosures; //closure slots given to capture free nested functions
     bool _optimization;
     SQSharedState *_sharedstate;
     sqvector<SQFuncState*> _childstates;
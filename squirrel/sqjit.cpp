@@ -0,0 +1,318 @@
+/*
+    see copyright notice in squirrel.h
+*/
+#include "sqpcheader.h"
+#include "sqopcodes.h"
+#include "sqfuncproto.h"
+#include "sqjit.h"
+
+#ifdef SQ_USE_JIT
+
+#include <stddef.h>
+#include <sys/mman.h>
+
+/* the generated code gets the address of the function's stack base in rdi and
+   only uses rax, rcx and the flags. a stack slot is a 4 bytes type followed by
+   the 8 bytes value (16 bytes, 12 with SQ_COMPACT_OBJECTS). an instruction
+   either completes or, before touching anything, returns the index of the
+   instruction in eax so the interpreter runs it */
+
+static_assert(offsetof(SQObject,_type) == 0 && sizeof(SQObjectType) == 4, "unexpected SQObject layout");
+static_assert(offsetof(SQObject,_unVal) + 8 == sizeof(SQObjectPtr), "unexpected SQObject layout");
+
+#define SLOT_TYPE(n) ((SQInt32)((n)*sizeof(SQObjectPtr)))
+#define SLOT_VAL(n) ((SQInt32)((n)*sizeof(SQObjectPtr)+offsetof(SQObject,_unVal)))
+
+#define SQ_JIT_MINRUN 4
+
+#define RAX 0
+#define RCX 1
+
+#define CC_E  0x4
+#define CC_NE 0x5
+#define CC_L  0xC
+#define CC_GE 0xD
+#define CC_LE 0xE
+#define CC_G  0xF
+
+struct SQJitFixup
+{
+    SQInteger _pos; //position of the rel32 to patch
+    SQInteger _target; //instruction index
+    bool _exit; //jumps to the exit stub of _target instead of its code
+};
+
+struct SQJitAssembler
+{
+    SQJitAssembler(SQFunctionProto *func) : _func(func), _pc(0) {}
+
+    void B(unsigned char b) { _code.push_back(b); }
+    void I32(SQInt32 v) { for(SQInteger i = 0; i < 4; i++) B((unsigned char)(((SQUnsignedInteger32)v) >> (i*8))); }
+    void Rel32(SQInteger target, bool exit)
+    {
+        SQJitFixup f;
+        f._pos = _code.size(); f._target = target; f._exit = exit;
+        _fixups.push_back(f);
+        I32(0);
+    }
+    //op [rdi+disp32] with a modrm reg field
+    void ModRM(SQInteger reg, SQInt32 disp) { B((unsigned char)(0x80|(reg<<3)|7)); I32(disp); }
+
+    void ExitIf(SQInteger cc) { B(0x0F); B((unsigned char)(0x80|cc)); Rel32(_pc, true); }
+    void JumpIf(SQInteger cc, SQInteger target) { B(0x0F); B((unsigned char)(0x80|cc)); Rel32(target, false); }
+    void Jump(SQInteger target) { B(0xE9); Rel32(target, false); }
+    void Exit(SQInteger nop) { B(0xB8); I32((SQInt32)nop); B(0xC3); } //mov eax,nop; ret
+
+    void GuardType(SQInteger slot, SQObjectType t) { B(0x81); ModRM(7, SLOT_TYPE(slot)); I32((SQInt32)t); ExitIf(CC_NE); }
+    void GuardNotRefCounted(SQInteger slot) { B(0xF7); ModRM(0, SLOT_TYPE(slot)); I32(SQOBJECT_REF_COUNTED); ExitIf(CC_NE); }
+    void LoadVal(SQInteger reg, SQInteger slot) { B(0x48); B(0x8B); ModRM(reg, SLOT_VAL(slot)); }
+    void LoadType(SQInteger reg, SQInteger slot) { B(0x48); B(0x8B); ModRM(reg, SLOT_TYPE(slot)); }
+    void StoreVal(SQInteger reg, SQInteger slot) { B(0x48); B(0x89); ModRM(reg, SLOT_VAL(slot)); }
+    void StoreTypeRaw(SQInteger reg, SQInteger slot) { B(0x48); B(0x89); ModRM(reg, SLOT_TYPE(slot)); }
+    void StoreType(SQInteger slot, SQObjectType t) { B(0xC7); ModRM(0, SLOT_TYPE(slot)); I32((SQInt32)t); }
+    void StoreImm(SQInteger slot, SQInt32 v) { B(0x48); B(0xC7); ModRM(0, SLOT_VAL(slot)); I32(v); }
+    void CmpValImm(SQInteger slot, SQInt32 v) { B(0x48); B(0x81); ModRM(7, SLOT_VAL(slot)); I32(v); }
+    void CmpRegVal(SQInteger reg, SQInteger slot) { B(0x48); B(0x3B); ModRM(reg, SLOT_VAL(slot)); }
+    void SetBool(SQInteger cc, SQInteger slot) //setcc al; movzx eax,al
+    {
+        B(0x0F); B((unsigned char)(0x90|cc)); B(0xC0);
+        B(0x0F); B(0xB6); B(0xC0);
+        StoreType(slot, OT_BOOL);
+        StoreVal(RAX, slot);
+    }
+    void Move(SQInteger to, SQInteger from)
+    {
+        LoadType(RAX, from); LoadVal(RCX, from);
+        StoreTypeRaw(RAX, to); StoreVal(RCX, to);
+    }
+
+    bool IsTarget(SQInteger target) { return target >= 0 && target < _func->_ninstructions; }
+    bool IntLiteral(SQInteger idx, SQInt32 &v)
+    {
+        SQObjectPtr &o = _func->_literals[idx];
+        if(sq_type(o) != OT_INTEGER || _integer(o) != (SQInteger)(SQInt32)_integer(o)) return false;
+        v = (SQInt32)_integer(o);
+        return true;
+    }
+
+    bool Translate(const SQInstruction &i);
+    SQJitCode *Compile();
+
+    SQFunctionProto *_func;
+    SQInteger _pc;
+    sqvector<unsigned char> _code;
+    sqvector<SQJitFixup> _fixups;
+};
+
+static SQInteger CmpCond(SQInteger cmpop, bool &ok)
+{
+    ok = true;
+    switch(cmpop) {
+        case CMP_G: return CC_G;
+        case CMP_GE: return CC_GE;
+        case CMP_L: return CC_L;
+        case CMP_LE: return CC_LE;
+    }
+    ok = false;
+    return 0;
+}
+
+#define INVERT_CC(cc) ((cc)^1)
+
+bool SQJitAssembler::Translate(const SQInstruction &i)
+{
+    SQInteger a0 = i._arg0, a1 = i._arg1, a2 = i._arg2, a3 = i._arg3;
+    switch(i.op) {
+    case _OP_LINE:
+        return true; //the JIT is not entered while a debug hook is set
+    case _OP_LOADINT:
+        GuardNotRefCounted(a0);
+        StoreType(a0, OT_INTEGER); StoreImm(a0, i._arg1);
+        return true;
+    case _OP_LOADBOOL:
+        GuardNotRefCounted(a0);
+        StoreType(a0, OT_BOOL); StoreImm(a0, i._arg1 ? 1 : 0);
+        return true;
+    case _OP_MOVE:
+        GuardNotRefCounted(a1); GuardNotRefCounted(a0);
+        Move(a0, a1);
+        return true;
+    case _OP_DMOVE:
+        GuardNotRefCounted(a1); GuardNotRefCounted(a0);
+        GuardNotRefCounted(a3); GuardNotRefCounted(a2);
+        Move(a0, a1); Move(a2, a3);
+        return true;
+    case _OP_ADD: case _OP_IADD: case _OP_FADD:
+    case _OP_SUB: case _OP_ISUB: case _OP_FSUB:
+    case _OP_MUL: case _OP_IMUL: case _OP_FMUL:
+        GuardType(a2, OT_INTEGER); GuardType(a1, OT_INTEGER); GuardNotRefCounted(a0);
+        LoadVal(RAX, a2); LoadVal(RCX, a1);
+        switch(i.op) {
+            case _OP_ADD: case _OP_IADD: case _OP_FADD: B(0x48); B(0x01); B(0xC8); break; //add rax,rcx
+            case _OP_SUB: case _OP_ISUB: case _OP_FSUB: B(0x48); B(0x29); B(0xC8); break; //sub rax,rcx
+            default: B(0x48); B(0x0F); B(0xAF); B(0xC1); break; //imul rax,rcx
+        }
+        StoreType(a0, OT_INTEGER); StoreVal(RAX, a0);
+        return true;
+    case _OP_ADDI: case _OP_SUBI:
+        GuardType(a2, OT_INTEGER); GuardNotRefCounted(a0);
+        LoadVal(RAX, a2);
+        B(0x48); B(i.op == _OP_ADDI ? 0x05 : 0x2D); I32(i._arg1); //add/sub rax,imm32
+        StoreType(a0, OT_INTEGER); StoreVal(RAX, a0);
+        return true;
+    case _OP_INCL:
+        GuardType(a1, OT_INTEGER);
+        B(0x48); B(0x81); ModRM(0, SLOT_VAL(a1)); I32((SQInt32)(signed char)i._arg3); //add qword [a1],sarg3
+        return true;
+    case _OP_PINCL:
+        GuardType(a1, OT_INTEGER); GuardNotRefCounted(a0);
+        LoadVal(RAX, a1);
+        StoreType(a0, OT_INTEGER); StoreVal(RAX, a0);
+        B(0x48); B(0x81); ModRM(0, SLOT_VAL(a1)); I32((SQInt32)(signed char)i._arg3);
+        return true;
+    case _OP_JMP:
+        if(!IsTarget(_pc + 1 + i._arg1)) return false;
+        Jump(_pc + 1 + i._arg1);
+        return true;
+    case _OP_JCMP: case _OP_IJCMP: {
+        SQInteger target = _pc + 1 + i._arg1;
+        if(!IsTarget(target)) return false;
+        GuardType(a2, OT_INTEGER); GuardType(a0, OT_INTEGER);
+        LoadVal(RAX, a2); CmpRegVal(RAX, a0);
+        bool ok;
+        SQInteger cc = CmpCond(a3, ok);
+        JumpIf(ok ? INVERT_CC(cc) : CC_E, target); //CMP_3W is false when equal
+        return true;
+    }
+    case _OP_JZ: {
+        SQInteger target = _pc + 1 + i._arg1;
+        if(!IsTarget(target)) return false;
+        LoadType(RAX, a0);
+        B(0x3D); I32(OT_NULL); JumpIf(CC_E, target); //cmp eax,OT_NULL
+        B(0x3D); I32(OT_INTEGER); B(0x74); B(0x0B); //cmp eax,OT_INTEGER; je +11
+        B(0x3D); I32(OT_BOOL); ExitIf(CC_NE);
+        CmpValImm(a0, 0); JumpIf(CC_E, target);
+        return true;
+    }
+    case _OP_JEQ: case _OP_JNE: {
+        SQInteger target = _pc + 1 + i._arg1;
+        if(!IsTarget(target)) return false;
+        if(a3 != 0) {
+            SQInt32 v;
+            if(!IntLiteral(a2, v)) return false;
+            GuardType(a0, OT_INTEGER);
+            CmpValImm(a0, v);
+        }
+        else {
+            GuardType(a0, OT_INTEGER); GuardType(a2, OT_INTEGER);
+            LoadVal(RAX, a0); CmpRegVal(RAX, a2);
+        }
+        JumpIf(i.op == _OP_JEQ ? CC_NE : CC_E, target);
+        return true;
+    }
+    case _OP_CMP: case _OP_ICMP: {
+        bool ok;
+        SQInteger cc = CmpCond(a3, ok);
+        if(!ok) return false;
+        GuardType(a2, OT_INTEGER); GuardType(a1, OT_INTEGER); GuardNotRefCounted(a0);
+        LoadVal(RAX, a2); CmpRegVal(RAX, a1);
+        SetBool(cc, a0);
+        return true;
+    }
+    case _OP_EQ: case _OP_NE:
+        if(a3 != 0) {
+            SQInt32 v;
+            if(!IntLiteral(a1, v)) return false;
+            GuardType(a2, OT_INTEGER); GuardNotRefCounted(a0);
+            CmpValImm(a2, v);
+        }
+        else {
+            GuardType(a2, OT_INTEGER); GuardType(a1, OT_INTEGER); GuardNotRefCounted(a0);
+            LoadVal(RAX, a2); CmpRegVal(RAX, a1);
+        }
+        SetBool(i.op == _OP_EQ ? CC_E : CC_NE, a0);
+        return true;
+    default:
+        return false;
+    }
+}
+
+SQJitCode *SQJitAssembler::Compile()
+{
+    SQInteger n = _func->_ninstructions;
+    sqvector<SQInt32> labels; labels.resize(n);
+    sqvector<SQInt32> entries; entries.resize(n);
+    SQInteger ntranslated = 0;
+    for(_pc = 0; _pc < n; _pc++) {
+        labels[_pc] = (SQInt32)_code.size();
+        SQInteger nfixups = _fixups.size();
+        if(Translate(_func->_instructions[_pc])) {
+            entries[_pc] = labels[_pc];
+            ntranslated++;
+        }
+        else {
+            _code.resize(labels[_pc]);
+            _fixups.resize(nfixups);
+            entries[_pc] = -1;
+            Exit(_pc);
+        }
+    }
+    if(ntranslated == 0) return NULL;
+    //entering and leaving the native code costs about as much as interpreting a
+    //couple of instructions, so only enter where a long enough run is translated
+    SQInteger run = 0;
+    for(SQInteger i = n - 1; i >= 0; i--) {
+        const SQInstruction &ins = _func->_instructions[i];
+        if(entries[i] < 0) run = 0;
+        else if(ins.op == _OP_JMP) run = SQ_JIT_MINRUN;
+        else if(ins.op != _OP_LINE) run++;
+        if(run < SQ_JIT_MINRUN) entries[i] = -1;
+    }
+    //exit stubs, only for the instructions that have guards
+    sqvector<SQInt32> exits; exits.resize(n);
+    for(SQInteger i = 0; i < n; i++) exits[i] = -1;
+    for(SQUnsignedInteger i = 0; i < _fixups.size(); i++) {
+        SQJitFixup &f = _fixups[i];
+        if(f._exit && exits[f._target] < 0) {
+            exits[f._target] = (SQInt32)_code.size();
+            Exit(f._target);
+        }
+    }
+    for(SQUnsignedInteger i = 0; i < _fixups.size(); i++) {
+        SQJitFixup &f = _fixups[i];
+        SQInt32 dest = f._exit ? exits[f._target] : labels[f._target];
+        SQInt32 rel = dest - (SQInt32)(f._pos + 4);
+        for(SQInteger k = 0; k < 4; k++) _code[f._pos + k] = (unsigned char)(((SQUnsignedInteger32)rel) >> (k*8));
+    }
+
+    SQInteger codesize = _code.size();
+    void *mem = mmap(NULL, codesize, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if(mem == MAP_FAILED) return NULL;
+    memcpy(mem, &_code[0], codesize);
+    if(mprotect(mem, codesize, PROT_READ|PROT_EXEC) != 0) {
+        munmap(mem, codesize);
+        return NULL;
+    }
+    SQJitCode *jc = (SQJitCode *)SQ_MALLOC(sizeof(SQJitCode) + n*sizeof(SQInt32));
+    jc->_code = (unsigned char *)mem;
+    jc->_codesize = codesize;
+    jc->_ninstructions = n;
+    jc->_entries = (SQInt32 *)(jc + 1);
+    memcpy(jc->_entries, &entries[0], n*sizeof(SQInt32));
+    return jc;
+}
+
+SQJitCode *SQJitCode::Compile(SQFunctionProto *func)
+{
+    if(func->_bgenerator) return NULL;
+    SQJitAssembler a(func);
+    return a.Compile();
+}
+
+void SQJitCode::Release()
+{
+    munmap(_code, _codesize);
+    SQ_FREE(this, sizeof(SQJitCode) + _ninstructions*sizeof(SQInt32));
+}
+
+#endif
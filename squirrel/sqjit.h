@@ -0,0 +1,36 @@
+/*  see copyright notice in squirrel.h */
+#ifndef _SQJIT_H_
+#define _SQJIT_H_
+
+/* the baseline JIT translates the instructions of a hot function prototype to
+   x86-64 code. only a handful of instructions (integer arithmetic, moves, compares
+   and jumps) are translated; every other instruction, and every translated one whose
+   operands are not of the expected type, returns to the interpreter */
+#if defined(SQ_JIT) && defined(_SQ64) && defined(__x86_64__) && !defined(_WIN32)
+#define SQ_USE_JIT
+
+#define SQ_JIT_THRESHOLD 64 //loop back-edges executed before a function is translated
+
+struct SQObjectPtr;
+struct SQFunctionProto;
+
+//runs translated code starting at an instruction, returns the index of the next instruction to interpret
+typedef SQInteger (*SQJitEntry)(SQObjectPtr *stackbase);
+
+struct SQJitCode
+{
+    static SQJitCode *Compile(SQFunctionProto *func);
+    void Release();
+    SQJitEntry GetEntry(SQInteger nop)
+    {
+        return _entries[nop] < 0 ? NULL : (SQJitEntry)(_code + _entries[nop]);
+    }
+    unsigned char *_code;
+    SQInteger _codesize;
+    SQInteger _ninstructions;
+    SQInt32 *_entries;
+};
+
+#endif
+
+#endif //_SQJIT_H_
@@ -9,3 +9,69 @@ void *sq_vm_realloc(void *p, SQUnsignedInteger SQ_UNUSED_ARG(oldsize), SQUnsigne
 
 void sq_vm_free(void *p, SQUnsignedInteger SQ_UNUSED_ARG(size)){ free(p); }
 #endif
+
+#ifdef SQ_USE_POOL
+SQPool::SQPool()
+{
+    memset(_classes,0,sizeof(_classes));
+    _bump = _bumpend = NULL;
+    _slabs = NULL;
+}
+
+SQPool::~SQPool()
+{
+    while(_slabs) {
+        void *next = *(void **)_slabs;
+        sq_vm_free(_slabs,SQ_POOL_SLABSIZE);
+        _slabs = next;
+    }
+}
+
+void *SQPool::Grow(SizeClass &c)
+{
+    SQUnsignedInteger blocksize = ((&c - _classes) + 1) * SQ_POOL_GRANULARITY;
+    SQUnsignedInteger left = (SQUnsignedInteger)(_bumpend - _bump);
+    if(left < blocksize) {
+        if(left) {
+            //the end of the slab becomes a free block of a smaller class
+            SizeClass &t = _classes[left / SQ_POOL_GRANULARITY - 1];
+            FreeBlock *b = (FreeBlock *)_bump;
+            b->_next = t._free;
+            t._free = b;
+            t._nblocks++;
+        }
+        //the first block of a slab links it to the other slabs
+        char *slab = (char *)sq_vm_malloc(SQ_POOL_SLABSIZE);
+        *(void **)slab = _slabs;
+        _slabs = slab;
+        _bump = slab + SQ_POOL_GRANULARITY;
+        _bumpend = slab + SQ_POOL_SLABSIZE;
+    }
+    void *p = _bump;
+    _bump += blocksize;
+    c._nblocks++;
+    return p;
+}
+
+//blocks of the classes are moved, larger blocks are left to sq_vm_realloc
+void *SQPool::Realloc(void *p,SQUnsignedInteger oldsize,SQUnsignedInteger size)
+{
+    if(oldsize > SQ_POOL_MAXSIZE && size > SQ_POOL_MAXSIZE) return sq_vm_realloc(p,oldsize,size);
+    void *np = Alloc(size);
+    if(p) {
+        memcpy(np,p,oldsize < size ? oldsize : size);
+        Free(p,oldsize);
+    }
+    return np;
+}
+
+bool SQPool::GetStats(SQInteger n,SQInteger &blocksize,SQInteger &livebytes,SQInteger &freebytes)
+{
+    if(n < 0 || n >= SQ_POOL_NCLASSES) return false;
+    SizeClass &c = _classes[n];
+    blocksize = (n + 1) * SQ_POOL_GRANULARITY;
+    livebytes = c._nlive * blocksize;
+    freebytes = (c._nblocks - c._nlive) * blocksize;
+    return true;
+}
+#endif
@@ -48,12 +48,37 @@ const SQChar *GetTypeName(const SQObjectPtr &obj1)
 
 SQString *SQString::Create(SQSharedState *ss,const SQChar *s,SQInteger len)
 {
+    if(len<0)
+        len = (SQInteger)scstrlen(s);
+    if(ss->_internlimit > 0 && len >= ss->_internlimit) {
+        //bulk data, not hashed until it is used as a key
+        SQString *t = (SQString *)SQ_POOL_MALLOC(ss,sq_rsl(len)+sizeof(SQString));
+        new (t) SQString;
+        t->_sharedstate = ss;
+        memcpy(t->_val,s,sq_rsl(len));
+        t->_val[len] = _SC('\0');
+        t->_len = len;
+        t->_hash = 0;
+        t->_next = t;
+        return t;
+    }
     SQString *str=ADD_STRING(ss,s,len);
     return str;
 }
 
+SQHash SQString::LazyHash()
+{
+    _hash = _sharedstate->HashStr(_val,_len);
+    return _hash;
+}
+
 void SQString::Release()
 {
+    if(!IsInterned()) {
+        SQInteger size = sizeof(SQString) + sq_rsl(_len);
+        sq_pool_delete_size(this,SQString,size);
+        return;
+    }
     REMOVE_STRING(_sharedstate,this);
 }
 
@@ -125,6 +150,7 @@ bool SQDelegable::SetDelegate(SQTable *mt)
         if (temp->_delegate == this) return false; //cycle detected
         temp = temp->_delegate;
     }
+    GC_BARRIER(this);
     if (mt) __ObjAddRef(mt);
     __ObjRelease(_delegate);
     _delegate = mt;
@@ -137,15 +163,19 @@ bool SQGenerator::Yield(SQVM *v,SQInteger target)
     if(_state==eDead) { v->Raise_Error(_SC("internal vm error, yielding a dead generator")); return false; }
     SQInteger size = v->_top-v->_stackbase;
 
-    _stack.resize(size);
-    SQObject _this = v->_stack[v->_stackbase];
+    GC_BARRIER(this);
+    if(_stack.size() != (SQUnsignedInteger)size) _stack.resize(size);
+    SQObjectPtr *frame = &v->_stack._vals[v->_stackbase];
+    SQObject _this = frame[0];
     _stack._vals[0] = ISREFCOUNTED(sq_type(_this)) ? SQObjectPtr(_refcounted(_this)->GetWeakRef(sq_type(_this))) : _this;
+    frame[0].Null();
+    //the live slots are moved without touching the reference counts, the temporaries are released
     for(SQInteger n =1; n<target; n++) {
-        _stack._vals[n] = v->_stack[v->_stackbase+n];
+        _Swap(_stack._vals[n], frame[n]);
     }
-    for(SQInteger j =0; j < size; j++)
+    for(SQInteger j =target; j < size; j++)
     {
-        v->_stack[v->_stackbase+j].Null();
+        frame[j].Null();
     }
 
     _ci = *v->ci;
@@ -190,12 +220,13 @@ bool SQGenerator::Resume(SQVM *v,SQObjectPtr &dest)
         et._stackbase += newbase;
         et._stacksize += newbase;
     }
+    SQObjectPtr *frame = &v->_stack._vals[v->_stackbase];
     SQObject _this = _stack._vals[0];
-    v->_stack[v->_stackbase] = sq_type(_this) == OT_WEAKREF ? _weakref(_this)->_obj : _this;
+    frame[0] = sq_type(_this) == OT_WEAKREF ? _weakref(_this)->_obj : _this;
 
+    //the values are moved back, the generator gets the (null) slots above the old _top
     for(SQInteger n = 1; n<size; n++) {
-        v->_stack[v->_stackbase+n] = _stack._vals[n];
-        _stack._vals[n].Null();
+        _Swap(frame[n], _stack._vals[n]);
     }
 
     _state=eRunning;
@@ -212,6 +243,21 @@ void SQArray::Extend(const SQArray *a){
             Append(a->_values[i]);
 }
 
+void SQInlineCache::Fill(SQUnsignedInteger tag,SQString *key,SQInteger idx)
+{
+    __ObjAddRef(key);
+    __ObjRelease(_key[IC_WAYS - 1]);
+    for(SQInteger w = IC_WAYS - 1; w > 0; w--) {
+        _tag[w] = _tag[w-1]; _key[w] = _key[w-1]; _idx[w] = _idx[w-1];
+    }
+    _tag[0] = tag; _key[0] = key; _idx[0] = idx;
+}
+
+void SQInlineCache::Release()
+{
+    for(SQInteger w = 0; w < IC_WAYS; w++) __ObjRelease(_key[w]);
+}
+
 const SQChar* SQFunctionProto::GetLocal(SQVM *vm,SQUnsignedInteger stackbase,SQUnsignedInteger nseq,SQUnsignedInteger nop)
 {
     SQUnsignedInteger nvars=_nlocalvarinfos;
@@ -397,6 +443,12 @@ SQFunctionProto::SQFunctionProto(SQSharedState *ss)
 {
     _stacksize=0;
     _bgenerator=false;
+    _icache=NULL;
+    _nsharedclosures=0;
+#ifdef SQ_USE_JIT
+    _jit=NULL;
+    _jithotness=0;
+#endif
     INIT_CHAIN();ADD_TO_CHAIN(&_ss(this)->_gc_chain,this);
 }
 
@@ -536,6 +588,7 @@ bool SQFunctionProto::Load(SQVM *v,SQUserPointer up,SQREADFUNC read,SQObjectPtr
 
     _CHECK_IO(CheckTag(v,read,up,SQ_CLOSURESTREAM_PART));
     _CHECK_IO(SafeRead(v,read,up, f->_instructions, sizeof(SQInstruction)*ninstructions));
+    f->CountSharedClosures();
 
     _CHECK_IO(CheckTag(v,read,up,SQ_CLOSURESTREAM_PART));
     for(i = 0; i < nfunctions; i++){
@@ -552,126 +605,137 @@ bool SQFunctionProto::Load(SQVM *v,SQUserPointer up,SQREADFUNC read,SQObjectPtr
 
 #ifndef NO_GARBAGE_COLLECTOR
 
-#define START_MARK()    if(!(_uiRef&MARK_FLAG)){ \
-        _uiRef|=MARK_FLAG;
-
-#define END_MARK() RemoveFromChain(&_sharedstate->_gc_chain, this); \
-        AddToChain(chain, this); }
-
-void SQVM::Mark(SQCollectable **chain)
+void SQVM::MarkChildren(SQCollectable **chain)
 {
-    START_MARK()
-        SQSharedState::MarkObject(_lasterror,chain);
-        SQSharedState::MarkObject(_errorhandler,chain);
-        SQSharedState::MarkObject(_debughook_closure,chain);
-        SQSharedState::MarkObject(_roottable, chain);
-        SQSharedState::MarkObject(temp_reg, chain);
-        for(SQUnsignedInteger i = 0; i < _stack.size(); i++) SQSharedState::MarkObject(_stack[i], chain);
-        for(SQInteger k = 0; k < _callsstacksize; k++) SQSharedState::MarkObject(_callsstack[k]._closure, chain);
-    END_MARK()
+    SQSharedState::MarkObject(_lasterror,chain);
+    SQSharedState::MarkObject(_errorhandler,chain);
+    SQSharedState::MarkObject(_debughook_closure,chain);
+    SQSharedState::MarkObject(_roottable, chain);
+    SQSharedState::MarkObject(temp_reg, chain);
+    for(SQUnsignedInteger i = 0; i < _stack.size(); i++) SQSharedState::MarkObject(_stack[i], chain);
+    for(SQInteger k = 0; k < _callsstacksize; k++) SQSharedState::MarkObject(_callsstack[k]._closure, chain);
 }
 
-void SQArray::Mark(SQCollectable **chain)
+void SQArray::MarkChildren(SQCollectable **chain)
 {
-    START_MARK()
-        SQInteger len = _values.size();
-        for(SQInteger i = 0;i < len; i++) SQSharedState::MarkObject(_values[i], chain);
-    END_MARK()
+    SQInteger len = _values.size();
+    for(SQInteger i = 0;i < len; i++) SQSharedState::MarkObject(_values[i], chain);
 }
-void SQTable::Mark(SQCollectable **chain)
+void SQTable::MarkChildren(SQCollectable **chain)
 {
-    START_MARK()
-        if(_delegate) _delegate->Mark(chain);
-        SQInteger len = _numofnodes;
-        for(SQInteger i = 0; i < len; i++){
-            SQSharedState::MarkObject(_nodes[i].key, chain);
-            SQSharedState::MarkObject(_nodes[i].val, chain);
+    if(_delegate) _delegate->Mark(chain);
+    for(SQInteger i = 0; i < _arraysize; i++) SQSharedState::MarkObject(_array[i], chain);
+    SQInteger len = _numofnodes;
+    for(SQInteger i = 0; i < len; i++){
+        if(_ctrl[i] < 0) continue;
+        SQSharedState::MarkObject(_nodes[i].key, chain);
+        SQSharedState::MarkObject(_nodes[i].val, chain);
+    }
+    if(_old) {
+        for(SQInteger i = 0; i < _old->numofnodes; i++){
+            if(_old->ctrl[i] < 0) continue;
+            SQSharedState::MarkObject(_old->nodes[i].key, chain);
+            SQSharedState::MarkObject(_old->nodes[i].val, chain);
         }
-    END_MARK()
+    }
 }
 
-void SQClass::Mark(SQCollectable **chain)
+void SQClass::MarkChildren(SQCollectable **chain)
 {
-    START_MARK()
-        _members->Mark(chain);
-        if(_base) _base->Mark(chain);
-        SQSharedState::MarkObject(_attributes, chain);
-        for(SQUnsignedInteger i =0; i< _defaultvalues.size(); i++) {
-            SQSharedState::MarkObject(_defaultvalues[i].val, chain);
-            SQSharedState::MarkObject(_defaultvalues[i].attrs, chain);
-        }
-        for(SQUnsignedInteger j =0; j< _methods.size(); j++) {
-            SQSharedState::MarkObject(_methods[j].val, chain);
-            SQSharedState::MarkObject(_methods[j].attrs, chain);
-        }
-        for(SQUnsignedInteger k =0; k< MT_LAST; k++) {
-            SQSharedState::MarkObject(_metamethods[k], chain);
-        }
-    END_MARK()
+    _members->Mark(chain);
+    if(_base) _base->Mark(chain);
+    SQSharedState::MarkObject(_attributes, chain);
+    for(SQUnsignedInteger i =0; i< _defaultvalues.size(); i++) {
+        SQSharedState::MarkObject(_defaultvalues[i].val, chain);
+        SQSharedState::MarkObject(_defaultvalues[i].attrs, chain);
+    }
+    for(SQUnsignedInteger j =0; j< _methods.size(); j++) {
+        SQSharedState::MarkObject(_methods[j].val, chain);
+        SQSharedState::MarkObject(_methods[j].attrs, chain);
+    }
+    for(SQUnsignedInteger k =0; k< MT_LAST; k++) {
+        SQSharedState::MarkObject(_metamethods[k], chain);
+    }
 }
 
-void SQInstance::Mark(SQCollectable **chain)
+void SQInstance::MarkChildren(SQCollectable **chain)
 {
-    START_MARK()
-        _class->Mark(chain);
-        SQUnsignedInteger nvalues = _class->_defaultvalues.size();
-        for(SQUnsignedInteger i =0; i< nvalues; i++) {
-            SQSharedState::MarkObject(_values[i], chain);
-        }
-    END_MARK()
+    _class->Mark(chain);
+    SQUnsignedInteger nvalues = _class->_defaultvalues.size();
+    for(SQUnsignedInteger i =0; i< nvalues; i++) {
+        SQSharedState::MarkObject(_values[i], chain);
+    }
 }
 
-void SQGenerator::Mark(SQCollectable **chain)
+void SQGenerator::MarkChildren(SQCollectable **chain)
 {
-    START_MARK()
-        for(SQUnsignedInteger i = 0; i < _stack.size(); i++) SQSharedState::MarkObject(_stack[i], chain);
-        SQSharedState::MarkObject(_closure, chain);
-    END_MARK()
+    for(SQUnsignedInteger i = 0; i < _stack.size(); i++) SQSharedState::MarkObject(_stack[i], chain);
+    SQSharedState::MarkObject(_closure, chain);
 }
 
-void SQFunctionProto::Mark(SQCollectable **chain)
+void SQFunctionProto::MarkChildren(SQCollectable **chain)
 {
-    START_MARK()
-        for(SQInteger i = 0; i < _nliterals; i++) SQSharedState::MarkObject(_literals[i], chain);
-        for(SQInteger k = 0; k < _nfunctions; k++) SQSharedState::MarkObject(_functions[k], chain);
-    END_MARK()
+    for(SQInteger i = 0; i < _nliterals; i++) SQSharedState::MarkObject(_literals[i], chain);
+    for(SQInteger k = 0; k < _nfunctions; k++) SQSharedState::MarkObject(_functions[k], chain);
 }
 
-void SQClosure::Mark(SQCollectable **chain)
+void SQClosure::MarkChildren(SQCollectable **chain)
 {
-    START_MARK()
-        if(_base) _base->Mark(chain);
-        SQFunctionProto *fp = _function;
-        fp->Mark(chain);
-        for(SQInteger i = 0; i < fp->_noutervalues; i++) SQSharedState::MarkObject(_outervalues[i], chain);
-        for(SQInteger k = 0; k < fp->_ndefaultparams; k++) SQSharedState::MarkObject(_defaultparams[k], chain);
-    END_MARK()
+    if(_base) _base->Mark(chain);
+    SQFunctionProto *fp = _function;
+    fp->Mark(chain);
+    for(SQInteger i = 0; i < fp->_noutervalues; i++) SQSharedState::MarkObject(_outervalues[i], chain);
+    for(SQInteger k = 0; k < fp->_ndefaultparams; k++) SQSharedState::MarkObject(_defaultparams[k], chain);
+    for(SQInteger n = 0; n < fp->_nsharedclosures; n++) SQSharedState::MarkObject(_shared[n], chain);
 }
 
-void SQNativeClosure::Mark(SQCollectable **chain)
+void SQNativeClosure::MarkChildren(SQCollectable **chain)
 {
-    START_MARK()
-        for(SQUnsignedInteger i = 0; i < _noutervalues; i++) SQSharedState::MarkObject(_outervalues[i], chain);
-    END_MARK()
+    for(SQUnsignedInteger i = 0; i < _noutervalues; i++) SQSharedState::MarkObject(_outervalues[i], chain);
 }
 
-void SQOuter::Mark(SQCollectable **chain)
+void SQOuter::MarkChildren(SQCollectable **chain)
 {
-    START_MARK()
     /* If the valptr points to a closed value, that value is alive */
     if(_valptr == &_value) {
       SQSharedState::MarkObject(_value, chain);
     }
-    END_MARK()
 }
 
-void SQUserData::Mark(SQCollectable **chain){
-    START_MARK()
-        if(_delegate) _delegate->Mark(chain);
-    END_MARK()
+void SQUserData::MarkChildren(SQCollectable **chain){
+    if(_delegate) _delegate->Mark(chain);
+}
+
+void SQCollectable::Mark(SQCollectable **chain)
+{
+    if(!(_uiRef&MARK_FLAG)) {
+        _uiRef|=MARK_FLAG|GRAY_FLAG;
+        RemoveFromChain(&_sharedstate->_gc_chain, this);
+        AddToChain(chain, this);
+    }
+}
+
+void SQCollectable::UnMark() { _uiRef&=~(MARK_FLAG|GRAY_FLAG); }
+
+void SQCollectable::GrayAgain()
+{
+    //the children are marked again when the mark phase ends
+    if(_sharedstate->_gc_state == GC_MARK) {
+        _uiRef|=GRAY_FLAG;
+        RemoveFromChain(&_sharedstate->_gc_black, this);
+        AddToChain(&_sharedstate->_gc_grayagain, this);
+    }
 }
 
-void SQCollectable::UnMark() { _uiRef&=~MARK_FLAG; }
+//a marked object released by the program is in the gray, grayagain or black chain
+void SQCollectable::UnlinkMarked()
+{
+    SQSharedState *ss = _sharedstate;
+    SQCollectable **chain = &ss->_gc_black;
+    if(ss->_gc_gray == this) chain = &ss->_gc_gray;
+    else if(ss->_gc_grayagain == this) chain = &ss->_gc_grayagain;
+    RemoveFromChain(chain, this);
+}
 
 #endif
 
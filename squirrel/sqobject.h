@@ -105,12 +105,25 @@ struct SQWeakRef : SQRefCounted
 
 struct SQObjectPtr;
 
+#ifndef NO_GARBAGE_COLLECTOR
+/* an object reached by the collector has MARK_FLAG set, and GRAY_FLAG as long as
+   its children still have to be marked. the reference count is _uiRef without the
+   flags; an object that loses its last reference while marked is released at once
+   and leaves the chain of the collection in progress (see UnlinkMarked) */
+#define MARK_FLAG 0x80000000
+#define GRAY_FLAG 0x40000000
+#define REF_MASK (~(SQUnsignedInteger)(MARK_FLAG|GRAY_FLAG))
+#else
+#define REF_MASK (~(SQUnsignedInteger)0)
+#endif
+#define REF_COUNT(obj) ((obj)->_uiRef&REF_MASK)
+
 #define __AddRef(type,unval) if(ISREFCOUNTED(type)) \
         { \
             unval.pRefCounted->_uiRef++; \
         }
 
-#define __Release(type,unval) if(ISREFCOUNTED(type) && ((--unval.pRefCounted->_uiRef)==0))  \
+#define __Release(type,unval) if(ISREFCOUNTED(type) && (((--unval.pRefCounted->_uiRef)&REF_MASK)==0))  \
         {   \
             unval.pRefCounted->Release();   \
         }
@@ -118,7 +131,7 @@ struct SQObjectPtr;
 #define __ObjRelease(obj) { \
     if((obj)) { \
         (obj)->_uiRef--; \
-        if((obj)->_uiRef == 0) \
+        if(REF_COUNT(obj) == 0) \
             (obj)->Release(); \
         (obj) = NULL;   \
     } \
@@ -309,15 +322,17 @@ inline void _Swap(SQObject &a,SQObject &b)
 
 /////////////////////////////////////////////////////////////////////////////////////
 #ifndef NO_GARBAGE_COLLECTOR
-#define MARK_FLAG 0x80000000
 struct SQCollectable : public SQRefCounted {
     SQCollectable *_next;
     SQCollectable *_prev;
     SQSharedState *_sharedstate;
     virtual SQObjectType GetType()=0;
     virtual void Release()=0;
-    virtual void Mark(SQCollectable **chain)=0;
+    void Mark(SQCollectable **chain);
+    virtual void MarkChildren(SQCollectable **chain)=0;
     void UnMark();
+    void GrayAgain();
+    void UnlinkMarked();
     virtual void Finalize()=0;
     static void AddToChain(SQCollectable **chain,SQCollectable *c);
     static void RemoveFromChain(SQCollectable **chain,SQCollectable *c);
@@ -325,15 +340,18 @@ struct SQCollectable : public SQRefCounted {
 
 
 #define ADD_TO_CHAIN(chain,obj) AddToChain(chain,obj)
-#define REMOVE_FROM_CHAIN(chain,obj) {if(!(_uiRef&MARK_FLAG))RemoveFromChain(chain,obj);}
+#define REMOVE_FROM_CHAIN(chain,obj) {if(!(_uiRef&MARK_FLAG))RemoveFromChain(chain,obj); else (obj)->UnlinkMarked();}
 #define CHAINABLE_OBJ SQCollectable
 #define INIT_CHAIN() {_next=NULL;_prev=NULL;_sharedstate=ss;}
+//write barrier: an object whose children were already marked must be marked again when it gets a new reference
+#define GC_BARRIER(obj) {if(((obj)->_uiRef&(MARK_FLAG|GRAY_FLAG))==MARK_FLAG)(obj)->GrayAgain();}
 #else
 
 #define ADD_TO_CHAIN(chain,obj) ((void)0)
 #define REMOVE_FROM_CHAIN(chain,obj) ((void)0)
 #define CHAINABLE_OBJ SQRefCounted
 #define INIT_CHAIN() ((void)0)
+#define GC_BARRIER(obj) ((void)0)
 #endif
 
 struct SQDelegable : public CHAINABLE_OBJ {
@@ -99,9 +99,26 @@ enum SQOpcode
     _OP_THROW=              0x39,
     _OP_NEWSLOTA=           0x3A,
     _OP_GETBASE=            0x3B,
-    _OP_CLOSE=              0x3C
+    _OP_CLOSE=              0x3C,
+    _OP_ADDI=               0x3D,
+    _OP_SUBI=               0x3E,
+    _OP_JEQ=                0x3F,
+    _OP_JNE=                0x40,
+    _OP_CALLK=              0x41,
+    _OP_IADD=               0x42,
+    _OP_ISUB=               0x43,
+    _OP_IMUL=               0x44,
+    _OP_FADD=               0x45,
+    _OP_FSUB=               0x46,
+    _OP_FMUL=               0x47,
+    _OP_ICMP=               0x48,
+    _OP_IJCMP=              0x49,
+    _OP_GETFIELD=           0x4A,
+    _OP_SETFIELD=           0x4B
 };
 
+#define SQ_OPCODE_COUNT (_OP_SETFIELD+1)
+
 struct SQInstructionDesc {
     const SQChar *name;
 };
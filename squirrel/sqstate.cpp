@@ -19,8 +19,13 @@ SQSharedState::SQSharedState()
     _errorfunc = NULL;
     _debuginfo = false;
     _notifyallexceptions = false;
+    _jitenabled = false;
+    _nextclassserial = IC_FIRSTCLASS;
     _foreignptr = NULL;
     _releasehook = NULL;
+    _stringhash = SQ_STRINGHASH_FULL;
+    _hashseed = 0;
+    _internlimit = SQ_STRING_INTERNLIMIT;
 }
 
 #define newsysstring(s) {   \
@@ -95,6 +100,13 @@ void SQSharedState::Init()
     _scratchpadsize=0;
 #ifndef NO_GARBAGE_COLLECTOR
     _gc_chain=NULL;
+    _gc_gray=NULL;
+    _gc_grayagain=NULL;
+    _gc_black=NULL;
+    _gc_sweep=NULL;
+    _gc_state=GC_IDLE;
+    _gc_freed=0;
+    memset(&_gc_stats,0,sizeof(_gc_stats));
 #endif
     _stringtable = (SQStringTable*)SQ_MALLOC(sizeof(SQStringTable));
     new (_stringtable) SQStringTable(this);
@@ -156,6 +168,9 @@ void SQSharedState::Init()
 
 SQSharedState::~SQSharedState()
 {
+#ifndef NO_GARBAGE_COLLECTOR
+    ResetGC();
+#endif
     if(_releasehook) { _releasehook(_foreignptr,0); _releasehook = NULL; }
     _constructoridx.Null();
     _table(_registry)->Finalize();
@@ -237,44 +252,213 @@ void SQSharedState::MarkObject(SQObjectPtr &o,SQCollectable **chain)
     case OT_INSTANCE:_instance(o)->Mark(chain);break;
     case OT_OUTER:_outer(o)->Mark(chain);break;
     case OT_FUNCPROTO:_funcproto(o)->Mark(chain);break;
+    case OT_WEAKREF: {
+        //a weak reference to an object that isn't marked yet is checked again by FinishMark()
+        SQObject &t = _weakref(o)->_obj;
+        if(ISREFCOUNTED(sq_type(t)) && sq_type(t) != OT_STRING && sq_type(t) != OT_WEAKREF
+            && !(t._unVal.pRefCounted->_uiRef & MARK_FLAG)) {
+            ((SQCollectable *)t._unVal.pRefCounted)->_sharedstate->_gc_weakrefs.push_back(o);
+        }
+        }
+        break;
     default: break; //shutup compiler
     }
 }
 
-void SQSharedState::RunMark(SQVM* SQ_UNUSED_ARG(vm),SQCollectable **tchain)
+void SQSharedState::MarkRoots()
+{
+    SQCollectable **chain = &_gc_gray;
+    _gc_stats.work++;
+
+    _thread(_root_vm)->Mark(chain);
+
+    _refs_table.Mark(chain);
+    MarkObject(_registry,chain);
+    MarkObject(_consts,chain);
+    MarkObject(_metamethodsmap,chain);
+    MarkObject(_table_default_delegate,chain);
+    MarkObject(_array_default_delegate,chain);
+    MarkObject(_string_default_delegate,chain);
+    MarkObject(_number_default_delegate,chain);
+    MarkObject(_generator_default_delegate,chain);
+    MarkObject(_thread_default_delegate,chain);
+    MarkObject(_closure_default_delegate,chain);
+    MarkObject(_class_default_delegate,chain);
+    MarkObject(_instance_default_delegate,chain);
+    MarkObject(_weakref_default_delegate,chain);
+
+}
+
+/* marks the children of up to 'budget' gray objects (all of them if budget is
+   negative) and returns the budget left. a thread changes its stack without write
+   barriers, unless all the gray objects are marked at once its children are
+   marked again by FinishMark() */
+SQInteger SQSharedState::Propagate(SQInteger budget)
+{
+    while(_gc_gray && budget != 0) {
+        SQCollectable *c = _gc_gray;
+        SQCollectable::RemoveFromChain(&_gc_gray, c);
+        if(budget > 0 && c->GetType() == OT_THREAD) {
+            SQCollectable::AddToChain(&_gc_grayagain, c);
+        }
+        else {
+            c->_uiRef &= ~GRAY_FLAG;
+            SQCollectable::AddToChain(&_gc_black, c);
+        }
+        c->MarkChildren(&_gc_gray);
+        _gc_stats.work++;
+        if(budget > 0) budget--;
+    }
+    return budget;
+}
+
+/* atomic end of the mark phase: the roots and the objects in _gc_grayagain are
+   marked again, then every object left in _gc_chain is unreachable. the weak
+   references met while marking that point to them are cleared, so the program
+   can't reach them any more while Sweep() frees them */
+void SQSharedState::FinishMark()
 {
-    SQVM *vms = _thread(_root_vm);
+    SQInteger work = _gc_stats.work;
+    while(_gc_grayagain) {
+        SQCollectable *c = _gc_grayagain;
+        SQCollectable::RemoveFromChain(&_gc_grayagain, c);
+        SQCollectable::AddToChain(&_gc_gray, c);
+    }
+    MarkRoots();
+    Propagate(-1);
+
+    for(SQUnsignedInteger i = 0; i < _gc_weakrefs.size(); i++) {
+        SQObject &t = _weakref(_gc_weakrefs[i])->_obj;
+        if(sq_type(t) != OT_NULL && !(t._unVal.pRefCounted->_uiRef & MARK_FLAG)) {
+            t._unVal.pRefCounted->_weakref = NULL;
+            t._type = OT_NULL;
+            t._unVal.pRefCounted = NULL;
+        }
+        _gc_stats.work++;
+    }
+    _gc_weakrefs.resize(0);
+    _gc_sweep = _gc_chain;
+    if(_gc_sweep) _gc_sweep->_uiRef++;
+    _gc_state = GC_SWEEP;
+    _gc_stats.lastatomic = _gc_stats.work - work;
+    if(_gc_stats.lastatomic > _gc_stats.maxatomic) _gc_stats.maxatomic = _gc_stats.lastatomic;
+}
 
-    vms->Mark(tchain);
+/* frees up to 'budget' of the unreachable objects (all of them if budget is negative)
+   and returns the budget left. they are the end of _gc_chain from _gc_sweep on, new
+   objects are added in front of them; _gc_sweep holds a reference so it can't be
+   released by the finalization of the others */
+SQInteger SQSharedState::Sweep(SQInteger budget)
+{
+    while(_gc_sweep && budget != 0) {
+        SQCollectable *t = _gc_sweep;
+        t->Finalize();
+        _gc_sweep = t->_next;
+        if(_gc_sweep) _gc_sweep->_uiRef++;
+        if(--t->_uiRef == 0)
+            t->Release();
+        _gc_freed++;
+        _gc_stats.freed++;
+        _gc_stats.work++;
+        if(budget > 0) budget--;
+    }
+    if(_gc_state == GC_SWEEP) _gc_state = GC_UNMARK;
+    return budget;
+}
 
-    _refs_table.Mark(tchain);
-    MarkObject(_registry,tchain);
-    MarkObject(_consts,tchain);
-    MarkObject(_metamethodsmap,tchain);
-    MarkObject(_table_default_delegate,tchain);
-    MarkObject(_array_default_delegate,tchain);
-    MarkObject(_string_default_delegate,tchain);
-    MarkObject(_number_default_delegate,tchain);
-    MarkObject(_generator_default_delegate,tchain);
-    MarkObject(_thread_default_delegate,tchain);
-    MarkObject(_closure_default_delegate,tchain);
-    MarkObject(_class_default_delegate,tchain);
-    MarkObject(_instance_default_delegate,tchain);
-    MarkObject(_weakref_default_delegate,tchain);
+/* moves up to 'budget' marked objects back to _gc_chain (all of them if budget is
+   negative) and returns the budget left */
+SQInteger SQSharedState::Unmark(SQInteger budget)
+{
+    while(_gc_black && budget != 0) {
+        SQCollectable *c = _gc_black;
+        SQCollectable::RemoveFromChain(&_gc_black, c);
+        c->UnMark();
+        SQCollectable::AddToChain(&_gc_chain, c);
+        _gc_stats.work++;
+        if(budget > 0) budget--;
+    }
+    if(!_gc_black) _gc_state = GC_IDLE;
+    return budget;
+}
 
+//ends the collection in progress, if any: a pending sweep is finished, freeing the unreachable
+//objects it has left, and every object is unmarked. CollectGarbage() and ~SQSharedState()
+//rely on both
+void SQSharedState::ResetGC()
+{
+    SQCollectable **chains[] = { &_gc_gray, &_gc_grayagain };
+    for(SQInteger i = 0; i < 2; i++) {
+        while(*chains[i]) {
+            SQCollectable *c = *chains[i];
+            SQCollectable::RemoveFromChain(chains[i], c);
+            SQCollectable::AddToChain(&_gc_black, c);
+        }
+    }
+    _gc_weakrefs.resize(0);
+    Sweep(-1);
+    Unmark(-1);
+}
+
+//updates the statistics at the end of a call that did 'work' units of work
+void SQSharedState::EndStep(SQInteger work)
+{
+    _gc_stats.steps++;
+    if(work > _gc_stats.maxstep) _gc_stats.maxstep = work;
+}
+
+/* does about 'budget' units of work (marking the children of an object, freeing or
+   unmarking it) of the current collection, starting a new one if none is in progress.
+   stops when the budget is spent or when the collection ends; returns -1 while the
+   collection is in progress, otherwise the number of unreachable objects it freed */
+SQInteger SQSharedState::GCStep(SQInteger budget)
+{
+    SQInteger work = _gc_stats.work;
+    SQInteger ret = -1;
+    if(budget < 1) budget = 1;
+    while(budget > 0) {
+        switch(_gc_state) {
+        case GC_IDLE:
+            MarkRoots();
+            _gc_state = GC_MARK;
+            _gc_freed = 0;
+            budget--;
+            break;
+        case GC_MARK:
+            budget = Propagate(budget);
+            if(!_gc_gray) FinishMark();
+            break;
+        case GC_SWEEP:
+            budget = Sweep(budget);
+            break;
+        case GC_UNMARK:
+            budget = Unmark(budget);
+            if(_gc_state == GC_IDLE) {
+                _gc_stats.cycles++;
+                ret = _gc_freed;
+                budget = 0;
+            }
+            break;
+        }
+    }
+    EndStep(_gc_stats.work - work);
+    return ret;
 }
 
 SQInteger SQSharedState::ResurrectUnreachable(SQVM *vm)
 {
     SQInteger n=0;
-    SQCollectable *tchain=NULL;
 
-    RunMark(vm,&tchain);
+    ResetGC();
+    _gc_state = GC_MARK;
+    MarkRoots();
+    Propagate(-1);
+    _gc_weakrefs.resize(0);
 
     SQCollectable *resurrected = _gc_chain;
     SQCollectable *t = resurrected;
 
-    _gc_chain = tchain;
+    _gc_chain = NULL;
 
     SQArray *ret = NULL;
     if(resurrected) {
@@ -302,11 +486,8 @@ SQInteger SQSharedState::ResurrectUnreachable(SQVM *vm)
         _gc_chain = resurrected;
     }
 
-    t = _gc_chain;
-    while(t) {
-        t->UnMark();
-        t = t->_next;
-    }
+    _gc_state = GC_UNMARK;
+    Unmark(-1);
 
     if(ret) {
         SQObjectPtr temp = ret;
@@ -318,36 +499,19 @@ SQInteger SQSharedState::ResurrectUnreachable(SQVM *vm)
     return n;
 }
 
-SQInteger SQSharedState::CollectGarbage(SQVM *vm)
+SQInteger SQSharedState::CollectGarbage(SQVM * SQ_UNUSED_ARG(vm))
 {
-    SQInteger n = 0;
-    SQCollectable *tchain = NULL;
-
-    RunMark(vm,&tchain);
-
-    SQCollectable *t = _gc_chain;
-    SQCollectable *nx = NULL;
-    if(t) {
-        t->_uiRef++;
-        while(t) {
-            t->Finalize();
-            nx = t->_next;
-            if(nx) nx->_uiRef++;
-            if(--t->_uiRef == 0)
-                t->Release();
-            t = nx;
-            n++;
-        }
-    }
-
-    t = tchain;
-    while(t) {
-        t->UnMark();
-        t = t->_next;
-    }
-    _gc_chain = tchain;
-
-    return n;
+    //a collection in progress is restarted, objects that lost their references since it started are freed too
+    SQInteger work = _gc_stats.work;
+    ResetGC();
+    _gc_state = GC_MARK;
+    _gc_freed = 0;
+    FinishMark();
+    Sweep(-1);
+    Unmark(-1);
+    _gc_stats.cycles++;
+    EndStep(_gc_stats.work - work);
+    return _gc_freed;
 }
 #endif
 
@@ -549,6 +713,117 @@ void RefTable::AllocNodes(SQUnsignedInteger size)
     _slotused = 0;
     _numofslots = size;
 }
+//////////////////////////////////////////////////////////////////////////
+//string hash
+/*
+* _hashstr_full() is based on wyhash (public domain, Wang Yi)
+* https://github.com/wangyi-fudan/wyhash
+* it reads the string 8 bytes at a time (3 independent lanes for long strings)
+* and mixes them with 64x64->128 bit multiplications, every character counts
+*/
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+typedef unsigned long long _sqhash64;
+
+static const _sqhash64 _hash_secret[4] = {
+    0x2d358dccaa6c78a5ULL, 0x8bb84b93962eacc9ULL, 0x4b33a62ed433d4a3ULL, 0x4d5a2da51de1aa47ULL
+};
+
+#if defined(__SIZEOF_INT128__)
+__extension__ typedef unsigned __int128 _sqhash128; //not ISO C++, -pedantic would warn
+#endif
+
+static inline void _hash_mum(_sqhash64 *a, _sqhash64 *b)
+{
+#if defined(__SIZEOF_INT128__)
+    _sqhash128 r = (_sqhash128)*a * *b;
+    *a = (_sqhash64)r; *b = (_sqhash64)(r >> 64);
+#elif defined(_MSC_VER) && defined(_M_X64)
+    *a = _umul128(*a, *b, b);
+#else
+    _sqhash64 ha = *a >> 32, hb = *b >> 32, la = (unsigned int)*a, lb = (unsigned int)*b;
+    _sqhash64 rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb, t = rl + (rm0 << 32), c = t < rl;
+    _sqhash64 lo = t + (rm1 << 32);
+    c += lo < t;
+    *a = lo; *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static inline _sqhash64 _hash_mix(_sqhash64 a, _sqhash64 b) { _hash_mum(&a, &b); return a ^ b; }
+//unaligned little endian reads (memcpy compiles to a single load)
+static inline _sqhash64 _hash_r8(const unsigned char *p)
+{
+    _sqhash64 v; memcpy(&v, p, 8);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap64(v);
+#endif
+    return v;
+}
+static inline _sqhash64 _hash_r4(const unsigned char *p)
+{
+    unsigned int v; memcpy(&v, p, 4);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    v = __builtin_bswap32(v);
+#endif
+    return v;
+}
+static inline _sqhash64 _hash_r3(const unsigned char *p, size_t k)
+{
+    return (((_sqhash64)p[0]) << 16) | (((_sqhash64)p[k >> 1]) << 8) | p[k - 1];
+}
+
+SQHash _hashstr_full(const SQChar *s, size_t l, SQUnsignedInteger seed)
+{
+    const unsigned char *p = (const unsigned char *)s;
+    size_t len = sq_rsl(l);
+    _sqhash64 sd = (_sqhash64)seed, a, b;
+    sd ^= _hash_mix(sd ^ _hash_secret[0], _hash_secret[1]);
+    if(len <= 16) {
+        if(len >= 4) {
+            a = (_hash_r4(p) << 32) | _hash_r4(p + ((len >> 3) << 2));
+            b = (_hash_r4(p + len - 4) << 32) | _hash_r4(p + len - 4 - ((len >> 3) << 2));
+        }
+        else if(len > 0) { a = _hash_r3(p, len); b = 0; }
+        else a = b = 0;
+    }
+    else {
+        size_t i = len;
+        if(i > 48) {
+            _sqhash64 sd1 = sd, sd2 = sd;
+            do {
+                sd = _hash_mix(_hash_r8(p) ^ _hash_secret[1], _hash_r8(p + 8) ^ sd);
+                sd1 = _hash_mix(_hash_r8(p + 16) ^ _hash_secret[2], _hash_r8(p + 24) ^ sd1);
+                sd2 = _hash_mix(_hash_r8(p + 32) ^ _hash_secret[3], _hash_r8(p + 40) ^ sd2);
+                p += 48; i -= 48;
+            } while(i > 48);
+            sd ^= sd1 ^ sd2;
+        }
+        while(i > 16) {
+            sd = _hash_mix(_hash_r8(p) ^ _hash_secret[1], _hash_r8(p + 8) ^ sd);
+            i -= 16; p += 16;
+        }
+        a = _hash_r8(p + i - 16); b = _hash_r8(p + i - 8);
+    }
+    a ^= _hash_secret[1]; b ^= sd;
+    _hash_mum(&a, &b);
+    _sqhash64 h = _hash_mix(a ^ _hash_secret[0] ^ len, b ^ _hash_secret[1]);
+#ifdef _SQ64
+    return (SQHash)h;
+#else
+    return (SQHash)(h ^ (h >> 32));
+#endif
+}
+
+//never 0, SQString::_hash is 0 until the hash of an uninterned string is computed
+SQHash SQSharedState::HashStr(const SQChar *s,SQInteger len)
+{
+    SQHash h = (_stringhash == SQ_STRINGHASH_SAMPLED) ? ::_hashstr(s,len) : ::_hashstr_full(s,len,_hashseed);
+    return h ? h : 1;
+}
+
 //////////////////////////////////////////////////////////////////////////
 //SQStringTable
 /*
@@ -562,12 +837,17 @@ SQStringTable::SQStringTable(SQSharedState *ss)
     _sharedstate = ss;
     AllocNodes(4);
     _slotused = 0;
+    _oldstrings = NULL;
+    _oldnumofslots = 0;
+    _migrated = 0;
 }
 
 SQStringTable::~SQStringTable()
 {
     SQ_FREE(_strings,sizeof(SQString*)*_numofslots);
     _strings = NULL;
+    if(_oldstrings) SQ_FREE(_oldstrings,sizeof(SQString*)*_oldnumofslots);
+    _oldstrings = NULL;
 }
 
 void SQStringTable::AllocNodes(SQInteger size)
@@ -577,67 +857,99 @@ void SQStringTable::AllocNodes(SQInteger size)
     memset(_strings,0,sizeof(SQString*)*_numofslots);
 }
 
+//the bucket of a hash, an old bucket that hasn't been split yet holds the strings of two new ones
+SQString **SQStringTable::Bucket(SQHash hash)
+{
+    if(_oldstrings) {
+        SQHash h = hash&(_oldnumofslots-1);
+        if(h >= _migrated) return &_oldstrings[h];
+    }
+    return &_strings[hash&(_numofslots-1)];
+}
+
 SQString *SQStringTable::Add(const SQChar *news,SQInteger len)
 {
     if(len<0)
         len = (SQInteger)scstrlen(news);
-    SQHash newhash = ::_hashstr(news,len);
-    SQHash h = newhash&(_numofslots-1);
+    SQHash newhash = _sharedstate->HashStr(news,len);
+    if(_oldstrings)
+        Migrate(SQ_STRINGTABLE_MIGRATESTEP);
+    SQString **bucket = Bucket(newhash);
     SQString *s;
-    for (s = _strings[h]; s; s = s->_next){
+    for (s = *bucket; s; s = s->_next){
         if(s->_len == len && (!memcmp(news,s->_val,sq_rsl(len))))
             return s; //found
     }
 
-    SQString *t = (SQString *)SQ_MALLOC(sq_rsl(len)+sizeof(SQString));
+    SQString *t = (SQString *)SQ_POOL_MALLOC(_sharedstate,sq_rsl(len)+sizeof(SQString));
     new (t) SQString;
     t->_sharedstate = _sharedstate;
     memcpy(t->_val,news,sq_rsl(len));
     t->_val[len] = _SC('\0');
     t->_len = len;
     t->_hash = newhash;
-    t->_next = _strings[h];
-    _strings[h] = t;
+    t->_next = *bucket;
+    *bucket = t;
     _slotused++;
     if (_slotused > _numofslots)  /* too crowded? */
         Resize(_numofslots*2);
     return t;
 }
 
-void SQStringTable::Resize(SQInteger size)
+//splits up to 'nbuckets' old buckets in the two new buckets their strings go to
+void SQStringTable::Migrate(SQUnsignedInteger nbuckets)
 {
-    SQInteger oldsize=_numofslots;
-    SQString **oldtable=_strings;
-    AllocNodes(size);
-    for (SQInteger i=0; i<oldsize; i++){
-        SQString *p = oldtable[i];
+    for(; nbuckets && _migrated < _oldnumofslots; nbuckets--, _migrated++) {
+        SQString **lo = &_strings[_migrated];
+        SQString **hi = &_strings[_migrated + _oldnumofslots];
+        *lo = *hi = NULL;
+        SQString *p = _oldstrings[_migrated];
         while(p){
             SQString *next = p->_next;
-            SQHash h = p->_hash&(_numofslots-1);
-            p->_next = _strings[h];
-            _strings[h] = p;
+            SQString **b = (p->_hash & _oldnumofslots) ? hi : lo;
+            p->_next = *b;
+            *b = p;
             p = next;
         }
     }
-    SQ_FREE(oldtable,oldsize*sizeof(SQString*));
+    if(_migrated == _oldnumofslots) {
+        SQ_FREE(_oldstrings,_oldnumofslots*sizeof(SQString*));
+        _oldstrings = NULL;
+        _oldnumofslots = 0;
+    }
+}
+
+//the table doubles; the new buckets are set when the old ones are split, by the next calls to
+//Add(). the table doubles again only after as many insertions as there are old buckets so the
+//split is always over by then
+void SQStringTable::Resize(SQInteger size)
+{
+    assert(size == (SQInteger)_numofslots*2);
+    if(_oldstrings)
+        Migrate(_oldnumofslots);
+    _oldstrings = _strings;
+    _oldnumofslots = _numofslots;
+    _migrated = 0;
+    _numofslots = size;
+    _strings = (SQString**)SQ_MALLOC(sizeof(SQString*)*_numofslots);
 }
 
 void SQStringTable::Remove(SQString *bs)
 {
     SQString *s;
     SQString *prev=NULL;
-    SQHash h = bs->_hash&(_numofslots - 1);
+    SQString **bucket = Bucket(bs->_hash);
 
-    for (s = _strings[h]; s; ){
+    for (s = *bucket; s; ){
         if(s == bs){
             if(prev)
                 prev->_next = s->_next;
             else
-                _strings[h] = s->_next;
+                *bucket = s->_next;
             _slotused--;
             SQInteger slen = s->_len;
             s->~SQString();
-            SQ_FREE(s,sizeof(SQString) + sq_rsl(slen));
+            SQ_POOL_FREE(_sharedstate,s,sizeof(SQString) + sq_rsl(slen));
             return;
         }
         prev = s;
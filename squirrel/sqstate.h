@@ -8,6 +8,12 @@ struct SQString;
 struct SQTable;
 //max number of character for a printed number
 #define NUMBER_MAX_CHAR 50
+//old buckets split by every SQStringTable::Add() while the table is resized
+#define SQ_STRINGTABLE_MIGRATESTEP 2
+//default length from which strings aren't interned (see sq_setinternlimit)
+#ifndef SQ_STRING_INTERNLIMIT
+#define SQ_STRING_INTERNLIMIT 1024
+#endif
 
 struct SQStringTable
 {
@@ -18,9 +24,15 @@ struct SQStringTable
 private:
     void Resize(SQInteger size);
     void AllocNodes(SQInteger size);
+    void Migrate(SQUnsignedInteger nbuckets);
+    SQString **Bucket(SQHash hash);
     SQString **_strings;
     SQUnsignedInteger _numofslots;
     SQUnsignedInteger _slotused;
+    //after a resize the old buckets are split a few at a time, the new ones are set as they are split
+    SQString **_oldstrings;
+    SQUnsignedInteger _oldnumofslots;
+    SQUnsignedInteger _migrated;
     SQSharedState *_sharedstate;
 };
 
@@ -51,6 +63,83 @@ private:
     RefNode **_buckets;
 };
 
+#ifndef NO_GARBAGE_COLLECTOR
+//state of the incremental collector (SQSharedState::_gc_state)
+enum SQGCState {
+    GC_IDLE,    //no collection in progress, every object is in _gc_chain
+    GC_MARK,    //marking the objects reachable from the roots
+    GC_SWEEP,   //freeing the unreachable objects, from _gc_sweep to the end of _gc_chain
+    GC_UNMARK   //the marked objects are moved back to _gc_chain
+};
+#endif
+
+#if defined(SQ_POOL_ALLOCATOR) && !defined(NO_GARBAGE_COLLECTOR)
+#define SQ_USE_POOL
+/* size-class allocator for the small objects of a shared state (tables, arrays,
+   closures, strings, hash nodes...). blocks are carved, in allocation order, from slabs
+   obtained with sq_vm_malloc and a freed block goes to the free list of its size class;
+   the size passed to SQ_POOL_FREE selects the class, so blocks have no header.
+   slabs are released with the shared state */
+#define SQ_POOL_GRANULARITY (SQ_ALIGNMENT > 8 ? SQ_ALIGNMENT : 8) //also the alignment of the blocks
+#define SQ_POOL_MAXSIZE 512
+#define SQ_POOL_NCLASSES (SQ_POOL_MAXSIZE/SQ_POOL_GRANULARITY)
+#define SQ_POOL_SLABSIZE 16384
+
+struct SQPool
+{
+    struct FreeBlock {
+        FreeBlock *_next;
+    };
+    struct SizeClass {
+        FreeBlock *_free;
+        SQUnsignedInteger _nlive;
+        SQUnsignedInteger _nblocks; //blocks carved for this class, live or free
+    };
+    SQPool();
+    ~SQPool();
+    void *Alloc(SQUnsignedInteger size)
+    {
+        if(size == 0 || size > SQ_POOL_MAXSIZE) return sq_vm_malloc(size);
+        SizeClass &c = _classes[(size - 1) / SQ_POOL_GRANULARITY];
+        c._nlive++;
+        FreeBlock *b = c._free;
+        if(b) {
+            c._free = b->_next;
+            return b;
+        }
+        return Grow(c);
+    }
+    void Free(void *p,SQUnsignedInteger size)
+    {
+        if(size == 0 || size > SQ_POOL_MAXSIZE) { sq_vm_free(p,size); return; }
+        SizeClass &c = _classes[(size - 1) / SQ_POOL_GRANULARITY];
+        c._nlive--;
+        FreeBlock *b = (FreeBlock *)p;
+        b->_next = c._free;
+        c._free = b;
+    }
+    void *Realloc(void *p,SQUnsignedInteger oldsize,SQUnsignedInteger size);
+    bool GetStats(SQInteger n,SQInteger &blocksize,SQInteger &livebytes,SQInteger &freebytes);
+private:
+    void *Grow(SizeClass &c);
+    SizeClass _classes[SQ_POOL_NCLASSES];
+    char *_bump;        //unused part of the last slab
+    char *_bumpend;
+    void *_slabs;
+};
+
+#define SQ_POOL_MALLOC(ss,size) (ss)->_pool.Alloc(size)
+#define SQ_POOL_FREE(ss,p,size) (ss)->_pool.Free((p),(size))
+#define SQ_POOL_REALLOC(ss,p,oldsize,size) (ss)->_pool.Realloc((p),(oldsize),(size))
+#define sq_pool_delete_size(__ptr,__type,__size) {SQSharedState *__ss=(__ptr)->_sharedstate;__ptr->~__type();SQ_POOL_FREE(__ss,__ptr,__size);}
+#else
+#define SQ_POOL_MALLOC(ss,size) sq_vm_malloc(size)
+#define SQ_POOL_FREE(ss,p,size) sq_vm_free((p),(size))
+#define SQ_POOL_REALLOC(ss,p,oldsize,size) sq_vm_realloc((p),(oldsize),(size))
+#define sq_pool_delete_size(__ptr,__type,__size) {__ptr->~__type();sq_vm_free(__ptr,__size);}
+#endif
+#define sq_pool_delete(__ptr,__type) sq_pool_delete_size(__ptr,__type,sizeof(__type))
+
 #define ADD_STRING(ss,str,len) ss->_stringtable->Add(str,len)
 #define REMOVE_STRING(ss,bstr) ss->_stringtable->Remove(bstr)
 
@@ -66,9 +155,21 @@ public:
     SQInteger GetMetaMethodIdxByName(const SQObjectPtr &name);
 #ifndef NO_GARBAGE_COLLECTOR
     SQInteger CollectGarbage(SQVM *vm);
-    void RunMark(SQVM *vm,SQCollectable **tchain);
+    SQInteger GCStep(SQInteger budget);
     SQInteger ResurrectUnreachable(SQVM *vm);
     static void MarkObject(SQObjectPtr &o,SQCollectable **chain);
+private:
+    void MarkRoots();
+    SQInteger Propagate(SQInteger budget);
+    void FinishMark();
+    SQInteger Sweep(SQInteger budget);
+    SQInteger Unmark(SQInteger budget);
+    void EndStep(SQInteger work);
+    void ResetGC();
+public:
+#endif
+#ifdef SQ_USE_POOL
+    SQPool _pool; //first member, destroyed after every other one
 #endif
     SQObjectPtrVec *_metamethods;
     SQObjectPtr _metamethodsmap;
@@ -80,7 +181,15 @@ public:
     SQObjectPtr _consts;
     SQObjectPtr _constructoridx;
 #ifndef NO_GARBAGE_COLLECTOR
-    SQCollectable *_gc_chain;
+    SQCollectable *_gc_chain;       //unmarked objects
+    SQCollectable *_gc_gray;        //marked objects whose children aren't marked yet
+    SQCollectable *_gc_grayagain;   //marked objects whose children are marked again by FinishMark()
+    SQCollectable *_gc_black;       //marked objects whose children are marked
+    SQCollectable *_gc_sweep;       //next unreachable object freed by Sweep()
+    SQObjectPtrVec _gc_weakrefs;    //weak references to objects that weren't marked when they were met
+    SQGCState _gc_state;
+    SQInteger _gc_freed;            //objects freed by the current cycle
+    SQGCStats _gc_stats;
 #endif
     SQObjectPtr _root_vm;
     SQObjectPtr _table_default_delegate;
@@ -109,8 +218,14 @@ public:
     SQPRINTFUNCTION _errorfunc;
     bool _debuginfo;
     bool _notifyallexceptions;
+    bool _jitenabled;
+    SQUnsignedInteger _nextclassserial;
     SQUserPointer _foreignptr;
     SQRELEASEHOOK _releasehook;
+    SQInteger _stringhash;
+    SQUnsignedInteger _hashseed;
+    SQInteger _internlimit;
+    SQHash HashStr(const SQChar *s,SQInteger len);
 private:
     SQChar *_scratchpad;
     SQInteger _scratchpadsize;
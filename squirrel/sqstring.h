@@ -2,6 +2,9 @@
 #ifndef _SQSTRING_H_
 #define _SQSTRING_H_
 
+SQHash _hashstr_full(const SQChar *s, size_t l, SQUnsignedInteger seed);
+
+//the hash of SQ_STRINGHASH_SAMPLED
 inline SQHash _hashstr (const SQChar *s, size_t l)
 {
         SQHash h = (SQHash)l;  /* seed */
@@ -19,6 +22,20 @@ public:
     static SQString *Create(SQSharedState *ss, const SQChar *, SQInteger len = -1 );
     SQInteger Next(const SQObjectPtr &refpos, SQObjectPtr &outkey, SQObjectPtr &outval);
     void Release();
+    //strings of at least SQSharedState::_internlimit characters aren't added to the string table, their
+    //_next points to the string itself and the hash is computed the first time they are used as a key
+    //(SQSharedState::HashStr() never returns 0, so 0 means not computed yet)
+    bool IsInterned() const { return _next != this; }
+    SQHash Hash() { return _hash ? _hash : LazyHash(); }
+    SQHash LazyHash();
+    //interned strings are only equal to themselves, an uninterned one to any string with the same characters
+    static bool Equal(SQString *a,SQString *b)
+    {
+        if(a == b) return true;
+        if(a->IsInterned() && b->IsInterned()) return false;
+        if(a->_len != b->_len || (a->_hash && b->_hash && a->_hash != b->_hash)) return false;
+        return memcmp(a->_val,b->_val,sq_rsl(a->_len)) == 0;
+    }
     SQSharedState *_sharedstate;
     SQString *_next; //chain for the string table
     SQInteger _len;
@@ -10,201 +10,431 @@ see copyright notice in squirrel.h
 SQTable::SQTable(SQSharedState *ss,SQInteger nInitialSize)
 {
     SQInteger pow2size=MINPOWER2;
-    while(nInitialSize>pow2size)pow2size=pow2size<<1;
+    while(nInitialSize>_TABLE_MAXLOAD(pow2size))pow2size=pow2size<<1;
+    INIT_CHAIN(); //AllocNodes() allocates from the pool of _sharedstate
+    _array = NULL;
+    _arraysize = 0;
+    _arrayused = 0;
+    _indexkeys = NULL;
+    _old = NULL;
     AllocNodes(pow2size);
     _usednodes = 0;
     _delegate = NULL;
-    INIT_CHAIN();
     ADD_TO_CHAIN(&_sharedstate->_gc_chain,this);
 }
 
 void SQTable::Remove(const SQObjectPtr &key)
 {
-
-    _HashNode *n = _Get(key, HashObj(key) & (_numofnodes - 1));
+    if(_InArray(key)) {
+        SQObjectPtr &o = _array[_integer(key)];
+        if(sq_type(o) != _TABLE_ABSENT) {
+            o.Null();
+            o._type = _TABLE_ABSENT;
+            _arrayused--;
+        }
+        return;
+    }
+    _HashNode *n = _Get(key, HashObj(key));
     if (n) {
-        n->val.Null();
-        n->key.Null();
+        CountIndexKey(n->key,-1);
+        //released once the slot is free
+        SQObjectPtr oldkey, oldval;
+        _Swap(oldkey,n->key);
+        _Swap(oldval,n->val);
+        if(_old && n >= _old->nodes && n < _old->nodes + _old->numofnodes) {
+            //the room kept for the node in the new nodes is free again
+            _old->ctrl[n - _old->nodes] = SQ_CTRL_DELETED;
+            _growthleft++;
+        }
+        else {
+            SQInteger idx = n - _nodes;
+            //a group with an empty slot never made a probe move on to the next group
+            if(SQTableGroup(_ctrl + (idx & ~(SQ_GROUP_SIZE - 1))).MatchEmpty()) {
+                _ctrl[idx] = SQ_CTRL_EMPTY;
+                _growthleft++;
+            }
+            else {
+                _ctrl[idx] = SQ_CTRL_DELETED;
+            }
+        }
         _usednodes--;
-        Rehash(false);
+        if(_old) MoveOld(SQ_TABLE_MIGRATESTEP);
+        else if(_usednodes <= _numofnodes/4) Rehash(false);
     }
 }
 
 void SQTable::AllocNodes(SQInteger nSize)
 {
-    _HashNode *nodes=(_HashNode *)SQ_MALLOC(sizeof(_HashNode)*nSize);
-    for(SQInteger i=0;i<nSize;i++){
-        _HashNode &n = nodes[i];
-        new (&n) _HashNode;
-        n.next=NULL;
-    }
+    signed char *ctrl=(signed char *)SQ_POOL_MALLOC(_sharedstate,_TABLE_BLOCKSIZE(nSize));
+    _HashNode *nodes=(_HashNode *)(ctrl + _TABLE_CTRLSIZE(nSize));
+    memset(ctrl,SQ_CTRL_EMPTY,nSize);
+    memset(ctrl+nSize,SQ_CTRL_PAD,_TABLE_CTRLSIZE(nSize)-nSize);
     _numofnodes=nSize;
+    _ctrl=ctrl;
     _nodes=nodes;
-    _firstfree=&_nodes[_numofnodes-1];
+    _growthleft=_TABLE_MAXLOAD(nSize);
+}
+
+void SQTable::FreeNodes(signed char *ctrl,SQInteger nSize)
+{
+    _HashNode *nodes=(_HashNode *)(ctrl + _TABLE_CTRLSIZE(nSize));
+    for(SQInteger i=0;i<nSize;i++) {
+        if(ctrl[i] >= 0) nodes[i].~_HashNode();
+    }
+    SQ_POOL_FREE(_sharedstate,ctrl,_TABLE_BLOCKSIZE(nSize));
+}
+
+//first empty or deleted slot of the probe sequence
+SQInteger SQTable::FindFree(SQHash start)
+{
+    SQUnsignedInteger gmask = (SQUnsignedInteger)(_numofnodes - 1) / SQ_GROUP_SIZE;
+    SQUnsignedInteger g = (SQUnsignedInteger)start & gmask;
+    for(SQUnsignedInteger step = 1; ; step++) {
+        unsigned bits = SQTableGroup(_ctrl + g * SQ_GROUP_SIZE).MatchFree();
+        if(bits) return g * SQ_GROUP_SIZE + sq_lowestbit(bits);
+        g = (g + step) & gmask;
+    }
+}
+
+//the slots past 'oldsize' are absent
+SQObjectPtr *SQTable::ReallocArray(SQObjectPtr *arr,SQInteger oldsize,SQInteger nSize)
+{
+    if(!nSize) return NULL;
+    arr=(SQObjectPtr *)SQ_POOL_REALLOC(_sharedstate,arr,oldsize*sizeof(SQObjectPtr),nSize*sizeof(SQObjectPtr));
+    for(SQInteger i=oldsize;i<nSize;i++){
+        new (&arr[i]) SQObjectPtr;
+        arr[i]._type = _TABLE_ABSENT;
+    }
+    return arr;
+}
+
+void SQTable::FreeArray(SQObjectPtr *arr,SQInteger nSize)
+{
+    if(!arr) return;
+    for(SQInteger i=0;i<nSize;i++)
+        arr[i].~SQObjectPtr();
+    SQ_POOL_FREE(_sharedstate,arr,nSize*sizeof(SQObjectPtr));
+}
+
+//moves the keys to an array part of 'nasize' slots and a hash part of 'nhsize' nodes
+void SQTable::Resize(SQInteger nasize,SQInteger nhsize)
+{
+    if(_old) MoveOld(_old->numofnodes);
+    SQInteger oldasize=_arraysize;
+    SQInteger oldhsize=_numofnodes;
+    SQObjectPtr *aold=NULL;
+    signed char *cold=_ctrl;
+    _HashNode *nold=_nodes;
+    if(nasize > oldasize) {
+        //a growing array keeps its keys
+        _array=ReallocArray(_array,oldasize,nasize);
+        _arraysize=nasize;
+    }
+    else if(nasize < oldasize) {
+        aold=_array;
+        _array=ReallocArray(NULL,0,nasize);
+        _arraysize=nasize;
+        _arrayused=0;
+    }
+    AllocNodes(nhsize);
+    _usednodes=0;
+    if(_indexkeys) memset(_indexkeys,0,_TABLE_NBUCKETS*sizeof(SQInteger));
+    //the moved keys and values are swapped with the empty slots of the new parts
+    if(aold) {
+        for(SQInteger i=0; i<oldasize; i++) {
+            if(sq_type(aold[i]) != _TABLE_ABSENT) {
+                SQObjectPtr key(i);
+                _Move(key,aold[i]);
+            }
+        }
+    }
+    for(SQInteger i=0; i<oldhsize; i++) {
+        if(cold[i] >= 0)
+            _Move(nold[i].key,nold[i].val);
+    }
+    FreeNodes(cold,oldhsize);
+    if(aold) FreeArray(aold,oldasize);
+}
+
+//resizes the hash part alone, the nodes of a large one are moved by MoveOld()
+void SQTable::ResizeNodes(SQInteger nhsize)
+{
+    if(_old) MoveOld(_old->numofnodes);
+    if(_numofnodes < SQ_TABLE_MIGRATESIZE) {
+        Resize(_arraysize,nhsize);
+        return;
+    }
+    _old = (_OldNodes *)SQ_POOL_MALLOC(_sharedstate,sizeof(_OldNodes));
+    _old->ctrl = _ctrl;
+    _old->nodes = _nodes;
+    _old->numofnodes = _numofnodes;
+    _old->moved = 0;
+    AllocNodes(nhsize);
+    _growthleft -= _usednodes;
+}
+
+//moves the next 'n' old nodes
+void SQTable::MoveOld(SQInteger n)
+{
+    _OldNodes *o = _old;
+    for(; n && o->moved < o->numofnodes; n--, o->moved++) {
+        SQInteger i = o->moved;
+        if(o->ctrl[i] < 0) continue;
+        _HashNode &old = o->nodes[i];
+        SQHash h = HashObj(old.key);
+        SQHash m = MixHash(h);
+        SQInteger idx = FindFree(_TABLE_PROBESTART(sq_type(old.key),h,m));
+        //a tombstone doesn't need the room kept for the node
+        if(_ctrl[idx] != SQ_CTRL_EMPTY) _growthleft++;
+        _ctrl[idx] = SQ_CTRL_H2(m);
+        new (&_nodes[idx]) _HashNode;
+        _Swap(_nodes[idx].key,old.key);
+        _Swap(_nodes[idx].val,old.val);
+        o->ctrl[i] = SQ_CTRL_DELETED;
+    }
+    if(o->moved == o->numofnodes) FreeOld();
+}
+
+void SQTable::FreeOld()
+{
+    if(!_old) return;
+    FreeNodes(_old->ctrl,_old->numofnodes);
+    SQ_POOL_FREE(_sharedstate,_old,sizeof(_OldNodes));
+    _old = NULL;
+}
+
+//inserts a key that isn't in the table and has room for it
+void SQTable::_Move(SQObjectPtr &key,SQObjectPtr &val)
+{
+    if(_InArray(key)) {
+        _Swap(_array[_integer(key)],val);
+        _arrayused++;
+        return;
+    }
+    SQHash h = HashObj(key);
+    SQHash m = MixHash(h);
+    SQInteger idx = FindFree(_TABLE_PROBESTART(sq_type(key),h,m));
+    _ctrl[idx] = SQ_CTRL_H2(m);
+    CountIndexKey(key,1);
+    new (&_nodes[idx]) _HashNode;
+    _Swap(_nodes[idx].key,key);
+    _Swap(_nodes[idx].val,val);
+    _usednodes++;
+    _growthleft--;
+}
+
+//k is in [2^(b-1), 2^b)
+static SQInteger _keybucket(SQUnsignedInteger k)
+{
+#if defined(__GNUC__)
+    return k ? (SQInteger)(sizeof(long long) * 8) - __builtin_clzll((unsigned long long)k) : 0;
+#else
+    SQInteger b = 0;
+    while(k) { k >>= 1; b++; }
+    return b;
+#endif
+}
+
+void SQTable::CountIndexKey(const SQObjectPtr &key,SQInteger d)
+{
+    if(_indexkeys && _TABLE_ISINDEX(key)) _indexkeys[_keybucket(_integer(key))] += d;
+}
+
+//the hash part is full: sizes both parts for the keys of the table and 'newkey'
+void SQTable::Grow(const SQObjectPtr &newkey)
+{
+    if(_old) MoveOld(_old->numofnodes);
+    SQInteger total = CountUsed() + 1;
+    SQInteger nasize = _arraysize, inarray = _arrayused;
+    SQInteger nums[_TABLE_NBUCKETS];
+    if(_indexkeys) memcpy(nums,_indexkeys,sizeof(nums));
+    else {
+        memset(nums,0,sizeof(nums));
+        for(SQInteger i=0; i<_numofnodes; i++) {
+            if(_ctrl[i] >= 0 && _TABLE_ISINDEX(_nodes[i].key))
+                nums[_keybucket(_integer(_nodes[i].key))]++;
+        }
+        //a large hash part keeps the count up to date instead of being scanned on every resize
+        if(_numofnodes >= SQ_TABLE_MIGRATESIZE) {
+            _indexkeys = (SQInteger *)SQ_POOL_MALLOC(_sharedstate,sizeof(nums));
+            memcpy(_indexkeys,nums,sizeof(nums));
+        }
+    }
+    SQInteger hashindexkeys = 0;
+    for(SQInteger i=0; i<(SQInteger)_TABLE_NBUCKETS; i++) hashindexkeys += nums[i];
+    //without a key that could go to the array part there is nothing to count
+    if(hashindexkeys || _TABLE_ISINDEX(newkey)) {
+        //the array part is counted a bucket at a time. while the hash part is smaller than the array
+        //part the array keeps at least its size and isn't scanned again every time the hash part
+        //doubles, a sparse array is shrunk once the hash part has outgrown it
+        bool keeparray = _numofnodes < _arraysize;
+        if(keeparray) nums[_keybucket(_arraysize-1)] += _arrayused;
+        else for(SQInteger b=0, i=0; i<_arraysize; b++) {
+            SQInteger end = (SQInteger)1 << b;
+            if(end > _arraysize) end = _arraysize;
+            for(; i<end; i++) {
+                if(sq_type(_array[i]) != _TABLE_ABSENT) nums[b]++;
+            }
+        }
+        if(_TABLE_ISINDEX(newkey))
+            nums[_keybucket(_integer(newkey))]++;
+        //the array is the largest power of 2 more than half used
+        SQInteger a = 0;
+        nasize = 0;
+        inarray = 0;
+        for(SQInteger i = 0, twotoi = 1; i < (SQInteger)(sizeof(nums)/sizeof(nums[0])) && twotoi/2 < total; i++, twotoi <<= 1) {
+            a += nums[i];
+            if(a > twotoi/2) {
+                nasize = twotoi;
+                inarray = a;
+            }
+        }
+        if(keeparray && nasize < _arraysize) {
+            nasize = _arraysize;
+            inarray = _arrayused;
+        }
+    }
+    SQInteger nhash = total - inarray;
+    SQInteger nhsize = MINPOWER2;
+    while(nhash >= nhsize-nhsize/4) nhsize <<= 1;
+    if(nasize == _arraysize) ResizeNodes(nhsize);
+    else Resize(nasize,nhsize);
 }
 
 void SQTable::Rehash(bool force)
 {
     SQInteger oldsize=_numofnodes;
-    //prevent problems with the integer division
-    if(oldsize<4)oldsize=4;
-    _HashNode *nold=_nodes;
-    SQInteger nelems=CountUsed();
+    SQInteger nelems=_usednodes;
+    SQInteger newsize;
     if (nelems >= oldsize-oldsize/4)  /* using more than 3/4? */
-        AllocNodes(oldsize*2);
+        newsize = oldsize*2;
     else if (nelems <= oldsize/4 &&  /* less than 1/4? */
         oldsize > MINPOWER2)
-        AllocNodes(oldsize/2);
+        newsize = oldsize/2;
     else if(force)
-        AllocNodes(oldsize);
+        newsize = oldsize; /* drops the tombstones */
     else
         return;
-    _usednodes = 0;
-    for (SQInteger i=0; i<oldsize; i++) {
-        _HashNode *old = nold+i;
-        if (sq_type(old->key) != OT_NULL)
-            NewSlot(old->key,old->val);
-    }
-    for(SQInteger k=0;k<oldsize;k++)
-        nold[k].~_HashNode();
-    SQ_FREE(nold,oldsize*sizeof(_HashNode));
+    //an array part without keys is dropped
+    if(_arraysize && !_arrayused) Resize(0,newsize);
+    else ResizeNodes(newsize);
 }
 
 SQTable *SQTable::Clone()
 {
-    SQTable *nt=Create(_opt_ss(this),_numofnodes);
-#ifdef _FAST_CLONE
-    _HashNode *basesrc = _nodes;
-    _HashNode *basedst = nt->_nodes;
-    _HashNode *src = _nodes;
-    _HashNode *dst = nt->_nodes;
-    SQInteger n = 0;
-    for(n = 0; n < _numofnodes; n++) {
-        dst->key = src->key;
-        dst->val = src->val;
-        if(src->next) {
-            assert(src->next > basesrc);
-            dst->next = basedst + (src->next - basesrc);
-            assert(dst != dst->next);
+    if(_old) MoveOld(_old->numofnodes);
+    SQTable *nt=Create(_opt_ss(this),_TABLE_MAXLOAD(_numofnodes));
+    assert(nt->_numofnodes == _numofnodes);
+    //the same hashes land in the same slots
+    memcpy(nt->_ctrl,_ctrl,_TABLE_CTRLSIZE(_numofnodes));
+    for(SQInteger i = 0; i < _numofnodes; i++) {
+        if(_ctrl[i] >= 0) {
+            new (&nt->_nodes[i].key) SQObjectPtr(_nodes[i].key);
+            new (&nt->_nodes[i].val) SQObjectPtr(_nodes[i].val);
         }
-        dst++;
-        src++;
     }
-    assert(_firstfree > basesrc);
-    assert(_firstfree != NULL);
-    nt->_firstfree = basedst + (_firstfree - basesrc);
     nt->_usednodes = _usednodes;
-#else
-    SQInteger ridx=0;
-    SQObjectPtr key,val;
-    while((ridx=Next(true,ridx,key,val))!=-1){
-        nt->NewSlot(key,val);
+    nt->_growthleft = _growthleft;
+    if(_arraysize) {
+        nt->_array = nt->ReallocArray(NULL,0,_arraysize);
+        nt->_arraysize = _arraysize;
+        for(SQInteger i = 0; i < _arraysize; i++) {
+            if(sq_type(_array[i]) != _TABLE_ABSENT) nt->_array[i] = _array[i];
+        }
+        nt->_arrayused = _arrayused;
     }
-#endif
     nt->SetDelegate(_delegate);
     return nt;
 }
 
-bool SQTable::Get(const SQObjectPtr &key,SQObjectPtr &val)
-{
-    if(sq_type(key) == OT_NULL)
-        return false;
-    _HashNode *n = _Get(key, HashObj(key) & (_numofnodes - 1));
-    if (n) {
-        val = _realval(n->val);
-        return true;
-    }
-    return false;
-}
 bool SQTable::NewSlot(const SQObjectPtr &key,const SQObjectPtr &val)
 {
     assert(sq_type(key) != OT_NULL);
-    SQHash h = HashObj(key) & (_numofnodes - 1);
+    GC_BARRIER(this);
+    if(_InArray(key)) {
+        SQObjectPtr &o = _array[_integer(key)];
+        bool added = sq_type(o) == _TABLE_ABSENT;
+        o = val;
+        if(added) _arrayused++;
+        return added;
+    }
+    SQHash h = HashObj(key);
     _HashNode *n = _Get(key, h);
     if (n) {
         n->val = val;
         return false;
     }
-    _HashNode *mp = &_nodes[h];
-    n = mp;
-
-
     //key not found I'll insert it
-    //main pos is not free
-
-    if(sq_type(mp->key) != OT_NULL) {
-        n = _firstfree;  /* get a free place */
-        SQHash mph = HashObj(mp->key) & (_numofnodes - 1);
-        _HashNode *othern;  /* main position of colliding node */
-
-        if (mp > n && (othern = &_nodes[mph]) != mp){
-            /* yes; move colliding node into free position */
-            while (othern->next != mp){
-                assert(othern->next != NULL);
-                othern = othern->next;  /* find previous */
-            }
-            othern->next = n;  /* redo the chain with `n' in place of `mp' */
-            n->key = mp->key;
-            n->val = mp->val;/* copy colliding node into free pos. (mp->next also goes) */
-            n->next = mp->next;
-            mp->key.Null();
-            mp->val.Null();
-            mp->next = NULL;  /* now `mp' is free */
-        }
-        else{
-            /* new node will go into free position */
-            n->next = mp->next;  /* chain new position */
-            mp->next = n;
-            mp = n;
+    if(_old) MoveOld(SQ_TABLE_MIGRATESTEP);
+    SQHash m = MixHash(h);
+    SQInteger idx = FindFree(_TABLE_PROBESTART(sq_type(key),h,m));
+    if(_ctrl[idx] == SQ_CTRL_EMPTY) {
+        if(!_growthleft) {
+            Grow(key);
+            return NewSlot(key, val);
         }
+        _growthleft--;
     }
-    mp->key = key;
-
-    for (;;) {  /* correct `firstfree' */
-        if (sq_type(_firstfree->key) == OT_NULL && _firstfree->next == NULL) {
-            mp->val = val;
-            _usednodes++;
-            return true;  /* OK; table still has a free place */
-        }
-        else if (_firstfree == _nodes) break;  /* cannot decrement from here */
-        else (_firstfree)--;
-    }
-    Rehash(true);
-    return NewSlot(key, val);
+    _ctrl[idx] = SQ_CTRL_H2(m);
+    CountIndexKey(key,1);
+    n = &_nodes[idx];
+    new (&n->key) SQObjectPtr(key);
+    new (&n->val) SQObjectPtr(val);
+    _usednodes++;
+    return true;
 }
 
 SQInteger SQTable::Next(bool getweakrefs,const SQObjectPtr &refpos, SQObjectPtr &outkey, SQObjectPtr &outval)
 {
+    //the array part comes first, then the nodes
     SQInteger idx = (SQInteger)TranslateIndex(refpos);
-    while (idx < _numofnodes) {
-        if(sq_type(_nodes[idx].key) != OT_NULL) {
+    for (; idx < _arraysize; idx++) {
+        SQObjectPtr &o = _array[idx];
+        if(sq_type(o) != _TABLE_ABSENT) {
+            outkey = idx;
+            outval = getweakrefs?(SQObject)o:_realval(o);
+            return ++idx;
+        }
+    }
+    SQInteger i = idx - _arraysize;
+    for (; i < _numofnodes; i++) {
+        if(_ctrl[i] >= 0) {
             //first found
-            _HashNode &n = _nodes[idx];
+            _HashNode &n = _nodes[i];
             outkey = n.key;
             outval = getweakrefs?(SQObject)n.val:_realval(n.val);
             //return idx for the next iteration
-            return ++idx;
+            return _arraysize + i + 1;
+        }
+    }
+    //then the nodes that haven't been moved yet
+    if(_old) {
+        for (i -= _numofnodes; i < _old->numofnodes; i++) {
+            if(_old->ctrl[i] >= 0) {
+                _HashNode &n = _old->nodes[i];
+                outkey = n.key;
+                outval = getweakrefs?(SQObject)n.val:_realval(n.val);
+                return _arraysize + _numofnodes + i + 1;
+            }
         }
-        ++idx;
     }
     //nothing to iterate anymore
     return -1;
 }
 
 
-bool SQTable::Set(const SQObjectPtr &key, const SQObjectPtr &val)
-{
-    _HashNode *n = _Get(key, HashObj(key) & (_numofnodes - 1));
-    if (n) {
-        n->val = val;
-        return true;
-    }
-    return false;
-}
-
 void SQTable::_ClearNodes()
 {
-    for(SQInteger i = 0;i < _numofnodes; i++) { _HashNode &n = _nodes[i]; n.key.Null(); n.val.Null(); }
+    FreeOld();
+    for(SQInteger i = 0;i < _numofnodes; i++) {
+        if(_ctrl[i] >= 0) { _HashNode &n = _nodes[i]; n.key.Null(); n.val.Null(); }
+    }
+    memset(_ctrl,SQ_CTRL_EMPTY,_numofnodes);
+    _usednodes = 0;
+    _growthleft = _TABLE_MAXLOAD(_numofnodes);
+    if(_indexkeys) memset(_indexkeys,0,_TABLE_NBUCKETS*sizeof(SQInteger));
+    for(SQInteger i = 0;i < _arraysize; i++) { _array[i].Null(); _array[i]._type = _TABLE_ABSENT; }
+    _arrayused = 0;
 }
 
 void SQTable::Finalize()
@@ -216,6 +446,5 @@ void SQTable::Finalize()
 void SQTable::Clear()
 {
     _ClearNodes();
-    _usednodes = 0;
     Rehash(true);
 }
@@ -2,50 +2,160 @@
 #ifndef _SQTABLE_H_
 #define _SQTABLE_H_
 /*
-* The following code is based on Lua 4.0 (Copyright 1994-2002 Tecgraf, PUC-Rio.)
-* http://www.lua.org/copyright.html#4
-* http://www.lua.org/source/4.0.1/src_ltable.c.html
+* open addressing hash table. a control byte per slot holds 7 bits of the hash of the
+* key (or marks the slot as empty or deleted); lookups compare the control bytes of a
+* group of 16 slots at once (with SSE2 when available) and only look at the keys whose
+* control byte matches. groups are probed in triangular sequence, so every group is
+* visited before one repeats. removed keys leave a tombstone (SQ_CTRL_DELETED) unless
+* their group still has an empty slot, tombstones are dropped when the table is rehashed.
+*
+* the values of the integer keys 0.._arraysize-1 are kept apart in an array, without
+* hashing. when the hash part is full the array is resized, like in Lua, to the largest
+* power of 2 that would be more than half used, and the keys are moved between the two parts.
+*
+* a hash part of SQ_TABLE_MIGRATESIZE nodes or more is resized incrementally: the old nodes stay
+* allocated and every insertion or removal moves the next SQ_TABLE_MIGRATESTEP of them to the new
+* nodes, lookups look in both. room for the nodes still to move is kept aside in _growthleft, so
+* the new nodes never fill up before the old ones are gone. the nodes of a slot that isn't in use
+* are raw memory (or null objects), so allocating nodes doesn't touch them
 */
 
 #include "sqstring.h"
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SQ_TABLE_SSE2
+#endif
 
 #define hashptr(p)  ((SQHash)(((SQInteger)p) >> 3))
 
 inline SQHash HashObj(const SQObjectPtr &key)
 {
     switch(sq_type(key)) {
-        case OT_STRING:     return _string(key)->_hash;
+        case OT_STRING:     return _string(key)->Hash();
         case OT_FLOAT:      return (SQHash)((SQInteger)_float(key));
         case OT_BOOL: case OT_INTEGER:  return (SQHash)((SQInteger)_integer(key));
         default:            return hashptr(key._unVal.pRefCounted);
     }
 }
 
+//integers hash to themselves, the bits are spread so the 7 bits of the control byte differ between keys of a group
+inline SQHash MixHash(SQHash h)
+{
+#ifdef _SQ64
+    h *= (SQHash)0x9E3779B97F4A7C15ULL;
+#else
+    h *= (SQHash)0x9E3779B9U;
+#endif
+    return h ^ (h >> (sizeof(SQHash) * 4));
+}
+
+//group a probe starts at. integer keys use the plain hash so runs of keys land in consecutive
+//groups and stay close in memory (and a group never fills up with them), other keys the mixed one
+#define _TABLE_PROBESTART(type,h,m) ((type) == OT_INTEGER ? (h) : (m) >> 7)
+
+#define SQ_GROUP_SIZE 16
+#define SQ_CTRL_EMPTY ((signed char)-128)
+#define SQ_CTRL_DELETED ((signed char)-2)
+#define SQ_CTRL_PAD ((signed char)-1)     //past the end of a table smaller than a group, never matches
+#define SQ_CTRL_H2(h) ((signed char)((h) & 0x7F))
+
+//the control bytes of a group, every method returns a bit mask with a bit per slot
+struct SQTableGroup
+{
+#ifdef SQ_TABLE_SSE2
+    SQTableGroup(const signed char *ctrl) { _ctrl = _mm_loadu_si128((const __m128i *)ctrl); }
+    unsigned Match(signed char c) const { return (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_ctrl, _mm_set1_epi8(c))); }
+    //empty or deleted slots
+    unsigned MatchFree() const { return (unsigned)_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(SQ_CTRL_PAD), _ctrl)); }
+    __m128i _ctrl;
+#else
+    SQTableGroup(const signed char *ctrl) { _ctrl = ctrl; }
+    unsigned Match(signed char c) const {
+        unsigned m = 0;
+        for(SQInteger i = 0; i < SQ_GROUP_SIZE; i++) if(_ctrl[i] == c) m |= 1u << i;
+        return m;
+    }
+    unsigned MatchFree() const {
+        unsigned m = 0;
+        for(SQInteger i = 0; i < SQ_GROUP_SIZE; i++) if(_ctrl[i] < SQ_CTRL_PAD) m |= 1u << i;
+        return m;
+    }
+    const signed char *_ctrl;
+#endif
+    unsigned MatchEmpty() const { return Match(SQ_CTRL_EMPTY); }
+};
+
+inline SQInteger sq_lowestbit(unsigned m)
+{
+#if defined(__GNUC__)
+    return __builtin_ctz(m);
+#else
+    SQInteger n = 0;
+    while(!(m & 1)) { m >>= 1; n++; }
+    return n;
+#endif
+}
+
+//slots a table can fill, including tombstones, before it is rehashed. there is always an empty slot left
+#define _TABLE_MAXLOAD(n) ((n) <= SQ_GROUP_SIZE ? (n) - 1 : (n) - (n) / 8)
+#define _TABLE_CTRLSIZE(n) ((n) < SQ_GROUP_SIZE ? SQ_GROUP_SIZE : (n))
+#define _TABLE_BLOCKSIZE(n) (_TABLE_CTRLSIZE(n) + (n) * sizeof(_HashNode))
+#define _TABLE_ABSENT ((SQObjectType)0) //type of an array slot whose key isn't in the table
+#define _TABLE_ISINDEX(key) (sq_type(key) == OT_INTEGER && _integer(key) >= 0) //could be in the array part
+
+#define _TABLE_NBUCKETS (sizeof(SQInteger)*8+1) //of integer keys, see _keybucket() in sqtable.cpp
+
+#define SQ_TABLE_MIGRATESIZE 1024
+#define SQ_TABLE_MIGRATESTEP 32
+
 struct SQTable : public SQDelegable
 {
 private:
     struct _HashNode
     {
-        _HashNode() { next = NULL; }
         SQObjectPtr val;
         SQObjectPtr key;
-        _HashNode *next;
     };
-    _HashNode *_firstfree;
+    //nodes of a hash part being moved to the new one after a resize
+    struct _OldNodes
+    {
+        signed char *ctrl;
+        _HashNode *nodes;
+        SQInteger numofnodes;
+        SQInteger moved;
+    };
+    signed char *_ctrl; //control bytes followed by the nodes, in one block
     _HashNode *_nodes;
     SQInteger _numofnodes;
-    SQInteger _usednodes;
+    SQInteger _usednodes; //including the old nodes
+    SQInteger _growthleft;
+    SQInteger *_indexkeys; //keys of a large hash part that could be in the array part, by bucket
+    _OldNodes *_old;
+    SQObjectPtr *_array;
+    SQInteger _arraysize;
+    SQInteger _arrayused;
 
 ///////////////////////////
     void AllocNodes(SQInteger nSize);
+    void FreeNodes(signed char *ctrl,SQInteger nSize);
+    SQObjectPtr *ReallocArray(SQObjectPtr *arr,SQInteger oldsize,SQInteger nSize);
+    void FreeArray(SQObjectPtr *arr,SQInteger nSize);
+    void Resize(SQInteger nasize,SQInteger nhsize);
+    void ResizeNodes(SQInteger nhsize);
+    void MoveOld(SQInteger n);
+    void CountIndexKey(const SQObjectPtr &key,SQInteger d);
+    void Grow(const SQObjectPtr &newkey);
+    void _Move(SQObjectPtr &key,SQObjectPtr &val);
     void Rehash(bool force);
+    SQInteger FindFree(SQHash start);
     SQTable(SQSharedState *ss, SQInteger nInitialSize);
+    void FreeOld();
     void _ClearNodes();
 public:
     static SQTable* Create(SQSharedState *ss,SQInteger nInitialSize)
     {
-        SQTable *newtable = (SQTable*)SQ_MALLOC(sizeof(SQTable));
+        SQTable *newtable = (SQTable*)SQ_POOL_MALLOC(ss,sizeof(SQTable));
         new (newtable) SQTable(ss, nInitialSize);
         newtable->_delegate = NULL;
         return newtable;
@@ -56,53 +166,119 @@ public:
     {
         SetDelegate(NULL);
         REMOVE_FROM_CHAIN(&_sharedstate->_gc_chain, this);
-        for (SQInteger i = 0; i < _numofnodes; i++) _nodes[i].~_HashNode();
-        SQ_FREE(_nodes, _numofnodes * sizeof(_HashNode));
+        FreeNodes(_ctrl, _numofnodes);
+        FreeOld();
+        FreeArray(_array, _arraysize);
+        if(_indexkeys) SQ_POOL_FREE(_sharedstate,_indexkeys,_TABLE_NBUCKETS*sizeof(SQInteger));
     }
 #ifndef NO_GARBAGE_COLLECTOR
-    void Mark(SQCollectable **chain);
+    void MarkChildren(SQCollectable **chain);
     SQObjectType GetType() {return OT_TABLE;}
 #endif
-    inline _HashNode *_Get(const SQObjectPtr &key,SQHash hash)
+    inline bool _InArray(const SQObjectPtr &key)
+    {
+        return sq_type(key) == OT_INTEGER && (SQUnsignedInteger)_integer(key) < (SQUnsignedInteger)_arraysize;
+    }
+    static inline _HashNode *_Probe(const signed char *ctrl,_HashNode *nodes,SQInteger numofnodes,const SQObjectPtr &key,SQHash hash)
     {
-        _HashNode *n = &_nodes[hash];
-        do{
-            if(_rawval(n->key) == _rawval(key) && sq_type(n->key) == sq_type(key)){
-                return n;
+        SQHash m = MixHash(hash);
+        signed char h2 = SQ_CTRL_H2(m);
+        SQUnsignedInteger gmask = (SQUnsignedInteger)(numofnodes - 1) / SQ_GROUP_SIZE;
+        SQUnsignedInteger g = (SQUnsignedInteger)_TABLE_PROBESTART(sq_type(key),hash,m) & gmask;
+        for(SQUnsignedInteger step = 1; ; step++) {
+            SQTableGroup group(ctrl + g * SQ_GROUP_SIZE);
+            for(unsigned bits = group.Match(h2); bits; bits &= bits - 1) {
+                _HashNode *n = &nodes[g * SQ_GROUP_SIZE + sq_lowestbit(bits)];
+                if(sq_type(n->key) == sq_type(key) && (_rawval(n->key) == _rawval(key)
+                    || (sq_type(key) == OT_STRING && SQString::Equal(_string(n->key),_string(key))))){
+                    return n;
+                }
             }
-        }while((n = n->next));
-        return NULL;
+            if(group.MatchEmpty()) return NULL;
+            g = (g + step) & gmask;
+        }
     }
-    //for compiler use
-    inline bool GetStr(const SQChar* key,SQInteger keylen,SQObjectPtr &val)
+    static inline _HashNode *_ProbeStr(const signed char *ctrl,_HashNode *nodes,SQInteger numofnodes,const SQChar* key,SQHash hash)
     {
-        SQHash hash = _hashstr(key,keylen);
-        _HashNode *n = &_nodes[hash & (_numofnodes - 1)];
-        _HashNode *res = NULL;
-        do{
-            if(sq_type(n->key) == OT_STRING && (scstrcmp(_stringval(n->key),key) == 0)){
-                res = n;
-                break;
+        SQHash m = MixHash(hash);
+        signed char h2 = SQ_CTRL_H2(m);
+        SQUnsignedInteger gmask = (SQUnsignedInteger)(numofnodes - 1) / SQ_GROUP_SIZE;
+        SQUnsignedInteger g = (SQUnsignedInteger)(m >> 7) & gmask;
+        for(SQUnsignedInteger step = 1; ; step++) {
+            SQTableGroup group(ctrl + g * SQ_GROUP_SIZE);
+            for(unsigned bits = group.Match(h2); bits; bits &= bits - 1) {
+                _HashNode *n = &nodes[g * SQ_GROUP_SIZE + sq_lowestbit(bits)];
+                if(sq_type(n->key) == OT_STRING && (scstrcmp(_stringval(n->key),key) == 0)){
+                    return n;
+                }
             }
-        }while((n = n->next));
-        if (res) {
-            val = _realval(res->val);
+            if(group.MatchEmpty()) return NULL;
+            g = (g + step) & gmask;
+        }
+    }
+    inline _HashNode *_Get(const SQObjectPtr &key,SQHash hash)
+    {
+        _HashNode *n = _Probe(_ctrl,_nodes,_numofnodes,key,hash);
+        if(!n && _old) n = _Probe(_old->ctrl,_old->nodes,_old->numofnodes,key,hash);
+        return n;
+    }
+    //for compiler use, 'hash' is the one of the shared state
+    inline bool GetStr(const SQChar* key,SQHash hash,SQObjectPtr &val)
+    {
+        _HashNode *n = _ProbeStr(_ctrl,_nodes,_numofnodes,key,hash);
+        if(!n && _old) n = _ProbeStr(_old->ctrl,_old->nodes,_old->numofnodes,key,hash);
+        if(n) {
+            val = _realval(n->val);
+            return true;
+        }
+        return false;
+    }
+    inline bool Get(const SQObjectPtr &key,SQObjectPtr &val)
+    {
+        if(_InArray(key)) {
+            SQObjectPtr &o = _array[_integer(key)];
+            if(sq_type(o) == _TABLE_ABSENT)
+                return false;
+            val = _realval(o);
+            return true;
+        }
+        if(sq_type(key) == OT_NULL)
+            return false;
+        _HashNode *n = _Get(key, HashObj(key));
+        if (n) {
+            val = _realval(n->val);
             return true;
         }
         return false;
     }
-    bool Get(const SQObjectPtr &key,SQObjectPtr &val);
     void Remove(const SQObjectPtr &key);
-    bool Set(const SQObjectPtr &key, const SQObjectPtr &val);
+    inline bool Set(const SQObjectPtr &key, const SQObjectPtr &val)
+    {
+        SQObjectPtr *o;
+        if(_InArray(key)) {
+            o = &_array[_integer(key)];
+            if(sq_type(*o) == _TABLE_ABSENT)
+                return false;
+        }
+        else {
+            _HashNode *n = _Get(key, HashObj(key));
+            if (!n)
+                return false;
+            o = &n->val;
+        }
+        GC_BARRIER(this);
+        *o = val;
+        return true;
+    }
     //returns true if a new slot has been created false if it was already present
     bool NewSlot(const SQObjectPtr &key,const SQObjectPtr &val);
     SQInteger Next(bool getweakrefs,const SQObjectPtr &refpos, SQObjectPtr &outkey, SQObjectPtr &outval);
 
-    SQInteger CountUsed(){ return _usednodes;}
+    SQInteger CountUsed(){ return _usednodes + _arrayused;}
     void Clear();
     void Release()
     {
-        sq_delete(this, SQTable);
+        sq_pool_delete(this, SQTable);
     }
 
 };
@@ -218,6 +218,19 @@ SOURCE=.\sqclass.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\sqjit.cpp
+
+!IF  "$(CFG)" == "squirrel - Win32 Release"
+
+!ELSEIF  "$(CFG)" == "squirrel - Win32 Debug"
+
+# ADD CPP /YX"stdafx.h"
+
+!ENDIF 
+
+# End Source File
+# Begin Source File
+
 SOURCE=.\sqvm.cpp
 
 !IF  "$(CFG)" == "squirrel - Win32 Release"
@@ -295,6 +308,10 @@ SOURCE=.\sqclass.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\sqjit.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\sqvm.h
 # End Source File
 # End Group
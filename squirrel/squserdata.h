@@ -12,22 +12,21 @@ struct SQUserData : SQDelegable
     }
     static SQUserData* Create(SQSharedState *ss, SQInteger size)
     {
-        SQUserData* ud = (SQUserData*)SQ_MALLOC(sq_aligning(sizeof(SQUserData))+size);
+        SQUserData* ud = (SQUserData*)SQ_POOL_MALLOC(ss,sq_aligning(sizeof(SQUserData))+size);
         new (ud) SQUserData(ss);
         ud->_size = size;
         ud->_typetag = 0;
         return ud;
     }
 #ifndef NO_GARBAGE_COLLECTOR
-    void Mark(SQCollectable **chain);
+    void MarkChildren(SQCollectable **chain);
     void Finalize(){SetDelegate(NULL);}
     SQObjectType GetType(){ return OT_USERDATA;}
 #endif
     void Release() {
         if (_hook) _hook((SQUserPointer)sq_aligning(this + 1),_size);
         SQInteger tsize = _size;
-        this->~SQUserData();
-        SQ_FREE(this, sq_aligning(sizeof(SQUserData)) + tsize);
+        sq_pool_delete_size(this, SQUserData, sq_aligning(sizeof(SQUserData)) + tsize);
     }
 
 
@@ -426,6 +426,7 @@ bool SQVM::StartCall(SQClosure *closure,SQInteger target,SQInteger args,SQIntege
     ci->_literals = func->_literals;
     ci->_ip       = func->_instructions;
     ci->_target   = (SQInt32)target;
+    ci->_cont     = NULL;
 
     if (_debughook) {
         CallDebugHook(_SC('c'));
@@ -498,13 +499,13 @@ bool SQVM::DerefInc(SQInteger op,SQObjectPtr &target, SQObjectPtr &self, SQObjec
     return true;
 }
 
-#define arg0 (_i_._arg0)
-#define sarg0 ((SQInteger)*((const signed char *)&_i_._arg0))
-#define arg1 (_i_._arg1)
-#define sarg1 (*((const SQInt32 *)&_i_._arg1))
-#define arg2 (_i_._arg2)
-#define arg3 (_i_._arg3)
-#define sarg3 ((SQInteger)*((const signed char *)&_i_._arg3))
+#define arg0 (_i_->_arg0)
+#define sarg0 ((SQInteger)*((const signed char *)&_i_->_arg0))
+#define arg1 (_i_->_arg1)
+#define sarg1 (*((const SQInt32 *)&_i_->_arg1))
+#define arg2 (_i_->_arg2)
+#define arg3 (_i_->_arg3)
+#define sarg3 ((SQInteger)*((const signed char *)&_i_->_arg3))
 
 SQRESULT SQVM::Suspend()
 {
@@ -583,6 +584,73 @@ bool SQVM::FOREACH_OP(SQObjectPtr &o1,SQObjectPtr &o2,SQObjectPtr
 
 #define _GUARD(exp) { if(!exp) { SQ_THROW();} }
 
+/* with SQ_COMPUTED_GOTO the main loop dispatches through a table of label
+   addresses (GCC/clang "labels as values") instead of the switch, and every
+   handler ends with its own copy of the dispatch (SQ_NEXT_OP).
+   the switch stays as the portable fallback.
+   a computed goto does not run destructors, so a handler that has an
+   SQObjectPtr in scope must leave with 'continue' instead of SQ_NEXT_OP */
+#if defined(SQ_COMPUTED_GOTO) && defined(__GNUC__)
+#define SQ_USE_COMPUTED_GOTO
+#define SQ_OP(op) case op: L##op
+#define SQ_NEXT_OP { _i_ = ci->_ip++; SQ_COUNT_PAIR(); goto *_sq_optable[_i_->op]; }
+#else
+#define SQ_OP(op) case op
+#define SQ_NEXT_OP continue
+#endif
+
+/* with SQ_OPCODE_PAIRS every pair of instructions executed one after the other
+   (same function, no jump in between) is counted; see getopcodepairs() */
+#ifdef SQ_OPCODE_PAIRS
+SQUnsignedInteger g_OpcodePairs[SQ_OPCODE_COUNT][SQ_OPCODE_COUNT];
+#define SQ_COUNT_PAIR() { if(_i_ == _previ_ + 1) g_OpcodePairs[_previ_->op][_i_->op]++; _previ_ = _i_; }
+#else
+#define SQ_COUNT_PAIR()
+#endif
+
+/* quickening: a generic arithmetic or compare instruction whose operands are both
+   integers (or both floats) rewrites itself to a specialised opcode. the specialised
+   handler only checks the types and rewrites the instruction back to the generic
+   opcode the first time they don't match */
+/* slot to slot copies skip the reference counting when neither the old nor the
+   new value is reference counted */
+#define _COPY_(trg,src) \
+{ \
+    SQObjectPtr &_t_ = (trg); const SQObjectPtr &_s_ = (src); \
+    if(!ISREFCOUNTED(sq_type(_t_)|sq_type(_s_))) { _t_._type = _s_._type; _t_._unVal = _s_._unVal; } \
+    else _t_ = _s_; \
+}
+
+#define _QUICKEN(newop) (const_cast<SQInstruction *>(_i_)->op = (unsigned char)(newop))
+
+#define _QARITH_(op,iop,fop,trg,o1,o2) \
+{ \
+    SQInteger tmask = sq_type(o1)|sq_type(o2); \
+    switch(tmask) { \
+        case OT_INTEGER: _QUICKEN(iop); trg = _integer(o1) op _integer(o2);break; \
+        case (OT_FLOAT): _QUICKEN(fop); trg = _float(o1) op _float(o2); break;\
+        case (OT_FLOAT|OT_INTEGER): trg = tofloat(o1) op tofloat(o2); break;\
+        default: _GUARD(ARITH_OP((#op)[0],trg,o1,o2)); break;\
+    } \
+}
+
+#define _SPEC_ARITH_(op,type,val,gop,trg,o1,o2) \
+{ \
+    if(sq_type(o1) == type && sq_type(o2) == type) { trg = val(o1) op val(o2); } \
+    else { _QUICKEN(gop); _ARITH_(op,trg,o1,o2); } \
+}
+
+#define _ICMP_(res,cop,i1,i2) \
+{ \
+    switch(cop) { \
+        case CMP_G: res = (i1) > (i2); break; \
+        case CMP_GE: res = (i1) >= (i2); break; \
+        case CMP_L: res = (i1) < (i2); break; \
+        case CMP_LE: res = (i1) <= (i2); break; \
+        default: res = (i1) != (i2); break; /* CMP_3W tested for truth */ \
+    } \
+}
+
 bool SQVM::CLOSURE_OP(SQObjectPtr &target, SQFunctionProto *func)
 {
     SQInteger nouters;
@@ -643,6 +711,7 @@ bool SQVM::IsEqual(const SQObjectPtr &o1,const SQObjectPtr &o2,bool &res)
 {
     if(sq_type(o1) == sq_type(o2)) {
         res = (_rawval(o1) == _rawval(o2));
+        if(!res && sq_type(o1) == OT_STRING) res = SQString::Equal(_string(o1),_string(o2));
     }
     else {
         if(sq_isnumeric(o1) && sq_isnumeric(o2)) {
@@ -669,7 +738,90 @@ bool SQVM::IsFalse(SQObjectPtr &o)
     }
     return false;
 }
+//same as Get()/Set() without flags; string keys of instances are looked up
+//through the inline cache of the instruction 'i' first
+inline bool SQVM::CachedGet(const SQObjectPtr &self,const SQObjectPtr &key,SQObjectPtr &dest,const SQInstruction *i,SQInteger selfidx)
+{
+    if(sq_type(self) == OT_INSTANCE && sq_type(key) == OT_STRING) return CachedInstanceGet(self,key,dest,i,selfidx);
+    return Get(self,key,dest,0,selfidx);
+}
+
+inline bool SQVM::CachedSet(const SQObjectPtr &self,const SQObjectPtr &key,const SQObjectPtr &val,const SQInstruction *i,SQInteger selfidx)
+{
+    if(sq_type(self) == OT_INSTANCE && sq_type(key) == OT_STRING) return CachedInstanceSet(self,key,val,i,selfidx);
+    return Set(self,key,val,selfidx);
+}
+
+bool SQVM::CachedInstanceGet(const SQObjectPtr &self,const SQObjectPtr &key,SQObjectPtr &dest,const SQInstruction *i,SQInteger selfidx)
+{
+    SQInstance *inst = _instance(self);
+    SQClass *c = inst->_class;
+    SQInlineCache *ic = _closure(ci->_closure)->_function->GetInlineCache(i);
+    for(SQInteger w = 0; w < IC_WAYS; w++) {
+        if(ic->_tag[w] == c->_serial && ic->_key[w] == _string(key)) {
+            inst->GetMember(ic->_idx[w],dest);
+            return true;
+        }
+    }
+    SQObjectPtr member;
+    if(c->_members->Get(key,member)) {
+        ic->Fill(c->_serial,_string(key),_integer(member));
+        //a GETK whose first way is a field reads it directly, see _OP_GETFIELD
+        if(i->op == _OP_GETK || i->op == _OP_GETFIELD) {
+            const_cast<SQInstruction *>(i)->op = _isfield(member) ? _OP_GETFIELD : _OP_GETK;
+        }
+        inst->GetMember(_integer(member),dest);
+        return true;
+    }
+    return Get(self,key,dest,0,selfidx);
+}
+
+bool SQVM::CachedInstanceSet(const SQObjectPtr &self,const SQObjectPtr &key,const SQObjectPtr &val,const SQInstruction *i,SQInteger selfidx)
+{
+    SQInstance *inst = _instance(self);
+    SQClass *c = inst->_class;
+    SQInlineCache *ic = _closure(ci->_closure)->_function->GetInlineCache(i);
+    for(SQInteger w = 0; w < IC_WAYS; w++) {
+        if(ic->_tag[w] == c->_serial && ic->_key[w] == _string(key)) {
+            GC_BARRIER(inst);
+            inst->_values[ic->_idx[w]] = val;
+            return true;
+        }
+    }
+    //only fields are cached, methods can't be set through an instance
+    SQObjectPtr member;
+    if(c->_members->Get(key,member) && _isfield(member)) {
+        ic->Fill(c->_serial,_string(key),_member_idx(member));
+        if(i->op == _OP_SET) const_cast<SQInstruction *>(i)->op = _OP_SETFIELD;
+        GC_BARRIER(inst);
+        inst->_values[_member_idx(member)] = val;
+        return true;
+    }
+    return Set(self,key,val,selfidx);
+}
+
+#ifdef SQ_USE_JIT
+void SQVM::JitEnter()
+{
+    SQFunctionProto *func = _closure(ci->_closure)->_function;
+    if(!func->_jit) {
+        if(func->_jithotness < 0 || ++func->_jithotness < SQ_JIT_THRESHOLD) return;
+        func->_jit = SQJitCode::Compile(func);
+        if(!func->_jit) {
+            func->_jithotness = -1;
+            return;
+        }
+    }
+    SQJitEntry entry = func->_jit->GetEntry(ci->_ip - func->_instructions);
+    if(entry) ci->_ip = func->_instructions + entry(&_stack._vals[_stackbase]);
+}
+#endif
+
 extern SQInstructionDesc g_InstrDesc[];
+#ifdef SQ_USE_COMPUTED_GOTO
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+#endif
 bool SQVM::Execute(SQObjectPtr &closure, SQInteger nargs, SQInteger stackbase,SQObjectPtr &outres, SQBool raiseerror,ExecutionType et)
 {
     if ((_nnativecalls + 1) > MAX_NATIVE_CALLS) { Raise_Error(_SC("Native stack overflow")); return false; }
@@ -677,6 +829,34 @@ bool SQVM::Execute(SQObjectPtr &closure, SQInteger nargs, SQInteger stackbase,SQ
     AutoDec ad(&_nnativecalls);
     SQInteger traps = 0;
     CallInfo *prevci = ci;
+    SQInteger call_target, call_fn, call_base, call_nargs;
+#ifdef SQ_OPCODE_PAIRS
+    const SQInstruction *_previ_ = NULL;
+#endif
+#ifdef SQ_USE_COMPUTED_GOTO
+    static void * const _sq_optable[] = {
+        &&L_OP_LINE, &&L_OP_LOAD, &&L_OP_LOADINT, &&L_OP_LOADFLOAT,
+        &&L_OP_DLOAD, &&L_OP_TAILCALL, &&L_OP_CALL, &&L_OP_PREPCALL,
+        &&L_OP_PREPCALLK, &&L_OP_GETK, &&L_OP_MOVE, &&L_OP_NEWSLOT,
+        &&L_OP_DELETE, &&L_OP_SET, &&L_OP_GET, &&L_OP_EQ,
+        &&L_OP_NE, &&L_OP_ADD, &&L_OP_SUB, &&L_OP_MUL,
+        &&L_OP_DIV, &&L_OP_MOD, &&L_OP_BITW, &&L_OP_RETURN,
+        &&L_OP_LOADNULLS, &&L_OP_LOADROOT, &&L_OP_LOADBOOL, &&L_OP_DMOVE,
+        &&L_OP_JMP, &&L_OP_JCMP, &&L_OP_JZ, &&L_OP_SETOUTER,
+        &&L_OP_GETOUTER, &&L_OP_NEWOBJ, &&L_OP_APPENDARRAY, &&L_OP_COMPARITH,
+        &&L_OP_INC, &&L_OP_INCL, &&L_OP_PINC, &&L_OP_PINCL,
+        &&L_OP_CMP, &&L_OP_EXISTS, &&L_OP_INSTANCEOF, &&L_OP_AND,
+        &&L_OP_OR, &&L_OP_NEG, &&L_OP_NOT, &&L_OP_BWNOT,
+        &&L_OP_CLOSURE, &&L_OP_YIELD, &&L_OP_RESUME, &&L_OP_FOREACH,
+        &&L_OP_POSTFOREACH, &&L_OP_CLONE, &&L_OP_TYPEOF, &&L_OP_PUSHTRAP,
+        &&L_OP_POPTRAP, &&L_OP_THROW, &&L_OP_NEWSLOTA, &&L_OP_GETBASE,
+        &&L_OP_CLOSE, &&L_OP_ADDI, &&L_OP_SUBI, &&L_OP_JEQ,
+        &&L_OP_JNE, &&L_OP_CALLK, &&L_OP_IADD, &&L_OP_ISUB,
+        &&L_OP_IMUL, &&L_OP_FADD, &&L_OP_FSUB, &&L_OP_FMUL,
+        &&L_OP_ICMP, &&L_OP_IJCMP, &&L_OP_GETFIELD, &&L_OP_SETFIELD,
+    };
+    static_assert(sizeof(_sq_optable)/sizeof(_sq_optable[0]) == SQ_OPCODE_COUNT, "_sq_optable out of sync with SQOpcode");
+#endif
 
     switch(et) {
         case ET_CALL: {
@@ -708,22 +888,26 @@ exception_restore:
     {
         for(;;)
         {
-            const SQInstruction &_i_ = *ci->_ip++;
+            const SQInstruction *_i_ = ci->_ip++;
+            SQ_COUNT_PAIR();
+#ifdef SQ_USE_COMPUTED_GOTO
+            goto *_sq_optable[_i_->op];
+#endif
             //dumpstack(_stackbase);
-            //scprintf("\n[%d] %s %d %d %d %d\n",ci->_ip-_closure(ci->_closure)->_function->_instructions,g_InstrDesc[_i_.op].name,arg0,arg1,arg2,arg3);
-            switch(_i_.op)
+            //scprintf("\n[%d] %s %d %d %d %d\n",ci->_ip-_closure(ci->_closure)->_function->_instructions,g_InstrDesc[_i_->op].name,arg0,arg1,arg2,arg3);
+            switch(_i_->op)
             {
-            case _OP_LINE: if (_debughook) CallDebugHook(_SC('l'),arg1); continue;
-            case _OP_LOAD: TARGET = ci->_literals[arg1]; continue;
-            case _OP_LOADINT:
+            SQ_OP(_OP_LINE): if (_debughook) CallDebugHook(_SC('l'),arg1); SQ_NEXT_OP;
+            SQ_OP(_OP_LOAD): _COPY_(TARGET,ci->_literals[arg1]); SQ_NEXT_OP;
+            SQ_OP(_OP_LOADINT):
 #ifndef _SQ64
-                TARGET = (SQInteger)arg1; continue;
+                TARGET = (SQInteger)arg1; SQ_NEXT_OP;
 #else
-                TARGET = (SQInteger)((SQInt32)arg1); continue;
+                TARGET = (SQInteger)((SQInt32)arg1); SQ_NEXT_OP;
 #endif
-            case _OP_LOADFLOAT: TARGET = *((const SQFloat *)&arg1); continue;
-            case _OP_DLOAD: TARGET = ci->_literals[arg1]; STK(arg2) = ci->_literals[arg3];continue;
-            case _OP_TAILCALL:{
+            SQ_OP(_OP_LOADFLOAT): TARGET = *((const SQFloat *)&arg1); SQ_NEXT_OP;
+            SQ_OP(_OP_DLOAD): _COPY_(TARGET,ci->_literals[arg1]); _COPY_(STK(arg2),ci->_literals[arg3]); SQ_NEXT_OP;
+            SQ_OP(_OP_TAILCALL):{
                 SQObjectPtr &t = STK(arg1);
                 if (sq_type(t) == OT_CLOSURE
                     && (!_closure(t)->_function->_bgenerator)){
@@ -731,54 +915,95 @@ exception_restore:
                     SQInteger last_top = _top;
                     if(_openouters) CloseOuters(&(_stack._vals[_stackbase]));
                     for (SQInteger i = 0; i < arg3; i++) STK(i) = STK(arg2 + i);
-                    _GUARD(StartCall(_closure(clo), ci->_target, arg3, _stackbase, true));
+                    SQFunctionProto *f = _closure(clo)->_function;
+                    if(f->_nparameters == arg3 && !f->_varparams && !_closure(clo)->_env && !_debughook
+                        && _stackbase + f->_stacksize + MIN_STACK_OVERHEAD <= (SQInteger)_stack.size()) {
+                        //fast path, see _OP_CALL
+                        ci->_ncalls++;
+                        _Swap(ci->_closure, clo);
+                        ci->_literals = f->_literals;
+                        ci->_ip = f->_instructions;
+                        ci->_cont = NULL;
+                        _top = _stackbase + f->_stacksize;
+                    }
+                    else {
+                        _GUARD(StartCall(_closure(clo), ci->_target, arg3, _stackbase, true));
+                    }
                     if (last_top >= _top) {
                         _top = last_top;
                     }
                     continue;
                 }
                               }
-            case _OP_CALL: {
-                    SQObjectPtr clo = STK(arg1);
+            SQ_OP(_OP_CALL):
+                call_target = sarg0; call_fn = arg1; call_base = arg2; call_nargs = arg3;
+            do_call: {
+                    if(sq_type(STK(call_fn)) == OT_CLOSURE) {
+                        //fast path for an exact number of arguments, a free CallInfo and enough stack
+                        SQClosure *c = _closure(STK(call_fn));
+                        SQFunctionProto *f = c->_function;
+                        SQInteger newbase = _stackbase + call_base;
+                        SQInteger newtop = newbase + f->_stacksize;
+                        if(f->_nparameters == call_nargs && !f->_varparams && !f->_bgenerator && !c->_env && !_debughook
+                            && _callsstacksize < _alloccallsstacksize && newtop + MIN_STACK_OVERHEAD <= (SQInteger)_stack.size()) {
+                            CallInfo *nci = &_callsstack[_callsstacksize++];
+                            nci->_closure = STK(call_fn);
+                            nci->_literals = f->_literals;
+                            nci->_ip = f->_instructions;
+                            nci->_generator = NULL;
+                            nci->_etraps = 0;
+                            nci->_prevstkbase = (SQInt32)(newbase - _stackbase);
+                            nci->_prevtop = (SQInt32)(_top - _stackbase);
+                            nci->_target = (SQInt32)call_target;
+                            nci->_ncalls = 1;
+                            nci->_root = SQFalse;
+                            nci->_cont = NULL;
+                            ci = nci;
+                            _stackbase = newbase;
+                            _top = newtop;
+                            continue;
+                        }
+                    }
+                    SQObjectPtr clo = STK(call_fn);
                     switch (sq_type(clo)) {
                     case OT_CLOSURE:
-                        _GUARD(StartCall(_closure(clo), sarg0, arg3, _stackbase+arg2, false));
+                        _GUARD(StartCall(_closure(clo), call_target, call_nargs, _stackbase+call_base, false));
                         continue;
                     case OT_NATIVECLOSURE: {
                         bool suspend;
 						bool tailcall;
-                        _GUARD(CallNative(_nativeclosure(clo), arg3, _stackbase+arg2, clo, (SQInt32)sarg0, suspend, tailcall));
+                        _GUARD(CallNative(_nativeclosure(clo), call_nargs, _stackbase+call_base, clo, (SQInt32)call_target, suspend, tailcall, true));
                         if(suspend){
                             _suspended = SQTrue;
-                            _suspended_target = sarg0;
+                            _suspended_target = call_target;
                             _suspended_root = ci->_root;
                             _suspended_traps = traps;
                             outres = clo;
                             return true;
                         }
-                        if(sarg0 != -1 && !tailcall) {
-                            STK(arg0) = clo;
+                        if(call_target != -1 && !tailcall) {
+                            STK(call_target) = clo;
                         }
                                            }
                         continue;
                     case OT_CLASS:{
                         SQObjectPtr inst;
                         _GUARD(CreateClassInstance(_class(clo),inst,clo));
-                        if(sarg0 != -1) {
-                            STK(arg0) = inst;
+                        if(call_target != -1) {
+                            STK(call_target) = inst;
                         }
                         SQInteger stkbase;
                         switch(sq_type(clo)) {
                             case OT_CLOSURE:
-                                stkbase = _stackbase+arg2;
+                                stkbase = _stackbase+call_base;
                                 _stack._vals[stkbase] = inst;
-                                _GUARD(StartCall(_closure(clo), -1, arg3, stkbase, false));
+                                _GUARD(StartCall(_closure(clo), -1, call_nargs, stkbase, false));
                                 break;
                             case OT_NATIVECLOSURE:
                                 bool dummy;
-                                stkbase = _stackbase+arg2;
+                                stkbase = _stackbase+call_base;
                                 _stack._vals[stkbase] = inst;
-                                _GUARD(CallNative(_nativeclosure(clo), arg3, stkbase, clo, -1, dummy, dummy));
+                                _GUARD(CallNative(_nativeclosure(clo), call_nargs, stkbase, clo, -1, dummy, dummy, true));
                                 break;
                             default: break; //shutup GCC 4.x
                         }
@@ -790,10 +1015,10 @@ exception_restore:
                         SQObjectPtr closure;
                         if(_delegable(clo)->_delegate && _delegable(clo)->GetMetaMethod(this,MT_CALL,closure)) {
                             Push(clo);
-                            for (SQInteger i = 0; i < arg3; i++) Push(STK(arg2 + i));
-                            if(!CallMetaMethod(closure, MT_CALL, arg3+1, clo)) SQ_THROW();
-                            if(sarg0 != -1) {
-                                STK(arg0) = clo;
+                            for (SQInteger i = 0; i < call_nargs; i++) Push(STK(call_base + i));
+                            if(!CallMetaMethod(closure, MT_CALL, call_nargs+1, clo)) SQ_THROW();
+                            if(call_target != -1) {
+                                STK(call_target) = clo;
                             }
                             break;
                         }
@@ -806,53 +1031,90 @@ exception_restore:
                         SQ_THROW();
                     }
                 }
-                  continue;
-            case _OP_PREPCALL:
-            case _OP_PREPCALLK: {
-                    SQObjectPtr &key = _i_.op == _OP_PREPCALLK?(ci->_literals)[arg1]:STK(arg1);
+                  SQ_NEXT_OP;
+            SQ_OP(_OP_PREPCALL):
+            SQ_OP(_OP_PREPCALLK): {
+                    SQObjectPtr &key = _i_->op == _OP_PREPCALLK?(ci->_literals)[arg1]:STK(arg1);
                     SQObjectPtr &o = STK(arg2);
-                    if (!Get(o, key, temp_reg,0,arg2)) {
+                    if (!CachedGet(o, key, temp_reg, _i_, arg2)) {
                         SQ_THROW();
                     }
                     STK(arg3) = o;
                     _Swap(TARGET,temp_reg);//TARGET = temp_reg;
                 }
-                continue;
-            case _OP_GETK:
-                if (!Get(STK(arg2), ci->_literals[arg1], temp_reg, 0,arg2)) { SQ_THROW();}
+                SQ_NEXT_OP;
+            SQ_OP(_OP_CALLK): {
+                    SQObjectPtr &o = STK(arg2);
+                    if (!CachedGet(o, ci->_literals[arg1], temp_reg, _i_, arg2)) {
+                        SQ_THROW();
+                    }
+                    STK(arg3 + 1) = o;
+                    _Swap(STK(arg3),temp_reg);
+                }
+                call_target = sarg0; call_fn = arg3; call_base = arg3 + 1; call_nargs = 1;
+                goto do_call;
+            SQ_OP(_OP_GETK):
+                if (!CachedGet(STK(arg2), ci->_literals[arg1], temp_reg, _i_, arg2)) { SQ_THROW();}
                 _Swap(TARGET,temp_reg);//TARGET = temp_reg;
-                continue;
-            case _OP_MOVE: TARGET = STK(arg1); continue;
-            case _OP_NEWSLOT:
+                SQ_NEXT_OP;
+            SQ_OP(_OP_MOVE): _COPY_(TARGET,STK(arg1)); SQ_NEXT_OP;
+            SQ_OP(_OP_NEWSLOT):
                 _GUARD(NewSlot(STK(arg1), STK(arg2), STK(arg3),false));
                 if(arg0 != 0xFF) TARGET = STK(arg3);
-                continue;
-            case _OP_DELETE: _GUARD(DeleteSlot(STK(arg1), STK(arg2), TARGET)); continue;
-            case _OP_SET:
-                if (!Set(STK(arg1), STK(arg2), STK(arg3),arg1)) { SQ_THROW(); }
+                SQ_NEXT_OP;
+            SQ_OP(_OP_DELETE): _GUARD(DeleteSlot(STK(arg1), STK(arg2), TARGET)); SQ_NEXT_OP;
+            SQ_OP(_OP_SET):
+                if (!CachedSet(STK(arg1), STK(arg2), STK(arg3), _i_, arg1)) { SQ_THROW(); }
                 if (arg0 != 0xFF) TARGET = STK(arg3);
-                continue;
-            case _OP_GET:
-                if (!Get(STK(arg1), STK(arg2), temp_reg, 0,arg1)) { SQ_THROW(); }
+                SQ_NEXT_OP;
+            SQ_OP(_OP_GET):
+                if (!CachedGet(STK(arg1), STK(arg2), temp_reg, _i_, arg1)) { SQ_THROW(); }
                 _Swap(TARGET,temp_reg);//TARGET = temp_reg;
-                continue;
-            case _OP_EQ:{
+                SQ_NEXT_OP;
+            SQ_OP(_OP_EQ):{
                 bool res;
                 if(!IsEqual(STK(arg2),COND_LITERAL,res)) { SQ_THROW(); }
                 TARGET = res?true:false;
-                }continue;
-            case _OP_NE:{
+                }SQ_NEXT_OP;
+            SQ_OP(_OP_NE):{
                 bool res;
                 if(!IsEqual(STK(arg2),COND_LITERAL,res)) { SQ_THROW(); }
                 TARGET = (!res)?true:false;
-                } continue;
-            case _OP_ADD: _ARITH_(+,TARGET,STK(arg2),STK(arg1)); continue;
-            case _OP_SUB: _ARITH_(-,TARGET,STK(arg2),STK(arg1)); continue;
-            case _OP_MUL: _ARITH_(*,TARGET,STK(arg2),STK(arg1)); continue;
-            case _OP_DIV: _ARITH_NOZERO(/,TARGET,STK(arg2),STK(arg1),_SC("division by zero")); continue;
-            case _OP_MOD: ARITH_OP('%',TARGET,STK(arg2),STK(arg1)); continue;
-            case _OP_BITW:  _GUARD(BW_OP( arg3,TARGET,STK(arg2),STK(arg1))); continue;
-            case _OP_RETURN:
+                } SQ_NEXT_OP;
+            SQ_OP(_OP_ADD): _QARITH_(+,_OP_IADD,_OP_FADD,TARGET,STK(arg2),STK(arg1)); SQ_NEXT_OP;
+            SQ_OP(_OP_SUB): _QARITH_(-,_OP_ISUB,_OP_FSUB,TARGET,STK(arg2),STK(arg1)); SQ_NEXT_OP;
+            SQ_OP(_OP_IADD): _SPEC_ARITH_(+,OT_INTEGER,_integer,_OP_ADD,TARGET,STK(arg2),STK(arg1)); SQ_NEXT_OP;
+            SQ_OP(_OP_ISUB): _SPEC_ARITH_(-,OT_INTEGER,_integer,_OP_SUB,TARGET,STK(arg2),STK(arg1)); SQ_NEXT_OP;
+            SQ_OP(_OP_IMUL): _SPEC_ARITH_(*,OT_INTEGER,_integer,_OP_MUL,TARGET,STK(arg2),STK(arg1)); SQ_NEXT_OP;
+            SQ_OP(_OP_FADD): _SPEC_ARITH_(+,OT_FLOAT,_float,_OP_ADD,TARGET,STK(arg2),STK(arg1)); SQ_NEXT_OP;
+            SQ_OP(_OP_FSUB): _SPEC_ARITH_(-,OT_FLOAT,_float,_OP_SUB,TARGET,STK(arg2),STK(arg1)); SQ_NEXT_OP;
+            SQ_OP(_OP_FMUL): _SPEC_ARITH_(*,OT_FLOAT,_float,_OP_MUL,TARGET,STK(arg2),STK(arg1)); SQ_NEXT_OP;
+            SQ_OP(_OP_ADDI):
+                if(sq_type(STK(arg2)) == OT_INTEGER) { TARGET = _integer(STK(arg2)) + sarg1; SQ_NEXT_OP; }
+                { SQObjectPtr k = (SQInteger)sarg1; _ARITH_(+,TARGET,STK(arg2),k); }
+                SQ_NEXT_OP;
+            SQ_OP(_OP_SUBI):
+                if(sq_type(STK(arg2)) == OT_INTEGER) { TARGET = _integer(STK(arg2)) - sarg1; SQ_NEXT_OP; }
+                { SQObjectPtr k = (SQInteger)sarg1; _ARITH_(-,TARGET,STK(arg2),k); }
+                SQ_NEXT_OP;
+            SQ_OP(_OP_MUL): _QARITH_(*,_OP_IMUL,_OP_FMUL,TARGET,STK(arg2),STK(arg1)); SQ_NEXT_OP;
+            SQ_OP(_OP_DIV): _ARITH_NOZERO(/,TARGET,STK(arg2),STK(arg1),_SC("division by zero")); SQ_NEXT_OP;
+            SQ_OP(_OP_MOD): ARITH_OP('%',TARGET,STK(arg2),STK(arg1)); SQ_NEXT_OP;
+            SQ_OP(_OP_BITW):  _GUARD(BW_OP( arg3,TARGET,STK(arg2),STK(arg1))); SQ_NEXT_OP;
+            SQ_OP(_OP_RETURN):
+                if(!ci->_generator && !ci->_root && !_debughook) {
+                    //return to a script or sq_callk caller, see Return()
+                    if(ci->_target != -1) {
+                        SQObjectPtr &dest = _stack._vals[_stackbase - ci->_prevstkbase + ci->_target];
+                        if(arg0 != 0xFF) dest = STK(arg1);
+                        else dest.Null();
+                    }
+                    LeaveFrame();
+                    if(ci->_cont) {
+                        _GUARD(ContinueNative());
+                    }
+                    SQ_NEXT_OP;
+                }
                 if((ci)->_generator) {
                     (ci)->_generator->Kill();
                 }
@@ -862,9 +1124,12 @@ exception_restore:
                     _Swap(outres,temp_reg);
                     return true;
                 }
-                continue;
-            case _OP_LOADNULLS:{ for(SQInt32 n=0; n < arg1; n++) STK(arg0+n).Null(); }continue;
-            case _OP_LOADROOT:  {
+                if(ci->_cont) {
+                    _GUARD(ContinueNative());
+                }
+                SQ_NEXT_OP;
+            SQ_OP(_OP_LOADNULLS):{ for(SQInt32 n=0; n < arg1; n++) STK(arg0+n).Null(); }SQ_NEXT_OP;
+            SQ_OP(_OP_LOADROOT):  {
                 SQWeakRef *w = _closure(ci->_closure)->_root;
                 if(sq_type(w->_obj) != OT_NULL) {
                     TARGET = w->_obj;
@@ -872,39 +1137,73 @@ exception_restore:
                     TARGET = _roottable; //shoud this be like this? or null
                 }
                                 }
-                continue;
-            case _OP_LOADBOOL: TARGET = arg1?true:false; continue;
-            case _OP_DMOVE: STK(arg0) = STK(arg1); STK(arg2) = STK(arg3); continue;
-            case _OP_JMP: ci->_ip += (sarg1); continue;
+                SQ_NEXT_OP;
+            SQ_OP(_OP_LOADBOOL): TARGET = arg1?true:false; SQ_NEXT_OP;
+            SQ_OP(_OP_DMOVE): _COPY_(STK(arg0),STK(arg1)); _COPY_(STK(arg2),STK(arg3)); SQ_NEXT_OP;
+            SQ_OP(_OP_JMP): ci->_ip += (sarg1);
+#ifdef SQ_USE_JIT
+                //loop back-edge
+                if(sarg1 < 0 && _ss(this)->_jitenabled && !_debughook) JitEnter();
+#endif
+                SQ_NEXT_OP;
             //case _OP_JNZ: if(!IsFalse(STK(arg0))) ci->_ip+=(sarg1); continue;
-            case _OP_JCMP:
+            SQ_OP(_OP_JCMP):
+                if(sq_type(STK(arg2)) == OT_INTEGER && sq_type(STK(arg0)) == OT_INTEGER) {
+                    _QUICKEN(_OP_IJCMP);
+                    bool res;
+                    _ICMP_(res,arg3,_integer(STK(arg2)),_integer(STK(arg0)));
+                    if(!res) ci->_ip+=(sarg1);
+                    SQ_NEXT_OP;
+                }
+                _GUARD(CMP_OP((CmpOP)arg3,STK(arg2),STK(arg0),temp_reg));
+                if(IsFalse(temp_reg)) ci->_ip+=(sarg1);
+                SQ_NEXT_OP;
+            SQ_OP(_OP_IJCMP):
+                if(sq_type(STK(arg2)) == OT_INTEGER && sq_type(STK(arg0)) == OT_INTEGER) {
+                    bool res;
+                    _ICMP_(res,arg3,_integer(STK(arg2)),_integer(STK(arg0)));
+                    if(!res) ci->_ip+=(sarg1);
+                    SQ_NEXT_OP;
+                }
+                _QUICKEN(_OP_JCMP);
                 _GUARD(CMP_OP((CmpOP)arg3,STK(arg2),STK(arg0),temp_reg));
                 if(IsFalse(temp_reg)) ci->_ip+=(sarg1);
-                continue;
-            case _OP_JZ: if(IsFalse(STK(arg0))) ci->_ip+=(sarg1); continue;
-            case _OP_GETOUTER: {
+                SQ_NEXT_OP;
+            SQ_OP(_OP_JEQ):{
+                bool res;
+                if(!IsEqual(STK(arg0),arg3!=0?ci->_literals[arg2]:STK(arg2),res)) { SQ_THROW(); }
+                if(!res) ci->_ip+=(sarg1);
+                }SQ_NEXT_OP;
+            SQ_OP(_OP_JNE):{
+                bool res;
+                if(!IsEqual(STK(arg0),arg3!=0?ci->_literals[arg2]:STK(arg2),res)) { SQ_THROW(); }
+                if(res) ci->_ip+=(sarg1);
+                }SQ_NEXT_OP;
+            SQ_OP(_OP_JZ): if(IsFalse(STK(arg0))) ci->_ip+=(sarg1); SQ_NEXT_OP;
+            SQ_OP(_OP_GETOUTER): {
                 SQClosure *cur_cls = _closure(ci->_closure);
                 SQOuter *otr = _outer(cur_cls->_outervalues[arg1]);
                 TARGET = *(otr->_valptr);
                 }
-            continue;
-            case _OP_SETOUTER: {
+            SQ_NEXT_OP;
+            SQ_OP(_OP_SETOUTER): {
                 SQClosure *cur_cls = _closure(ci->_closure);
                 SQOuter   *otr = _outer(cur_cls->_outervalues[arg1]);
+                GC_BARRIER(otr);
                 *(otr->_valptr) = STK(arg2);
                 if(arg0 != 0xFF) {
                     TARGET = STK(arg2);
                 }
                 }
-            continue;
-            case _OP_NEWOBJ:
+            SQ_NEXT_OP;
+            SQ_OP(_OP_NEWOBJ):
                 switch(arg3) {
-                    case NOT_TABLE: TARGET = SQTable::Create(_ss(this), arg1); continue;
-                    case NOT_ARRAY: TARGET = SQArray::Create(_ss(this), 0); _array(TARGET)->Reserve(arg1); continue;
-                    case NOT_CLASS: _GUARD(CLASS_OP(TARGET,arg1,arg2)); continue;
-                    default: assert(0); continue;
+                    case NOT_TABLE: TARGET = SQTable::Create(_ss(this), arg1); SQ_NEXT_OP;
+                    case NOT_ARRAY: TARGET = SQArray::Create(_ss(this), 0); _array(TARGET)->Reserve(arg1); SQ_NEXT_OP;
+                    case NOT_CLASS: _GUARD(CLASS_OP(TARGET,arg1,arg2)); SQ_NEXT_OP;
+                    default: assert(0); SQ_NEXT_OP;
                 }
-            case _OP_APPENDARRAY:
+            SQ_OP(_OP_APPENDARRAY):
                 {
                     SQObject val;
                     val._unVal.raw = 0;
@@ -932,15 +1231,15 @@ exception_restore:
                 default: val._type = OT_INTEGER; assert(0); break;
 
                 }
-                _array(STK(arg0))->Append(val); continue;
+                _array(STK(arg0))->Append(val); SQ_NEXT_OP;
                 }
-            case _OP_COMPARITH: {
+            SQ_OP(_OP_COMPARITH): {
                 SQInteger selfidx = (((SQUnsignedInteger)arg1&0xFFFF0000)>>16);
                 _GUARD(DerefInc(arg3, TARGET, STK(selfidx), STK(arg2), STK(arg1&0x0000FFFF), false, selfidx));
                                 }
-                continue;
-            case _OP_INC: {SQObjectPtr o(sarg3); _GUARD(DerefInc('+',TARGET, STK(arg1), STK(arg2), o, false, arg1));} continue;
-            case _OP_INCL: {
+                SQ_NEXT_OP;
+            SQ_OP(_OP_INC): {SQObjectPtr o(sarg3); _GUARD(DerefInc('+',TARGET, STK(arg1), STK(arg2), o, false, arg1));} SQ_NEXT_OP;
+            SQ_OP(_OP_INCL): {
                 SQObjectPtr &a = STK(arg1);
                 if(sq_type(a) == OT_INTEGER) {
                     a._unVal.nInteger = _integer(a) + sarg3;
@@ -949,9 +1248,9 @@ exception_restore:
                     SQObjectPtr o(sarg3); //_GUARD(LOCAL_INC('+',TARGET, STK(arg1), o));
                     _ARITH_(+,a,a,o);
                 }
-                           } continue;
-            case _OP_PINC: {SQObjectPtr o(sarg3); _GUARD(DerefInc('+',TARGET, STK(arg1), STK(arg2), o, true, arg1));} continue;
-            case _OP_PINCL: {
+                           } SQ_NEXT_OP;
+            SQ_OP(_OP_PINC): {SQObjectPtr o(sarg3); _GUARD(DerefInc('+',TARGET, STK(arg1), STK(arg2), o, true, arg1));} SQ_NEXT_OP;
+            SQ_OP(_OP_PINCL): {
                 SQObjectPtr &a = STK(arg1);
                 if(sq_type(a) == OT_INTEGER) {
                     TARGET = a;
@@ -961,43 +1260,104 @@ exception_restore:
                     SQObjectPtr o(sarg3); _GUARD(PLOCAL_INC('+',TARGET, STK(arg1), o));
                 }
 
-                        } continue;
-            case _OP_CMP:   _GUARD(CMP_OP((CmpOP)arg3,STK(arg2),STK(arg1),TARGET))  continue;
-            case _OP_EXISTS: TARGET = Get(STK(arg1), STK(arg2), temp_reg, GET_FLAG_DO_NOT_RAISE_ERROR | GET_FLAG_RAW, DONT_FALL_BACK) ? true : false; continue;
-            case _OP_INSTANCEOF:
+                        } SQ_NEXT_OP;
+            SQ_OP(_OP_CMP):
+                if(sq_type(STK(arg2)) == OT_INTEGER && sq_type(STK(arg1)) == OT_INTEGER && arg3 != CMP_3W) {
+                    _QUICKEN(_OP_ICMP);
+                }
+                _GUARD(CMP_OP((CmpOP)arg3,STK(arg2),STK(arg1),TARGET))  SQ_NEXT_OP;
+            SQ_OP(_OP_ICMP):
+                if(sq_type(STK(arg2)) == OT_INTEGER && sq_type(STK(arg1)) == OT_INTEGER) {
+                    bool res;
+                    _ICMP_(res,arg3,_integer(STK(arg2)),_integer(STK(arg1)));
+                    TARGET = res;
+                    SQ_NEXT_OP;
+                }
+                _QUICKEN(_OP_CMP);
+                _GUARD(CMP_OP((CmpOP)arg3,STK(arg2),STK(arg1),TARGET))  SQ_NEXT_OP;
+            SQ_OP(_OP_GETFIELD): {
+                //GETK of a field: the first way of the inline cache holds its index
+                SQObjectPtr &o = STK(arg2);
+                if(sq_type(o) == OT_INSTANCE) {
+                    SQInlineCache *ic = _closure(ci->_closure)->_function->GetInlineCache(_i_);
+                    if(ic->_tag[0] == _instance(o)->_class->_serial) {
+                        TARGET = _realval(_instance(o)->_values[ic->_idx[0] & 0x00FFFFFF]);
+                        SQ_NEXT_OP;
+                    }
+                }
+                if (!CachedGet(o, ci->_literals[arg1], temp_reg, _i_, arg2)) { SQ_THROW();}
+                _Swap(TARGET,temp_reg);
+                } SQ_NEXT_OP;
+            SQ_OP(_OP_SETFIELD): {
+                //SET of a field, the key is in a register so it is checked too
+                SQObjectPtr &o = STK(arg1);
+                if(sq_type(o) == OT_INSTANCE && sq_type(STK(arg2)) == OT_STRING) {
+                    SQInlineCache *ic = _closure(ci->_closure)->_function->GetInlineCache(_i_);
+                    if(ic->_tag[0] == _instance(o)->_class->_serial && ic->_key[0] == _string(STK(arg2))) {
+                        GC_BARRIER(_instance(o));
+                        _instance(o)->_values[ic->_idx[0]] = STK(arg3);
+                        if (arg0 != 0xFF) TARGET = STK(arg3);
+                        SQ_NEXT_OP;
+                    }
+                }
+                if (!CachedSet(o, STK(arg2), STK(arg3), _i_, arg1)) { SQ_THROW(); }
+                if (arg0 != 0xFF) TARGET = STK(arg3);
+                } SQ_NEXT_OP;
+            SQ_OP(_OP_EXISTS): TARGET = Get(STK(arg1), STK(arg2), temp_reg, GET_FLAG_DO_NOT_RAISE_ERROR | GET_FLAG_RAW, DONT_FALL_BACK) ? true : false; SQ_NEXT_OP;
+            SQ_OP(_OP_INSTANCEOF):
                 if(sq_type(STK(arg1)) != OT_CLASS)
                 {Raise_Error(_SC("cannot apply instanceof between a %s and a %s"),GetTypeName(STK(arg1)),GetTypeName(STK(arg2))); SQ_THROW();}
                 TARGET = (sq_type(STK(arg2)) == OT_INSTANCE) ? (_instance(STK(arg2))->InstanceOf(_class(STK(arg1)))?true:false) : false;
-                continue;
-            case _OP_AND:
+                SQ_NEXT_OP;
+            SQ_OP(_OP_AND):
                 if(IsFalse(STK(arg2))) {
                     TARGET = STK(arg2);
                     ci->_ip += (sarg1);
                 }
-                continue;
-            case _OP_OR:
+                SQ_NEXT_OP;
+            SQ_OP(_OP_OR):
                 if(!IsFalse(STK(arg2))) {
                     TARGET = STK(arg2);
                     ci->_ip += (sarg1);
                 }
-                continue;
-            case _OP_NEG: _GUARD(NEG_OP(TARGET,STK(arg1))); continue;
-            case _OP_NOT: TARGET = IsFalse(STK(arg1)); continue;
-            case _OP_BWNOT:
+                SQ_NEXT_OP;
+            SQ_OP(_OP_NEG): _GUARD(NEG_OP(TARGET,STK(arg1))); SQ_NEXT_OP;
+            SQ_OP(_OP_NOT): TARGET = IsFalse(STK(arg1)); SQ_NEXT_OP;
+            SQ_OP(_OP_BWNOT):
                 if(sq_type(STK(arg1)) == OT_INTEGER) {
                     SQInteger t = _integer(STK(arg1));
                     TARGET = SQInteger(~t);
-                    continue;
+                    SQ_NEXT_OP;
                 }
                 Raise_Error(_SC("attempt to perform a bitwise op on a %s"), GetTypeName(STK(arg1)));
                 SQ_THROW();
-            case _OP_CLOSURE: {
+            SQ_OP(_OP_CLOSURE): {
                 SQClosure *c = ci->_closure._unVal.pClosure;
                 SQFunctionProto *fp = c->_function;
+                if(arg3) {
+                    /* capture free: the closure of the last evaluation is returned again when
+                       nothing but its slot (and the target) refers to it, so no one can tell it
+                       from a new one, and its root table is still the current one */
+                    SQObjectPtr &shared = c->_shared[arg3 - 1];
+                    if(sq_type(shared) == OT_CLOSURE) {
+                        SQClosure *sc = _closure(shared);
+                        SQUnsignedInteger refs = REF_COUNT(sc);
+                        if((refs == 1 || (refs == 2 && sq_type(TARGET) == OT_CLOSURE && _closure(TARGET) == sc))
+                            && !sc->_weakref && sc->_function == fp->_functions[arg1]._unVal.pFunctionProto
+                            && sc->_root == _table(_roottable)->_weakref) {
+                            TARGET = shared;
+                            SQ_NEXT_OP;
+                        }
+                    }
+                    if(!CLOSURE_OP(TARGET,fp->_functions[arg1]._unVal.pFunctionProto)) { SQ_THROW(); }
+                    GC_BARRIER(c);
+                    shared = TARGET;
+                    SQ_NEXT_OP;
+                }
                 if(!CLOSURE_OP(TARGET,fp->_functions[arg1]._unVal.pFunctionProto)) { SQ_THROW(); }
-                continue;
+                SQ_NEXT_OP;
             }
-            case _OP_YIELD:{
+            SQ_OP(_OP_YIELD):{
                 if(ci->_generator) {
                     if(sarg1 != MAX_FUNC_STACKSIZE) temp_reg = STK(arg1);
                     _GUARD(ci->_generator->Yield(this,arg2));
@@ -1012,41 +1372,41 @@ exception_restore:
                 }
 
                 }
-                continue;
-            case _OP_RESUME:
+                SQ_NEXT_OP;
+            SQ_OP(_OP_RESUME):
                 if(sq_type(STK(arg1)) != OT_GENERATOR){ Raise_Error(_SC("trying to resume a '%s',only genenerator can be resumed"), GetTypeName(STK(arg1))); SQ_THROW();}
                 _GUARD(_generator(STK(arg1))->Resume(this, TARGET));
                 traps += ci->_etraps;
-                continue;
-            case _OP_FOREACH:{ int tojump;
+                SQ_NEXT_OP;
+            SQ_OP(_OP_FOREACH):{ int tojump;
                 _GUARD(FOREACH_OP(STK(arg0),STK(arg2),STK(arg2+1),STK(arg2+2),arg2,sarg1,tojump));
                 ci->_ip += tojump; }
-                continue;
-            case _OP_POSTFOREACH:
+                SQ_NEXT_OP;
+            SQ_OP(_OP_POSTFOREACH):
                 assert(sq_type(STK(arg0)) == OT_GENERATOR);
                 if(_generator(STK(arg0))->_state == SQGenerator::eDead)
                     ci->_ip += (sarg1 - 1);
-                continue;
-            case _OP_CLONE: _GUARD(Clone(STK(arg1), TARGET)); continue;
-            case _OP_TYPEOF: _GUARD(TypeOf(STK(arg1), TARGET)) continue;
-            case _OP_PUSHTRAP:{
+                SQ_NEXT_OP;
+            SQ_OP(_OP_CLONE): _GUARD(Clone(STK(arg1), TARGET)); SQ_NEXT_OP;
+            SQ_OP(_OP_TYPEOF): _GUARD(TypeOf(STK(arg1), TARGET)) SQ_NEXT_OP;
+            SQ_OP(_OP_PUSHTRAP):{
                 SQInstruction *_iv = _closure(ci->_closure)->_function->_instructions;
                 _etraps.push_back(SQExceptionTrap(_top,_stackbase, &_iv[(ci->_ip-_iv)+arg1], arg0)); traps++;
                 ci->_etraps++;
                               }
-                continue;
-            case _OP_POPTRAP: {
+                SQ_NEXT_OP;
+            SQ_OP(_OP_POPTRAP): {
                 for(SQInteger i = 0; i < arg0; i++) {
                     _etraps.pop_back(); traps--;
                     ci->_etraps--;
                 }
                               }
-                continue;
-            case _OP_THROW: Raise_Error(TARGET); SQ_THROW(); continue;
-            case _OP_NEWSLOTA:
+                SQ_NEXT_OP;
+            SQ_OP(_OP_THROW): Raise_Error(TARGET); SQ_THROW(); SQ_NEXT_OP;
+            SQ_OP(_OP_NEWSLOTA):
                 _GUARD(NewSlotA(STK(arg1),STK(arg2),STK(arg3),(arg0&NEW_SLOT_ATTRIBUTES_FLAG) ? STK(arg2-1) : SQObjectPtr(),(arg0&NEW_SLOT_STATIC_FLAG)?true:false,false));
-                continue;
-            case _OP_GETBASE:{
+                SQ_NEXT_OP;
+            SQ_OP(_OP_GETBASE):{
                 SQClosure *clo = _closure(ci->_closure);
                 if(clo->_base) {
                     TARGET = clo->_base;
@@ -1054,11 +1414,11 @@ exception_restore:
                 else {
                     TARGET.Null();
                 }
-                continue;
+                SQ_NEXT_OP;
             }
-            case _OP_CLOSE:
+            SQ_OP(_OP_CLOSE):
                 if(_openouters) CloseOuters(&(STK(arg1)));
-                continue;
+                SQ_NEXT_OP;
             }
 
         }
@@ -1083,7 +1443,7 @@ exception_trap:
                 while(last_top >= _top) _stack._vals[last_top--].Null();
                 goto exception_restore;
             }
-            else if (_debughook) {
+            else if (_debughook && sq_type(ci->_closure) == OT_CLOSURE) {
                     //notify debugger of a "return"
                     //even if it really an exception unwinding the stack
                     for(SQInteger i = 0; i < ci->_ncalls; i++) {
@@ -1101,6 +1461,9 @@ exception_trap:
     }
     assert(0);
 }
+#ifdef SQ_USE_COMPUTED_GOTO
+#pragma GCC diagnostic pop
+#endif
 
 bool SQVM::CreateClassInstance(SQClass *theclass, SQObjectPtr &inst, SQObjectPtr &constructor)
 {
@@ -1142,7 +1505,7 @@ void SQVM::CallDebugHook(SQInteger type,SQInteger forcedline)
     _debughook = true;
 }
 
-bool SQVM::CallNative(SQNativeClosure *nclosure, SQInteger nargs, SQInteger newbase, SQObjectPtr &retval, SQInt32 target,bool &suspend, bool &tailcall)
+bool SQVM::CallNative(SQNativeClosure *nclosure, SQInteger nargs, SQInteger newbase, SQObjectPtr &retval, SQInt32 target,bool &suspend, bool &tailcall,bool resumable)
 {
     SQInteger nparamscheck = nclosure->_nparamscheck;
     SQInteger newtop = newbase + nargs + nclosure->_noutervalues;
@@ -1185,10 +1548,14 @@ bool SQVM::CallNative(SQNativeClosure *nclosure, SQInteger nargs, SQInteger newb
     _nnativecalls++;
     SQInteger ret = (nclosure->_function)(this);
     _nnativecalls--;
+    if(ret == SQ_CALLK_FLAG && !NativeCallK(ret, resumable)) {
+        ret = SQ_ERROR;
+    }
 
     suspend = false;
 	tailcall = false;
-	if (ret == SQ_TAILCALL_FLAG) {
+	if (ret == SQ_TAILCALL_FLAG || ret == SQ_CALLK_FLAG) {
+		//a script frame was pushed, the execution loop runs it
 		tailcall = true;
 		return true;
 	}
@@ -1211,6 +1578,82 @@ bool SQVM::CallNative(SQNativeClosure *nclosure, SQInteger nargs, SQInteger newb
     return true;
 }
 
+/* the native function in ci returned sq_callk(): the closure and its parameters
+are at the top of its stack. when 'resumable' (the native was called by the
+execution loop) a squirrel closure is only started and ret stays SQ_CALLK_FLAG;
+the loop runs it and calls ContinueNative() when it returns. anything else is
+called here and the continuation runs right away */
+bool SQVM::NativeCallK(SQInteger &ret, bool resumable)
+{
+    while(ret == SQ_CALLK_FLAG) {
+        SQInteger nparams = ci->_contparams;
+        SQInteger fn = _top - nparams - 1;
+        SQObjectPtr &clo = _stack._vals[fn];
+        switch(sq_type(clo)) {
+        case OT_CLOSURE:
+            if(resumable) {
+                //the stack slot keeps the closure alive until the call returns in it
+                SQInteger css = _callsstacksize;
+                if(!StartCall(_closure(clo), fn - _stackbase, nparams, fn + 1, false)) {
+                    while(_callsstacksize > css) LeaveFrame();
+                    return false;
+                }
+                if(_callsstacksize > css) return true;
+                break; //a generator, already returned
+            }
+            //fall through
+        case OT_NATIVECLOSURE:
+        case OT_CLASS: {
+            SQObjectPtr f = clo, res;
+            if(!Call(f, nparams, fn + 1, res, SQFalse)) return false;
+            _stack._vals[fn] = res;
+            }
+            break;
+        default:
+            Raise_Error(_SC("attempt to call '%s'"), GetTypeName(clo));
+            return false;
+        }
+        Pop(nparams);
+        _nnativecalls++;
+        ret = ci->_cont(this);
+        _nnativecalls--;
+    }
+    return true;
+}
+
+bool SQVM::ContinueNative()
+{
+    Pop(ci->_contparams);
+    _nnativecalls++;
+    SQInteger ret = ci->_cont(this);
+    _nnativecalls--;
+    if(ret == SQ_CALLK_FLAG && !NativeCallK(ret, true)) {
+        ret = SQ_ERROR;
+    }
+    if(ret == SQ_CALLK_FLAG || ret == SQ_TAILCALL_FLAG) {
+        return true;
+    }
+    if(ret == SQ_SUSPEND_FLAG) {
+        Raise_Error(_SC("cannot suspend the continuation of a native call"));
+        ret = SQ_ERROR;
+    }
+    if(ret < 0) {
+        LeaveFrame();
+        Raise_Error(_lasterror);
+        return false;
+    }
+    SQObjectPtr retval;
+    if(ret) {
+        retval = _stack._vals[_top-1];
+    }
+    SQInt32 target = ci->_target;
+    LeaveFrame();
+    if(target != -1) {
+        STK(target) = retval;
+    }
+    return true;
+}
+
 bool SQVM::TailCall(SQClosure *closure, SQInteger parambase,SQInteger nparams)
 {
 	SQInteger last_top = _top;
@@ -1655,6 +2098,7 @@ bool SQVM::EnterFrame(SQInteger newbase, SQInteger newtop, bool tailcall)
         ci->_ncalls = 1;
         ci->_generator = NULL;
         ci->_root = SQFalse;
+        ci->_cont = NULL;
     }
     else {
         ci->_ncalls++;
@@ -1673,7 +2117,7 @@ bool SQVM::EnterFrame(SQInteger newbase, SQInteger newtop, bool tailcall)
     return true;
 }
 
-void SQVM::LeaveFrame() {
+inline void SQVM::LeaveFrame() {
     SQInteger last_top = _top;
     SQInteger last_stackbase = _stackbase;
     SQInteger css = --_callsstacksize;
@@ -1702,6 +2146,7 @@ void SQVM::RelocateOuters()
 void SQVM::CloseOuters(SQObjectPtr *stackindex) {
   SQOuter *p;
   while ((p = _openouters) != NULL && p->_valptr >= stackindex) {
+    GC_BARRIER(p);
     p->_value = *(p->_valptr);
     p->_valptr = &p->_value;
     _openouters = p->_next;
@@ -4,11 +4,13 @@
 
 #include "sqopcodes.h"
 #include "sqobject.h"
+#include "sqjit.h"
 #define MAX_NATIVE_CALLS 100
 #define MIN_STACK_OVERHEAD 15
 
 #define SQ_SUSPEND_FLAG -666
 #define SQ_TAILCALL_FLAG -777
+#define SQ_CALLK_FLAG -888
 #define DONT_FALL_BACK 666
 //#define EXISTS_FALL_BACK -1
 
@@ -45,6 +47,8 @@ struct SQVM : public CHAINABLE_OBJ
         SQInt32 _target;
         SQInt32 _ncalls;
         SQBool _root;
+        SQFUNCTION _cont; //continuation of a native function waiting in sq_callk
+        SQInt32 _contparams;
     };
 
 typedef sqvector<CallInfo> CallInfoVec;
@@ -57,7 +61,11 @@ public:
     bool Init(SQVM *friendvm, SQInteger stacksize);
     bool Execute(SQObjectPtr &func, SQInteger nargs, SQInteger stackbase, SQObjectPtr &outres, SQBool raiseerror, ExecutionType et = ET_CALL);
     //starts a native call return when the NATIVE closure returns
-    bool CallNative(SQNativeClosure *nclosure, SQInteger nargs, SQInteger newbase, SQObjectPtr &retval, SQInt32 target, bool &suspend,bool &tailcall);
+    bool CallNative(SQNativeClosure *nclosure, SQInteger nargs, SQInteger newbase, SQObjectPtr &retval, SQInt32 target, bool &suspend,bool &tailcall,bool resumable = false);
+    //runs the calls a native function asks for with sq_callk and its continuations
+    bool NativeCallK(SQInteger &ret, bool resumable);
+    //a closure called through sq_callk returned to its native function in the execution loop
+    bool ContinueNative();
 	bool TailCall(SQClosure *closure, SQInteger firstparam, SQInteger nparams);
     //starts a SQUIRREL call in the same "Execution loop"
     bool StartCall(SQClosure *closure, SQInteger target, SQInteger nargs, SQInteger stackbase, bool tailcall);
@@ -72,7 +80,14 @@ public:
     SQInteger FallBackGet(const SQObjectPtr &self,const SQObjectPtr &key,SQObjectPtr &dest);
     bool InvokeDefaultDelegate(const SQObjectPtr &self,const SQObjectPtr &key,SQObjectPtr &dest);
     bool Set(const SQObjectPtr &self, const SQObjectPtr &key, const SQObjectPtr &val, SQInteger selfidx);
+    bool CachedGet(const SQObjectPtr &self, const SQObjectPtr &key, SQObjectPtr &dest, const SQInstruction *i, SQInteger selfidx);
+    bool CachedSet(const SQObjectPtr &self, const SQObjectPtr &key, const SQObjectPtr &val, const SQInstruction *i, SQInteger selfidx);
+    bool CachedInstanceGet(const SQObjectPtr &self, const SQObjectPtr &key, SQObjectPtr &dest, const SQInstruction *i, SQInteger selfidx);
+    bool CachedInstanceSet(const SQObjectPtr &self, const SQObjectPtr &key, const SQObjectPtr &val, const SQInstruction *i, SQInteger selfidx);
     SQInteger FallBackSet(const SQObjectPtr &self,const SQObjectPtr &key,const SQObjectPtr &val);
+#ifdef SQ_USE_JIT
+    void JitEnter();
+#endif
     bool NewSlot(const SQObjectPtr &self, const SQObjectPtr &key, const SQObjectPtr &val,bool bstatic);
     bool NewSlotA(const SQObjectPtr &self,const SQObjectPtr &key,const SQObjectPtr &val,const SQObjectPtr &attrs,bool bstatic,bool raw);
     bool DeleteSlot(const SQObjectPtr &self, const SQObjectPtr &key, SQObjectPtr &res);
@@ -115,7 +130,7 @@ public:
 #endif
 
 #ifndef NO_GARBAGE_COLLECTOR
-    void Mark(SQCollectable **chain);
+    void MarkChildren(SQCollectable **chain);
     SQObjectType GetType() {return OT_THREAD;}
 #endif
     void Finalize();
@@ -126,7 +141,7 @@ public:
         _alloccallsstacksize = newsize;
     }
     bool EnterFrame(SQInteger newbase, SQInteger newtop, bool tailcall);
-    void LeaveFrame();
+    void LeaveFrame(); //inline, only used by sqvm.cpp
     void Release(){ sq_delete(this,SQVM); }
 ////////////////////////////////////////////////////////////////////////////
     //stack functions for the api
@@ -167,8 +182,10 @@ public:
     ExceptionsTraps _etraps;
     CallInfo *ci;
     SQUserPointer _foreignptr;
-    //VMs sharing the same state
+#ifdef NO_GARBAGE_COLLECTOR
+    //VMs sharing the same state, with the collector the one of SQCollectable
     SQSharedState *_sharedstate;
+#endif
     SQInteger _nnativecalls;
     SQInteger _nmetamethodscall;
     SQRELEASEHOOK _releasehook;